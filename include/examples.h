@@ -25,7 +25,9 @@ inline void print_args(float data[], uint32_t count)
 }
 
 
-inline void print_machine_code(const char* title, const vpu::IAssembler* a)
+// prints the code from a vpu::IAssembler, or a vpu::Emitter
+template<typename Assembler>
+inline void print_machine_code(const char* title, const Assembler* a)
 {
   printf("\n%s\n", title);
   uint32_t n = (uint32_t)a->numBytes();
@@ -6,21 +6,51 @@
 ///         Obviously, you should really ensure that the computer you are running this on actually supports AVX2. 
 /// \note   Copyright Rob Bateman. I accept no liability for any damage done to you, your computer(s), your client(s), or any other hardware/software 
 ///         problem that may arise from using this software. Use at your own risk.
+/// \note   On Linux the library is loaded from libASM.so (or linked statically by defining VPU_STATIC_LIB). When building 
+///         with GCC or Clang, compile with -mavx2 -mfma -fno-operator-names (the assembler has methods named 'and', 'or' 
+///         and 'xor', which are reserved words in standard C++). 
 
 #pragma once
 #include <cstdint>
+#include <cstddef>
 #include <immintrin.h>
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
+#if defined(_WIN32)
+# define WIN32_LEAN_AND_MEAN
+# include <Windows.h>
+#else
+# include <cstdio>
+# include <cstdlib>
+# include <cstring>
+# include <dlfcn.h>
+# if defined(__linux__)
+#  include <elf.h>
+#  include <link.h>
+# endif
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
 
 namespace vpu
 {
 #if defined(_WIN32)
 # define VPU_ALIGN_PREFIX(X) __declspec(align(X))
 # define VPU_ALIGN_SUFFIX(X)
+# define VPU_LIB_NAME "libASM.dll"
 #else
-# define VPU_ALIGN_PREFIX(X)
-# define VPU_ALIGN_SUFFIX(X) __attribute__ ((aligned (X)))
+# define VPU_ALIGN_PREFIX(X) __attribute__ ((aligned (X)))
+# define VPU_ALIGN_SUFFIX(X)
+# define VPU_LIB_NAME "libASM.so"
+#endif
+
+#if defined(_MSC_VER)
+# define VPU_VECTORCALL __vectorcall
+#elif defined(_WIN32) && defined(__clang__)
+# define VPU_VECTORCALL __attribute__((vectorcall))
+#elif defined(_WIN32)
+# error "libASM.dll calls functions with __vectorcall, which this compiler does not support (use MSVC or Clang)"
+#else
+# define VPU_VECTORCALL
 #endif
 
 // forward decls
@@ -33,8 +63,107 @@ extern "C"
 typedef IFunctionTable* (*CreateFunctionTableFn)();
 typedef IAssembler* (*CreateAssemblerFn)(size_t);
 typedef void (*InitLibFn)(void**);
+
+#if defined(VPU_STATIC_LIB)
+IFunctionTable* vpu_createFunctionTable();
+IAssembler* vpu_createAssembler(size_t);
+void vpu_initLib(void**);
+#endif
 }
 
+/// \brief  The library has no imports of its own. All memory (including the executable pages) is allocated through 
+///         this table of host functions, which is handed to vpu_initLib. On Windows these are the Win32 functions 
+///         themselves, elsewhere they are the POSIX equivalents found in vpu::posix (with matching arguments). 
+enum HostFunction
+{
+  kHostHeap,      ///< heap handle passed to kHostAlloc / kHostFree
+  kHostProcess,   ///< process handle passed to kHostPageAlloc / kHostPageFree
+  kHostAlloc,     ///< HeapAlloc(heap, flags, size)
+  kHostFree,      ///< HeapFree(heap, flags, ptr)
+  kHostPageAlloc, ///< VirtualAllocEx(process, address, size, type, protection)
+  kHostPageFree,  ///< VirtualFreeEx(process, address, size, type)
+  kHostStrCmp,    ///< lstrcmpA(a, b)
+  kHostStrLen,    ///< lstrlenA(str)
+  kHostTableSize
+};
+
+#if !defined(_WIN32)
+/// \brief  POSIX versions of the Win32 functions found in the host table. 
+namespace posix
+{
+  /// Win32 flags & protection values that the library passes through the host table
+  enum : uint32_t
+  {
+    kHeapZeroMemory = 0x08,
+    kPageReadWrite = 0x04,
+    kPageExecuteRead = 0x20,
+    kPageExecuteReadWrite = 0x40
+  };
+
+  /// \brief  convert a Win32 page protection value into mmap/mprotect flags. Pages are never mapped writable and 
+  ///         executable: PAGE_EXECUTE_READWRITE (which the library asks for, for an assembler's page) is mapped 
+  ///         read/write, and the code is switched to read/execute explicitly (see setExecutable). 
+  inline int protection(uint32_t win32_protection)
+  {
+    switch (win32_protection)
+    {
+    case kPageExecuteRead: return PROT_READ | PROT_EXEC;
+    default: break;
+    }
+    return PROT_READ | PROT_WRITE;
+  }
+
+  inline void* heapAlloc(void*, uint32_t flags, size_t size)
+    { return (flags & kHeapZeroMemory) ? calloc(1, size) : malloc(size); }
+
+  inline int heapFree(void*, uint32_t, void* ptr)
+    { free(ptr); return 1; }
+
+  inline size_t pageSize()
+    { return size_t(sysconf(_SC_PAGESIZE)); }
+
+  /// \brief  Maps size bytes (rounded up to whole pages) after a read/write header page, which records the size of the 
+  ///         whole mapping. The library frees pages the Win32 way, where the size passed with MEM_RELEASE is 0, so 
+  ///         pageFree has to look the size up. The pages are mapped as read/write, and then switched to prot with 
+  ///         mprotect (some hardened kernels refuse to hand out PROT_EXEC directly from mmap). 
+  inline void* mapPages(size_t size, int prot, int flags)
+    {
+      const size_t page = pageSize();
+      const size_t total = page + ((size + page - 1) & ~(page - 1));
+      uint8_t* base = (uint8_t*)mmap(0, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+      if ((void*)base == MAP_FAILED) 
+        return 0;
+      if (prot != (PROT_READ | PROT_WRITE) && mprotect(base + page, total - page, prot) != 0)
+      {
+        munmap(base, total);
+        return 0;
+      }
+      memcpy(base, &total, sizeof(total));
+      return base + page;
+    }
+
+  inline void* pageAlloc(void*, void*, size_t size, uint32_t, uint32_t win32_protection)
+    { return mapPages(size, protection(win32_protection), 0); }
+
+  /// \brief  Unmaps the whole mapping made by mapPages, whatever size & free type the library passes. 
+  inline int pageFree(void*, void* ptr, size_t, uint32_t)
+    {
+      if (!ptr)
+        return 0;
+      uint8_t* base = (uint8_t*)ptr - pageSize();
+      size_t total;
+      memcpy(&total, base, sizeof(total));
+      return munmap(base, total) == 0;
+    }
+
+  inline int strCmp(const char* a, const char* b)
+    { return strcmp(a, b); }
+
+  inline int strLen(const char* str)
+    { return int(strlen(str)); }
+}
+#endif
+
 /// \brief  An enum describing the prototype for a function
 enum FunctionType 
 {
@@ -54,6 +183,8 @@ enum FunctionType
 
 /// These are the only allowable prototypes for supported __vectorcall functions. 
 /// Arguments are passed in using YMM0 -> YMM4. 
+/// For code assembled by vpu::Emitter with the kSystemV calling convention, these are just ordinary GCC/Clang functions 
+/// (which receive their __m256 arguments in YMM0 -> YMM4 anyway), and VPU_VECTORCALL expands to nothing. 
 /// The return argument will be within YMM0. If you need to mix int/float/double args, then just cast the argument.
 /// \code
 /// __m256 __vectorcall some_func(__m256 a, __m256 b, __m256 c)
@@ -65,19 +196,19 @@ enum FunctionType
 /// \endcode
 /// The assembler is not going to validate what type of data you have loaded in the YMM registers, it willjust make the call.
 /// So this mechanism can be abused somewhat (and this also means typesafety is left up to you).
-typedef __m256 (__vectorcall *func_no_args_f)();
-typedef __m256 (__vectorcall *func_one_arg_f)(__m256);
-typedef __m256 (__vectorcall *func_two_args_f)(__m256, __m256);
-typedef __m256 (__vectorcall *func_three_args_f)(__m256, __m256, __m256);
-typedef __m256 (__vectorcall *func_four_args_f)(__m256, __m256, __m256, __m256);
-typedef __m256 (__vectorcall *func_five_args_f)(__m256, __m256, __m256, __m256, __m256);
-
-typedef __m256d (__vectorcall *func_no_args_d)();
-typedef __m256d (__vectorcall *func_one_arg_d)(__m256d);
-typedef __m256d (__vectorcall *func_two_args_d)(__m256d, __m256d);
-typedef __m256d (__vectorcall *func_three_args_d)(__m256d, __m256d, __m256d);
-typedef __m256d (__vectorcall *func_four_args_d)(__m256d, __m256d, __m256d, __m256d);
-typedef __m256d (__vectorcall *func_five_args_d)(__m256d, __m256d, __m256d, __m256d, __m256d);
+typedef __m256 (VPU_VECTORCALL *func_no_args_f)();
+typedef __m256 (VPU_VECTORCALL *func_one_arg_f)(__m256);
+typedef __m256 (VPU_VECTORCALL *func_two_args_f)(__m256, __m256);
+typedef __m256 (VPU_VECTORCALL *func_three_args_f)(__m256, __m256, __m256);
+typedef __m256 (VPU_VECTORCALL *func_four_args_f)(__m256, __m256, __m256, __m256);
+typedef __m256 (VPU_VECTORCALL *func_five_args_f)(__m256, __m256, __m256, __m256, __m256);
+
+typedef __m256d (VPU_VECTORCALL *func_no_args_d)();
+typedef __m256d (VPU_VECTORCALL *func_one_arg_d)(__m256d);
+typedef __m256d (VPU_VECTORCALL *func_two_args_d)(__m256d, __m256d);
+typedef __m256d (VPU_VECTORCALL *func_three_args_d)(__m256d, __m256d, __m256d);
+typedef __m256d (VPU_VECTORCALL *func_four_args_d)(__m256d, __m256d, __m256d, __m256d);
+typedef __m256d (VPU_VECTORCALL *func_five_args_d)(__m256d, __m256d, __m256d, __m256d, __m256d);
 
 /// \brief  A class that stores a table of functions that can be called by the assembled code. 
 struct IFunctionTable
@@ -136,18 +267,18 @@ public:
   /// \brief  Allows you to add your own custom functions into the table. 
   ///         Only __vectorcall functions are supported.
   ///         The name must be unique for each function - funtion overloading is not supported.
-  inline void addFunc(const char* name, func_no_args_f fn) { _addFunc(name, fn, kNoArgs); }
-  inline void addFunc(const char* name, func_one_arg_f fn) { _addFunc(name, fn, kOneArg); }
-  inline void addFunc(const char* name, func_two_args_f fn) { _addFunc(name, fn, kTwoArgs); }
-  inline void addFunc(const char* name, func_three_args_f fn) { _addFunc(name, fn, kThreeArgs); }
-  inline void addFunc(const char* name, func_four_args_f fn) { _addFunc(name, fn, kFourArgs); }
-  inline void addFunc(const char* name, func_five_args_f fn) { _addFunc(name, fn, kFiveArgs); }
-  inline void addFunc(const char* name, func_no_args_d fn) { _addFunc(name, fn, kNoArgsD); }
-  inline void addFunc(const char* name, func_one_arg_d fn) { _addFunc(name, fn, kOneArgD); }
-  inline void addFunc(const char* name, func_two_args_d fn) { _addFunc(name, fn, kTwoArgsD); }
-  inline void addFunc(const char* name, func_three_args_d fn) { _addFunc(name, fn, kThreeArgsD); }
-  inline void addFunc(const char* name, func_four_args_d fn) { _addFunc(name, fn, kFourArgsD); }
-  inline void addFunc(const char* name, func_five_args_d fn) { _addFunc(name, fn, kFiveArgsD); }
+  inline void addFunc(const char* name, func_no_args_f fn) { _addFunc(name, (void*)fn, kNoArgs); }
+  inline void addFunc(const char* name, func_one_arg_f fn) { _addFunc(name, (void*)fn, kOneArg); }
+  inline void addFunc(const char* name, func_two_args_f fn) { _addFunc(name, (void*)fn, kTwoArgs); }
+  inline void addFunc(const char* name, func_three_args_f fn) { _addFunc(name, (void*)fn, kThreeArgs); }
+  inline void addFunc(const char* name, func_four_args_f fn) { _addFunc(name, (void*)fn, kFourArgs); }
+  inline void addFunc(const char* name, func_five_args_f fn) { _addFunc(name, (void*)fn, kFiveArgs); }
+  inline void addFunc(const char* name, func_no_args_d fn) { _addFunc(name, (void*)fn, kNoArgsD); }
+  inline void addFunc(const char* name, func_one_arg_d fn) { _addFunc(name, (void*)fn, kOneArgD); }
+  inline void addFunc(const char* name, func_two_args_d fn) { _addFunc(name, (void*)fn, kTwoArgsD); }
+  inline void addFunc(const char* name, func_three_args_d fn) { _addFunc(name, (void*)fn, kThreeArgsD); }
+  inline void addFunc(const char* name, func_four_args_d fn) { _addFunc(name, (void*)fn, kFourArgsD); }
+  inline void addFunc(const char* name, func_five_args_d fn) { _addFunc(name, (void*)fn, kFiveArgsD); }
 
   /// \brief  Query the type of function for a given name
   /// \param  name the name of the function to query
@@ -201,6 +332,74 @@ enum Reg : uint8_t
   R15,
 };
 
+/// \brief  The calling convention followed by code assembled with vpu::Emitter (lib_asm_emitter.h), both on entry, and 
+///         when calling functions in an IFunctionTable. The library (IAssembler) only generates kWin64 code. 
+///         kWin64   : data arrives in RCX, the function table in RDX (and the 'extra' argument in R8). call() follows the 
+///                    __vectorcall rules, so RBX, RBP, RDI, RSI, R12 -> R15 and the lower halves of YMM6 -> YMMF survive 
+///                    the call. The caller must reserve shadow space on the stack (see callStackSpace). 
+///         kSystemV : data arrives in RDI, the function table in RSI (and the 'extra' argument in RDX). call() can target 
+///                    plain GCC/Clang functions that take and return __m256. Only RBX, RBP and R12 -> R15 survive the call, 
+///                    all YMM registers are caller saved, and no shadow space is needed.
+enum CallingConvention : uint8_t
+{
+  kWin64,
+  kSystemV,
+#if defined(_WIN32)
+  kNativeConvention = kWin64
+#else
+  kNativeConvention = kSystemV
+#endif
+};
+
+/// \brief  returns the register holding an argument on entry to the assembled code 
+/// \param  convention the calling convention used by the code
+/// \param  index 0 for the 'data' argument, 1 for the 'function table', 2 for the 'extra' argument.
+inline Reg argumentRegister(CallingConvention convention, uint32_t index)
+{
+  static const Reg win64[] = { RCX, RDX, R8, R9 };
+  static const Reg sysv[] = { RDI, RSI, RDX, RCX };
+  return convention == kSystemV ? sysv[index & 3] : win64[index & 3];
+}
+
+/// \brief  returns true if the register must be preserved by the assembled code (restore it before ret() if you modify 
+///         it), and will therefore also be left intact by any function you call(). 
+inline bool isCalleeSaved(CallingConvention convention, Reg r)
+{
+  switch (r)
+  {
+  case RBX: case RBP: case RSP: case R12: case R13: case R14: case R15: return true;
+  case RSI: case RDI: return convention == kWin64;
+  default: break;
+  }
+  return false;
+}
+
+/// \brief  returns true if the register must be preserved by the assembled code. For kWin64 only the lower 128bits of 
+///         YMM6 -> YMMF are preserved, so treat the upper halves as lost across a call(). 
+inline bool isCalleeSaved(CallingConvention convention, AVXReg r)
+{
+  return convention == kWin64 && r >= YMM6;
+}
+
+/// \brief  returns the number of __m256 (or __m256d) arguments taken by a function of the given type
+inline uint32_t numArguments(FunctionType type)
+{
+  return uint32_t(type) % 6;
+}
+
+/// \brief  returns the number of bytes (starting at RSP) that must be reserved on the stack before call()ing a function 
+///         of the given type. The function is free to overwrite them, so don't keep anything there that you need after 
+///         the call. For kWin64, a __vectorcall function may spill each of its __m256 arguments into the caller's stack 
+///         (32 bytes each, which MSVC debug builds do), so the usual 32 bytes of shadow space is only enough for functions 
+///         taking zero or one arguments. RSP must also be a multiple of 16 at the point of the call.
+inline uint32_t callStackSpace(CallingConvention convention, FunctionType type)
+{
+  if (convention == kSystemV)
+    return 0;
+  const uint32_t num_args = numArguments(type);
+  return num_args > 1 ? 32 * num_args : 32;
+}
+
 /// Floating point comparison modes
 enum cmp : uint8_t
 {
@@ -1211,38 +1410,80 @@ public:
   virtual bool i64gatherpd(AVXReg target, AVXReg indices, AVXReg mask, Reg address, uint32_t disp, uint8_t scale) = 0;
 };
 
+/// \brief  Outside of Windows, an assembler's page is mapped read/write (see posix::protection), so its code can't be 
+///         run until it has been made executable. Call this after end() and before execute(), and again with false 
+///         before begin()ing the assembler again. On Windows the library allocates the page itself as 
+///         PAGE_EXECUTE_READWRITE, and this does nothing. 
+/// \param  a the assembler
+/// \param  executable true to switch the code to read/execute, false to switch it back to read/write
+/// \return false if the protection could not be changed
+inline bool setExecutable(IAssembler* a, bool executable = true)
+{
+#if defined(_WIN32)
+  (void)a;
+  (void)executable;
+  return true;
+#else
+  const size_t page = posix::pageSize();
+  const size_t num_bytes = (a->numBytes() + page - 1) & ~(page - 1);
+  return !num_bytes ||
+    mprotect((void*)a->bytecode(), num_bytes, executable ? PROT_READ | PROT_EXEC : PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
 /// \brief  A little utility class which acts as the main entry point into the runtime assembler lib. 
-///         It's main purpose is to load the DLL dynamically, and safely initialise the libs internals. 
+///         It's main purpose is to load the DLL (or shared object) dynamically, and safely initialise the libs internals. 
+///         If VPU_STATIC_LIB is defined, the library is expected to be linked in, and the path is ignored. 
 class AssemblerLib 
 {
 public:
 
   /// \brief  constructor. 
-  /// \param  path  the path to the libASM.dll 
-  inline AssemblerLib(const char* path = "libASM.dll")
+  /// \param  path  the path to the libASM.dll (or libASM.so)
+  inline AssemblerLib(const char* path = VPU_LIB_NAME)
     {
-      // initialise required Win32 information
-      g_win32Ptrs[0] = GetProcessHeap();
-      g_win32Ptrs[1] = GetCurrentProcess();
-      g_win32Ptrs[2] = HeapAlloc;
-      g_win32Ptrs[3] = HeapFree;
-      g_win32Ptrs[4] = VirtualAllocEx;
-      g_win32Ptrs[5] = VirtualFreeEx;
-      g_win32Ptrs[6] = lstrcmpA;
-      g_win32Ptrs[7] = lstrlenA;
+      // initialise the table of host functions the library allocates memory with
+#if defined(_WIN32)
+      m_hostPtrs[kHostHeap] = GetProcessHeap();
+      m_hostPtrs[kHostProcess] = GetCurrentProcess();
+      m_hostPtrs[kHostAlloc] = HeapAlloc;
+      m_hostPtrs[kHostFree] = HeapFree;
+      m_hostPtrs[kHostPageAlloc] = VirtualAllocEx;
+      m_hostPtrs[kHostPageFree] = (void*)releasePages;
+      m_hostPtrs[kHostStrCmp] = lstrcmpA;
+      m_hostPtrs[kHostStrLen] = lstrlenA;
+#else
+      m_hostPtrs[kHostHeap] = 0;
+      m_hostPtrs[kHostProcess] = 0;
+      m_hostPtrs[kHostAlloc] = (void*)posix::heapAlloc;
+      m_hostPtrs[kHostFree] = (void*)posix::heapFree;
+      m_hostPtrs[kHostPageAlloc] = (void*)posix::pageAlloc;
+      m_hostPtrs[kHostPageFree] = (void*)posix::pageFree;
+      m_hostPtrs[kHostStrCmp] = (void*)posix::strCmp;
+      m_hostPtrs[kHostStrLen] = (void*)posix::strLen;
+#endif
 
+#if defined(VPU_STATIC_LIB)
+      // nothing to load, the entry points are linked in
+      (void)path;
+      m_dll = 0;
+      m_init = vpu_initLib;
+      m_fnFn = vpu_createFunctionTable;
+      m_asmFn = vpu_createAssembler;
+      m_init(m_hostPtrs);
+#else
       // load the dll
-      m_dll = LoadLibraryA(path);
+      m_dll = loadModule(path);
       if (m_dll) 
       {
         // extract API functions
-        m_init = (InitLibFn)GetProcAddress(m_dll, "vpu_initLib");
-        m_fnFn = (CreateFunctionTableFn)GetProcAddress(m_dll, "vpu_createFunctionTable");
-        m_asmFn = (CreateAssemblerFn)GetProcAddress(m_dll, "vpu_createAssembler");
+        m_init = (InitLibFn)findSymbol(m_dll, "vpu_initLib");
+        m_fnFn = (CreateFunctionTableFn)findSymbol(m_dll, "vpu_createFunctionTable");
+        m_asmFn = (CreateAssemblerFn)findSymbol(m_dll, "vpu_createAssembler");
         if (m_init && m_fnFn && m_asmFn) 
         {
           // all ok, init
-          m_init(g_win32Ptrs);
+          m_init(m_hostPtrs);
         }
         else 
         {
@@ -1258,6 +1499,7 @@ public:
         m_fnFn = 0;
         m_asmFn = 0;
       }
+#endif
     }
 
   /// \brief  dtor, unloads the DLL
@@ -1265,7 +1507,7 @@ public:
     {
       if (m_dll)
       {
-        FreeLibrary(m_dll);
+        unloadModule(m_dll);
         m_dll = 0;
       }
     }
@@ -1280,16 +1522,283 @@ public:
 
   /// \brief  create a new assembler
   /// \param  page_size This param controls the size of the executable memory page allocated by the assembler. 
-  ///         By default this is 4K, but you may require a larger memory page. 
+  ///         By default this is 4K, but you may require a larger memory page (or see createGrowableAssembler). 
   inline IAssembler* createAssembler(size_t page_size = 4096)
     { return m_asmFn ? m_asmFn(page_size) : 0; }
 
+  /// \brief  returns a value that identifies the build of the library that has been loaded (or the executable it has 
+  ///         been linked into), which changes whenever the library is rebuilt. Use it to invalidate any machine code 
+  ///         that has been saved to disk. Returns 0 if the library has not been loaded.
+  inline uint64_t buildId() const
+    {
+      if (!isOk())
+        return 0;
+#if defined(_WIN32)
+      // the link timestamp and image size from the PE header
+      const uint8_t* image = (const uint8_t*)(m_dll ? m_dll : GetModuleHandleA(0));
+      const IMAGE_NT_HEADERS* nt = (const IMAGE_NT_HEADERS*)(image + ((const IMAGE_DOS_HEADER*)image)->e_lfanew);
+      return (uint64_t(nt->FileHeader.TimeDateStamp) << 32) | nt->OptionalHeader.SizeOfImage;
+#else
+      // the build-id note the linker wrote into the library, or failing that, a hash of the file it was loaded from
+      // (the modification time & size of a file say nothing about its contents)
+# if defined(__linux__)
+      BuildIdQuery query = { (const void*)m_init, 0 };
+      dl_iterate_phdr(findBuildId, &query);
+      if (query.id)
+        return query.id;
+# endif
+      Dl_info info;
+      if (!dladdr((void*)m_init, &info) || !info.dli_fname)
+        return 0;
+      return hashFile(info.dli_fname);
+#endif
+    }
+
+  enum : size_t
+  {
+    kDefaultGrowableSize = 64 * 1024 * 1024
+  };
+
+  /// \brief  create an assembler whose code buffer is a large reservation of ordinary read/write memory, rather than an 
+  ///         executable page_size chosen up front. Pages are only backed by physical memory (and on Windows, only 
+  ///         committed) once the assembler touches them, so a small kernel costs no more than it would in a 4K page. 
+  ///         max_size is a fixed ceiling: the buffer never grows past it. The library does not check the size of its 
+  ///         buffer, so the reservation is followed by a guard page, and a kernel that outgrows it faults there rather 
+  ///         than writing over other memory. The buffer is not executable, so execute() cannot be used. end() belongs to 
+  ///         the library and can't copy the code anywhere, so once end() has been called, commit the assembler to a 
+  ///         CodeArena (lib_asm_arena.h), which copies it into exact-size executable memory. 
+  ///         This relies on the library allocating its buffer through the host table while the assembler is created. 
+  ///         If it does not, the assembler is released and null is returned. Not thread safe with respect to other 
+  ///         createAssembler calls on the same AssemblerLib. 
+  /// \param  max_size the size of the reservation, i.e. the largest kernel (code + constants) that can be assembled
+  inline IAssembler* createGrowableAssembler(size_t max_size = kDefaultGrowableSize)
+    {
+      // the library keeps a pointer to the host table, so swap the page allocator out for this one assembler
+      void* pageAlloc = m_hostPtrs[kHostPageAlloc];
+      const uint32_t reserved = numReservations();
+      m_hostPtrs[kHostPageAlloc] = (void*)reservePages;
+      IAssembler* a = createAssembler((max_size + 4095) & ~size_t(4095));
+      m_hostPtrs[kHostPageAlloc] = pageAlloc;
+      if (a && numReservations() == reserved)
+      {
+        // the buffer is an ordinary executable page, of max_size bytes
+        a->release();
+        return 0;
+      }
+      return a;
+    }
+
 private:
-  HMODULE m_dll;
+#if defined(_WIN32)
+  typedef HMODULE Module;
+  static Module loadModule(const char* path) { return LoadLibraryA(path); }
+  static void* findSymbol(Module m, const char* name) { return (void*)GetProcAddress(m, name); }
+  static void unloadModule(Module m) { FreeLibrary(m); }
+#else
+  typedef void* Module;
+  static Module loadModule(const char* path) { return dlopen(path, RTLD_NOW | RTLD_LOCAL); }
+  static void* findSymbol(Module m, const char* name) { return dlsym(m, name); }
+  static void unloadModule(Module m) { dlclose(m); }
+#endif
+
+#if !defined(_WIN32)
+  /// a 64bit FNV-1a hash
+  static uint64_t hashBytes(const uint8_t* data, size_t num_bytes, uint64_t h = 0xCBF29CE484222325ULL)
+    {
+      for (size_t i = 0; i < num_bytes; ++i)
+        h = (h ^ data[i]) * 0x100000001B3ULL;
+      return h;
+    }
+
+  /// a hash of the contents of a file, or 0 if it can't be read
+  static uint64_t hashFile(const char* path)
+    {
+      FILE* fp = fopen(path, "rb");
+      if (!fp)
+        return 0;
+      uint8_t buffer[65536];
+      uint64_t h = hashBytes(0, 0);
+      size_t n;
+      while ((n = fread(buffer, 1, sizeof(buffer), fp)) != 0)
+        h = hashBytes(buffer, n, h);
+      const bool ok = !ferror(fp);
+      fclose(fp);
+      return ok ? h : 0;
+    }
+
+# if defined(__linux__)
+  struct BuildIdQuery
+  {
+    const void* address;  ///< an address within the library
+    uint64_t id;          ///< a hash of its NT_GNU_BUILD_ID note, or 0 if it has none
+  };
+
+  /// dl_iterate_phdr callback, which finds the object containing query->address, and hashes its build-id note
+  static int findBuildId(struct dl_phdr_info* info, size_t, void* data)
+    {
+      BuildIdQuery* query = (BuildIdQuery*)data;
+      const uintptr_t address = uintptr_t(query->address);
+      bool found = false;
+      for (uint32_t i = 0; i < info->dlpi_phnum && !found; ++i)
+      {
+        const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+        const uintptr_t start = uintptr_t(info->dlpi_addr + ph.p_vaddr);
+        found = ph.p_type == PT_LOAD && address >= start && address < start + ph.p_memsz;
+      }
+      if (!found)
+        return 0;
+      for (uint32_t i = 0; i < info->dlpi_phnum; ++i)
+      {
+        const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+        if (ph.p_type != PT_NOTE)
+          continue;
+        const uint8_t* note = (const uint8_t*)(info->dlpi_addr + ph.p_vaddr);
+        const uint8_t* end = note + ph.p_memsz;
+        while (note + sizeof(ElfW(Nhdr)) <= end)
+        {
+          const ElfW(Nhdr)* n = (const ElfW(Nhdr)*)note;
+          const uint8_t* name = note + sizeof(ElfW(Nhdr));
+          const uint8_t* desc = name + ((n->n_namesz + 3) & ~3u);
+          if (desc + n->n_descsz > end)
+            break;
+          if (n->n_type == NT_GNU_BUILD_ID && n->n_namesz == 4 && !memcmp(name, "GNU", 4))
+          {
+            query->id = hashBytes(desc, n->n_descsz);
+            return 1;
+          }
+          note = desc + ((n->n_descsz + 3) & ~3u);
+        }
+      }
+      return 1;
+    }
+# endif
+#endif
+
+  /// the number of times reservePages has been called
+  static uint32_t& numReservations()
+    {
+      static uint32_t count = 0;
+      return count;
+    }
+
+#if defined(_WIN32)
+  /// the header page of a growable region, which is followed by the pages [begin, end) that are committed on demand, 
+  /// and then a guard page that never is
+  struct GrowableRegion
+  {
+    GrowableRegion* next;
+    uint8_t* begin;
+    uint8_t* end;
+  };
+
+  enum : size_t
+  {
+    kRegionPage = 4096,
+    kCommitStep = 64 * 1024
+  };
+
+  static SRWLOCK& regionLock()
+    {
+      static SRWLOCK lock = SRWLOCK_INIT;
+      return lock;
+    }
+
+  static GrowableRegion*& regions()
+    {
+      static GrowableRegion* head = 0;
+      return head;
+    }
+
+  /// commits the pages of a growable region as they are first touched
+  static LONG WINAPI commitOnDemand(EXCEPTION_POINTERS* e)
+    {
+      const EXCEPTION_RECORD* r = e->ExceptionRecord;
+      if (r->ExceptionCode != EXCEPTION_ACCESS_VIOLATION || r->NumberParameters < 2)
+        return EXCEPTION_CONTINUE_SEARCH;
+      uint8_t* address = (uint8_t*)r->ExceptionInformation[1];
+      LONG result = EXCEPTION_CONTINUE_SEARCH;
+      AcquireSRWLockShared(&regionLock());
+      for (const GrowableRegion* g = regions(); g; g = g->next)
+      {
+        if (address >= g->begin && address < g->end)
+        {
+          uint8_t* page = g->begin + ((address - g->begin) & ~(kRegionPage - 1));
+          const size_t size = size_t(g->end - page) < kCommitStep ? size_t(g->end - page) : kCommitStep;
+          if (VirtualAlloc(page, size, MEM_COMMIT, PAGE_READWRITE))
+            result = EXCEPTION_CONTINUE_EXECUTION;
+          break;
+        }
+      }
+      ReleaseSRWLockShared(&regionLock());
+      return result;
+    }
+
+  /// reserves a header page, size bytes of read/write memory that are committed as they are touched, and a guard page
+  static void* WINAPI reservePages(void* process, void*, size_t size, uint32_t, uint32_t)
+    {
+      static const PVOID handler = AddVectoredExceptionHandler(1, commitOnDemand);
+      if (!handler)
+        return 0;
+      uint8_t* base = (uint8_t*)VirtualAllocEx(process, 0, kRegionPage + size + kRegionPage, MEM_RESERVE, PAGE_READWRITE);
+      if (!base)
+        return 0;
+      if (!VirtualAllocEx(process, base, kRegionPage, MEM_COMMIT, PAGE_READWRITE))
+      {
+        VirtualFreeEx(process, base, 0, MEM_RELEASE);
+        return 0;
+      }
+      GrowableRegion* g = (GrowableRegion*)base;
+      g->begin = base + kRegionPage;
+      g->end = g->begin + size;
+      AcquireSRWLockExclusive(&regionLock());
+      g->next = regions();
+      regions() = g;
+      ReleaseSRWLockExclusive(&regionLock());
+      ++numReservations();
+      return g->begin;
+    }
+
+  /// releases the whole reservation of a growable region, and passes any other pages on to VirtualFreeEx as they are
+  static BOOL WINAPI releasePages(HANDLE process, LPVOID ptr, SIZE_T size, DWORD type)
+    {
+      GrowableRegion* region = 0;
+      AcquireSRWLockExclusive(&regionLock());
+      for (GrowableRegion** g = &regions(); *g; g = &(*g)->next)
+      {
+        if ((*g)->begin == ptr)
+        {
+          region = *g;
+          *g = region->next;
+          break;
+        }
+      }
+      ReleaseSRWLockExclusive(&regionLock());
+      return region ? VirtualFreeEx(process, region, 0, MEM_RELEASE) : VirtualFreeEx(process, ptr, size, type);
+    }
+#else
+  /// reserves size bytes of read/write memory that is only backed as it is touched, followed by a guard page
+  static void* reservePages(void*, void*, size_t size, uint32_t, uint32_t)
+    {
+      const size_t page = posix::pageSize();
+      size = (size + page - 1) & ~(page - 1);
+      uint8_t* ptr = (uint8_t*)posix::mapPages(size + page, PROT_READ | PROT_WRITE, MAP_NORESERVE);
+      if (!ptr)
+        return 0;
+      if (mprotect(ptr + size, page, PROT_NONE) != 0)
+      {
+        posix::pageFree(0, ptr, 0, 0);
+        return 0;
+      }
+      ++numReservations();
+      return ptr;
+    }
+#endif
+
+  Module m_dll;
   InitLibFn m_init;
   CreateFunctionTableFn m_fnFn;
   CreateAssemblerFn m_asmFn;
-  void* g_win32Ptrs[8];
+  void* m_hostPtrs[kHostTableSize];
 };
 
 } // vpu
@@ -0,0 +1,546 @@
+/// \file   lib_asm_arena.h
+/// \brief  A shared pool of executable memory for finished kernels. Each IAssembler owns a page of executable memory
+///         that it assembles into, which is fine for a handful of large kernels, but wasteful when generating thousands
+///         of tiny ones (most of each page is empty, and each kernel costs an iTLB entry). The arena copies finished
+///         kernels into large shared regions instead, packed back to back. Optionally, each region can be mapped twice 
+///         (a writable view and an executable view of the same memory), so that no page is ever writable and executable. 
+/// \note   Copyright Rob Bateman. I accept no liability for any damage done to you, your computer(s), your client(s), or any other hardware/software
+///         problem that may arise from using this software. Use at your own risk.
+
+#pragma once
+#include "lib_asm.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#if !defined(_WIN32)
+# include <cstdio>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+namespace vpu
+{
+/// \brief  A kernel that has been copied into a CodeArena.
+struct Kernel
+{
+  const uint8_t* code;            ///< start of the code (and the constants that follow it)
+  uint8_t* writable;              ///< the same bytes, viewed through writable memory (see CodeArena::patch)
+  size_t numBytes;                ///< size of the code + constants
+  CallingConvention convention;   ///< the calling convention the code was assembled with
+
+  /// \brief  run the kernel
+  /// \param  data the 'data' argument (RCX for kWin64, RDI for kSystemV)
+  /// \param  table the raw function table (see resolveFunctionTable), or null if the kernel makes no calls.
+  inline void execute(void* data, void** table = 0) const
+    {
+#if defined(_MSC_VER)
+      // MSVC can only call kWin64 code
+      ((FuncProtoype)code)(data, table);
+#else
+      typedef void (__attribute__((ms_abi)) *Win64Fn)(void*, void**);
+      typedef void (__attribute__((sysv_abi)) *SystemVFn)(void*, void**);
+      if (convention == kWin64)
+        ((Win64Fn)code)(data, table);
+      else
+        ((SystemVFn)code)(data, table);
+#endif
+    }
+};
+
+/// \brief  IAssembler::execute(data, map) passes the functions within the table to the code (rather than the table
+///         itself). Kernels run from an arena need that raw array, so this runs a tiny bit of code that stores the
+///         table register into a pointer, and returns it. The library only generates kWin64 code, so the table
+///         arrives in RDX here, whatever the convention of the kernels the array is then passed to.
+/// \param  scratch an assembler to run the code with (its current contents will be lost)
+/// \param  table the function table to resolve
+/// \return the array of function pointers the assembled code indexes with call()
+inline void** resolveFunctionTable(IAssembler* scratch, const IFunctionTable* table)
+{
+  void** functions = 0;
+  scratch->begin();
+    scratch->mov64(RCX, 0, RDX);
+    scratch->ret();
+  scratch->end();
+  setExecutable(scratch);
+  scratch->execute(&functions, table);
+  setExecutable(scratch, false);
+  return functions;
+}
+
+/// \brief  The constants are stored after the code, at 32 byte offsets, in the order they were created. 
+/// \param  num_bytes the size of the kernel (code + constants)
+/// \param  num_constants the number of constants the kernel was assembled with
+/// \param  index the constant index returned from set1_ps, set_epi32, etc
+/// \return the offset of the constant from the start of the kernel
+inline size_t constantOffset(size_t num_bytes, uint32_t num_constants, uint32_t index)
+{
+  return num_bytes - 32 * size_t(num_constants - index);
+}
+
+/// \brief  memory usage of a CodeArena
+struct ArenaStats
+{
+  size_t numRegions;      ///< number of executable regions that have been mapped
+  size_t numHugeRegions;  ///< how many of those regions are backed by huge pages
+  size_t reservedBytes;   ///< total size of all regions
+  size_t usedBytes;       ///< bytes held by live kernels, including alignment padding
+  size_t codeBytes;       ///< bytes of code + constants that have been committed
+  size_t paddingBytes;    ///< bytes lost to aligning the start of the kernel after each live kernel
+  size_t freeBytes;       ///< bytes of released kernels, waiting to be reused
+  size_t numKernels;      ///< number of kernels committed (and not released)
+};
+
+/// \brief  A bump allocator over large regions of executable memory. Assemble as normal, and once end() has been
+///         called, commit() the assembler to copy the finished code into the arena. The assembler can then be reused
+///         for the next kernel (or released). The assembled code is position independent (constants are addressed
+///         relative to the instruction pointer, and jumps are relative), so it runs unmodified from its new location.
+///         Kernels live until they are released, or the arena is reset() or destroyed. The arena is not thread safe.
+class CodeArena
+{
+public:
+
+  enum Flags : uint32_t
+  {
+    kHugePages = 1 << 0,  ///< back the regions with 2MB pages where the OS allows it (falls back to normal pages if not)
+    kDualMapped = 1 << 1  ///< map each region twice, once as read/write and once as read/execute, rather than as a 
+                          ///< single read/write/execute region. Kernels are copied in (and patched) through the writable
+                          ///< view, and run from the executable one. kHugePages is ignored.
+  };
+
+  enum : size_t
+  {
+    kHugePageSize = 2 * 1024 * 1024,
+    kDefaultRegionSize = 2 * 1024 * 1024
+  };
+
+  /// \brief  ctor
+  /// \param  region_size the size of each executable region. Kernels larger than this get a region to themselves.
+  /// \param  alignment the alignment of the start of each kernel, either 16 or 32. The constants follow the code at
+  ///         32 byte offsets, so use 32 unless your kernels do not use any constants.
+  /// \param  flags a combination of the Flags values
+  inline CodeArena(size_t region_size = kDefaultRegionSize, uint32_t alignment = 32, uint32_t flags = 0)
+    : m_regionSize(region_size), m_alignment(alignment < 16 ? 16 : alignment), m_flags(flags)
+    {
+      memset(&m_stats, 0, sizeof(m_stats));
+    }
+
+  /// \brief  dtor, unmaps all regions (any kernels committed to the arena are no longer valid)
+  inline ~CodeArena()
+    { reset(); }
+
+  /// \brief  copy a finished kernel into the arena.
+  /// \param  a the assembler to copy the code from. end() must have been called.
+  /// \param  convention the calling convention the assembler was created with.
+  /// \return the kernel, or a kernel with a null code pointer if the memory could not be allocated.
+  inline Kernel commit(const IAssembler* a, CallingConvention convention = kWin64)
+    { return commit(a->bytecode(), a->numBytes(), convention); }
+
+  /// \brief  copy some machine code into the arena
+  inline Kernel commit(const void* code, size_t num_bytes, CallingConvention convention = kWin64)
+    {
+      Kernel k = reserve(num_bytes, convention);
+      if (k.code)
+        memcpy(k.writable, code, num_bytes);
+      return k;
+    }
+
+  /// \brief  allocate memory from the arena without copying anything into it, e.g. for a vpu::ConstantPool (see
+  ///         lib_asm_emitter.h) shared by the kernels. Write to it through Kernel::writable, and release it like any
+  ///         other kernel.
+  /// \return the memory, or a kernel with a null code pointer if the memory could not be allocated.
+  inline Kernel reserve(size_t num_bytes, CallingConvention convention = kWin64)
+    {
+      Kernel k = { 0, 0, 0, convention };
+      uint8_t* dst = allocate(num_bytes);
+      if (dst)
+      {
+        k.writable = writableAddress(dst);
+        k.code = dst;
+        k.numBytes = num_bytes;
+        m_stats.codeBytes += num_bytes;
+        ++m_stats.numKernels;
+      }
+      return k;
+    }
+
+  /// \brief  return the memory used by a kernel to the arena, to be reused by later commits. Released memory is merged 
+  ///         with any free memory either side of it, and a region that no longer holds any kernels is unmapped (apart 
+  ///         from the most recent one, which is kept for the next commit). 
+  inline void release(const Kernel& k)
+    {
+      if (!k.code)
+        return;
+      const size_t size = alignedSize(k.numBytes);
+      m_stats.usedBytes -= size;
+      m_stats.paddingBytes -= size - k.numBytes;
+      m_stats.codeBytes -= k.numBytes;
+      --m_stats.numKernels;
+      freeBlock((uint8_t*)k.code, size);
+    }
+
+  /// \brief  overwrite some bytes of a committed kernel, e.g. to change the value of a constant (see constantOffset). 
+  ///         The kernel must not be running on another thread while it is patched. 
+  /// \param  k the kernel to modify
+  /// \param  offset the offset from the start of the kernel to write to
+  /// \param  data the new bytes
+  /// \param  num_bytes the number of bytes to write
+  /// \return false if the write would fall outside of the kernel
+  inline bool patch(const Kernel& k, size_t offset, const void* data, size_t num_bytes)
+    {
+      if (!k.writable || offset > k.numBytes || num_bytes > k.numBytes - offset)
+        return false;
+      memcpy(k.writable + offset, data, num_bytes);
+      return true;
+    }
+
+  /// \brief  re-link a jump or call within a committed kernel. All jumps and calls use 32bit displacements, relative 
+  ///         to the end of the instruction (which is where the displacement ends). 
+  /// \param  k the kernel to modify
+  /// \param  offset the offset of the 4 byte displacement within the kernel
+  /// \param  target the offset within the kernel that the instruction should now jump to
+  /// \return false if the displacement lies outside of the kernel
+  inline bool patchRel32(const Kernel& k, size_t offset, size_t target)
+    {
+      int32_t rel = int32_t(int64_t(target) - int64_t(offset + 4));
+      return patch(k, offset, &rel, sizeof(rel));
+    }
+
+  /// \brief  releases all regions. All kernels previously committed become invalid.
+  inline void reset()
+    {
+      for (size_t i = 0; i < m_regions.size(); ++i)
+        unmapRegion(m_regions[i]);
+      m_regions.clear();
+      m_free.clear();
+      memset(&m_stats, 0, sizeof(m_stats));
+    }
+
+  /// \brief  returns true if the address lies within one of the arenas regions
+  inline bool owns(const void* ptr) const
+    {
+      const uint8_t* p = (const uint8_t*)ptr;
+      for (size_t i = 0; i < m_regions.size(); ++i)
+      {
+        if (p >= m_regions[i].base && p < m_regions[i].base + m_regions[i].size)
+          return true;
+      }
+      return false;
+    }
+
+  /// \brief  query memory usage
+  inline const ArenaStats& stats() const
+    { return m_stats; }
+
+private:
+
+  struct Region
+  {
+    uint8_t* base;      ///< the executable view
+    uint8_t* writable;  ///< the writable view (the same as base, unless kDualMapped)
+    size_t size;
+    size_t used;
+    bool huge;
+  };
+
+  struct Block
+  {
+    uint8_t* ptr;
+    size_t size;
+  };
+
+  /// the size of a kernel, rounded up to the start of the next one
+  inline size_t alignedSize(size_t num_bytes) const
+    { return (num_bytes + m_alignment - 1) & ~size_t(m_alignment - 1); }
+
+  inline static bool blockBefore(const Block& b, const uint8_t* ptr)
+    { return b.ptr < ptr; }
+
+  inline uint8_t* allocate(size_t num_bytes)
+    {
+      if (!num_bytes)
+        return 0;
+      const size_t used = alignedSize(num_bytes);
+
+      // reuse the first released block that is large enough (blocks are aligned, and sorted by address)
+      for (size_t i = 0; i < m_free.size(); ++i)
+      {
+        Block& b = m_free[i];
+        if (b.size < used)
+          continue;
+        uint8_t* ptr = b.ptr;
+        m_stats.freeBytes -= used;
+        if (used < b.size)
+        {
+          // keep the remainder for another kernel
+          b.ptr += used;
+          b.size -= used;
+        }
+        else
+          m_free.erase(m_free.begin() + i);
+        m_stats.usedBytes += used;
+        m_stats.paddingBytes += used - num_bytes;
+        return ptr;
+      }
+
+      // bump allocate from the most recent region
+      if (!m_regions.empty())
+      {
+        Region& r = m_regions.back();
+        size_t start = alignedSize(r.used);
+        if (start + num_bytes <= r.size)
+        {
+          r.used = start + num_bytes;
+          m_stats.usedBytes += used;
+          m_stats.paddingBytes += used - num_bytes;
+          return r.base + start;
+        }
+      }
+
+      // otherwise start a new region (or a dedicated one if the kernel is larger than the region size), replacing the
+      // most recent region if it is empty
+      if (!m_regions.empty() && !m_regions.back().used)
+        removeRegion(m_regions.size() - 1);
+      Region r;
+      if (!mapRegion(r, num_bytes > m_regionSize ? num_bytes : m_regionSize))
+        return 0;
+      r.used = num_bytes;
+      m_regions.push_back(r);
+      ++m_stats.numRegions;
+      m_stats.numHugeRegions += r.huge ? 1 : 0;
+      m_stats.reservedBytes += r.size;
+      m_stats.usedBytes += used;
+      m_stats.paddingBytes += used - num_bytes;
+      return r.base;
+    }
+
+  /// returns an aligned block to the free list, merged with its neighbours within the same region. A block at the end 
+  /// of the most recent region goes back to its bump allocator instead, and a region left with no kernels is unmapped.
+  inline void freeBlock(uint8_t* ptr, size_t size)
+    {
+      size_t index = m_regions.size();
+      while (index-- > 0 && !(ptr >= m_regions[index].base && ptr < m_regions[index].base + m_regions[index].size))
+        ;
+      if (index >= m_regions.size())
+        return;
+      Region& r = m_regions[index];
+      Block b = { ptr, size };
+      std::vector<Block>::iterator it = std::lower_bound(m_free.begin(), m_free.end(), ptr, blockBefore);
+      if (it != m_free.end() && it->ptr == b.ptr + b.size && it->ptr < r.base + r.size)
+      {
+        b.size += it->size;
+        it = m_free.erase(it);
+      }
+      if (it != m_free.begin() && (it - 1)->ptr + (it - 1)->size == b.ptr && (it - 1)->ptr >= r.base)
+      {
+        --it;
+        b.ptr = it->ptr;
+        b.size += it->size;
+        it = m_free.erase(it);
+      }
+
+      const bool last = index + 1 == m_regions.size();
+      if (b.ptr + b.size != r.base + alignedSize(r.used) || !(last || b.ptr == r.base))
+      {
+        m_stats.freeBytes += size;
+        m_free.insert(it, b);
+        return;
+      }
+
+      // the block runs to the end of the regions kernels
+      m_stats.freeBytes -= b.size - size;
+      r.used = size_t(b.ptr - r.base);
+      if (!r.used && !last)
+        removeRegion(index);
+    }
+
+  /// unmaps a region that holds no kernels
+  inline void removeRegion(size_t index)
+    {
+      Region& r = m_regions[index];
+      m_stats.reservedBytes -= r.size;
+      m_stats.numHugeRegions -= r.huge ? 1 : 0;
+      --m_stats.numRegions;
+      unmapRegion(r);
+      m_regions.erase(m_regions.begin() + index);
+    }
+
+  inline uint8_t* writableAddress(uint8_t* ptr) const
+    {
+      for (size_t i = m_regions.size(); i-- > 0; )
+      {
+        const Region& r = m_regions[i];
+        if (ptr >= r.base && ptr < r.base + r.size)
+          return r.writable + (ptr - r.base);
+      }
+      return 0;
+    }
+
+  inline bool mapRegion(Region& r, size_t size)
+    {
+      if (m_flags & kDualMapped)
+        return mapDualRegion(r, (size + 4095) & ~size_t(4095));
+
+      const bool huge = (m_flags & kHugePages) != 0;
+      if (huge)
+        size = (size + kHugePageSize - 1) & ~size_t(kHugePageSize - 1);
+      else
+        size = (size + 4095) & ~size_t(4095);
+      r.base = 0;
+      r.writable = 0;
+      r.size = size;
+      r.used = 0;
+      r.huge = false;
+
+#if defined(_WIN32)
+      if (huge)
+      {
+        // requires the SeLockMemoryPrivilege, so this will fail for most processes
+        SIZE_T large = GetLargePageMinimum();
+        if (large && (size % large) == 0)
+        {
+          r.base = (uint8_t*)VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_EXECUTE_READWRITE);
+          r.huge = r.base != 0;
+        }
+      }
+      if (!r.base)
+        r.base = (uint8_t*)VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+#else
+      void* ptr = MAP_FAILED;
+# if defined(MAP_HUGETLB)
+      if (huge)
+      {
+        ptr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        r.huge = ptr != MAP_FAILED;
+      }
+# endif
+      if (ptr == MAP_FAILED)
+      {
+        ptr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+          return false;
+# if defined(MADV_HUGEPAGE)
+        // no reserved huge pages available, so ask for transparent ones instead
+        if (huge)
+          madvise(ptr, size, MADV_HUGEPAGE);
+# endif
+      }
+      if (mprotect(ptr, size, PROT_READ | PROT_WRITE | PROT_EXEC) != 0)
+      {
+        munmap(ptr, size);
+        return false;
+      }
+      r.base = (uint8_t*)ptr;
+#endif
+      r.writable = r.base;
+      return r.base != 0;
+    }
+
+  /// maps the same memory twice, writable and executable
+  inline static bool mapDualRegion(Region& r, size_t size)
+    {
+      r.base = 0;
+      r.writable = 0;
+      r.size = size;
+      r.used = 0;
+      r.huge = false;
+
+#if defined(_WIN32)
+      HANDLE section = CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_EXECUTE_READWRITE | SEC_COMMIT, 
+                                          DWORD(uint64_t(size) >> 32), DWORD(size), 0);
+      if (!section)
+        return false;
+      r.writable = (uint8_t*)MapViewOfFile(section, FILE_MAP_WRITE, 0, 0, size);
+      r.base = (uint8_t*)MapViewOfFile(section, FILE_MAP_READ | FILE_MAP_EXECUTE, 0, 0, size);
+
+      // the views keep the section alive
+      CloseHandle(section);
+      if (!r.writable || !r.base)
+      {
+        if (r.writable) UnmapViewOfFile(r.writable);
+        if (r.base) UnmapViewOfFile(r.base);
+        r.writable = r.base = 0;
+        return false;
+      }
+#else
+      int fd = openSharedMemory();
+      if (fd < 0)
+        return false;
+      void* rw = MAP_FAILED;
+      void* rx = MAP_FAILED;
+      if (ftruncate(fd, off_t(size)) == 0)
+      {
+        rw = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        rx = mmap(0, size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+      }
+
+      // the mappings keep the memory alive
+      close(fd);
+      if (rw == MAP_FAILED || rx == MAP_FAILED)
+      {
+        if (rw != MAP_FAILED) munmap(rw, size);
+        if (rx != MAP_FAILED) munmap(rx, size);
+        return false;
+      }
+      r.writable = (uint8_t*)rw;
+      r.base = (uint8_t*)rx;
+#endif
+      return true;
+    }
+
+#if !defined(_WIN32)
+  /// returns an anonymous shared memory file, or -1
+  inline static int openSharedMemory()
+    {
+# if defined(MFD_CLOEXEC)
+      return memfd_create("vpu_code", MFD_CLOEXEC);
+# else
+      // no memfd, so create a named object and unlink it straight away
+      char name[64];
+      for (int attempt = 0; attempt < 16; ++attempt)
+      {
+        static unsigned counter = 0;
+        snprintf(name, sizeof(name), "/vpu_code_%d_%u", int(getpid()), counter++);
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0)
+        {
+          shm_unlink(name);
+          return fd;
+        }
+      }
+      return -1;
+# endif
+    }
+#endif
+
+  inline static void unmapRegion(Region& r)
+    {
+#if defined(_WIN32)
+      if (r.writable != r.base)
+      {
+        UnmapViewOfFile(r.writable);
+        UnmapViewOfFile(r.base);
+      }
+      else
+        VirtualFree(r.base, 0, MEM_RELEASE);
+#else
+      if (r.writable != r.base)
+        munmap(r.writable, r.size);
+      munmap(r.base, r.size);
+#endif
+      r.base = 0;
+      r.writable = 0;
+    }
+
+  // no copies
+  CodeArena(const CodeArena&);
+  CodeArena& operator = (const CodeArena&);
+
+  std::vector<Region> m_regions;
+  std::vector<Block> m_free;
+  size_t m_regionSize;
+  uint32_t m_alignment;
+  uint32_t m_flags;
+  ArenaStats m_stats;
+};
+
+} // vpu
@@ -0,0 +1,172 @@
+/// \file   lib_asm_cache.h
+/// \brief  A content addressed cache of finished kernels. Applications tend to assemble the same kernels over and over
+///         again (e.g. rebuilding the same node graph each time a scene loads). Rather than allocating new executable
+///         memory for each one, assemble into a single reusable assembler, and commit it to the cache. If an identical
+///         kernel (same instructions, same constants) has been seen before, the existing executable code is returned.
+/// \note   Copyright Rob Bateman. I accept no liability for any damage done to you, your computer(s), your client(s), or any other hardware/software
+///         problem that may arise from using this software. Use at your own risk.
+
+#pragma once
+#include "lib_asm_arena.h"
+#include <list>
+#include <unordered_map>
+
+namespace vpu
+{
+/// \brief  A fast 64bit hash of a block of memory (not cryptographic).
+inline uint64_t hashBytes(const void* data, size_t num_bytes, uint64_t seed = 0)
+{
+  const uint64_t k = 0x9E3779B97F4A7C15ULL;
+  const uint8_t* p = (const uint8_t*)data;
+  uint64_t h = seed ^ (num_bytes * k);
+  for (; num_bytes >= 8; num_bytes -= 8, p += 8)
+  {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    h = (h ^ (v * k)) * k;
+    h ^= h >> 29;
+  }
+  if (num_bytes)
+  {
+    uint64_t v = 0;
+    memcpy(&v, p, num_bytes);
+    h = (h ^ (v * k)) * k;
+  }
+  h ^= h >> 32;
+  h *= k;
+  h ^= h >> 29;
+  return h;
+}
+
+/// \brief  cache hit rates and memory usage
+struct KernelCacheStats
+{
+  size_t hits;        ///< number of commits that found an identical kernel in the cache
+  size_t misses;      ///< number of commits that had to copy a new kernel into executable memory
+  size_t evictions;   ///< number of kernels evicted to keep the cache within its size limit
+  size_t numKernels;  ///< number of kernels currently in the cache
+  size_t codeBytes;   ///< total size of the kernels currently in the cache
+};
+
+/// \brief  Finished kernels, keyed by a hash of their bytecode (which includes the constants that follow the code).
+///         When the total size of the cached kernels exceeds the limit, the least recently used kernels are evicted.
+///         An evicted kernel is no longer valid, so don't hold onto kernels between commits unless the limit is large
+///         enough to hold everything you assemble. The cache is not thread safe.
+class KernelCache
+{
+public:
+
+  /// \brief  ctor
+  /// \param  max_code_bytes the maximum size of all cached kernels (0 for no limit)
+  /// \param  arena_flags flags for the CodeArena that the kernels are stored in
+  inline KernelCache(size_t max_code_bytes = 0, uint32_t arena_flags = 0)
+    : m_arena(CodeArena::kDefaultRegionSize, 32, arena_flags), m_maxCodeBytes(max_code_bytes)
+    {
+      memset(&m_stats, 0, sizeof(m_stats));
+    }
+
+  /// \brief  look for a kernel matching the assemblers bytecode, and copy it into the cache if one isn't found.
+  /// \param  a the assembler to copy the code from. end() must have been called.
+  /// \param  convention the calling convention the assembler was created with.
+  /// \return the cached kernel, or a kernel with a null code pointer if the memory could not be allocated.
+  inline Kernel commit(const IAssembler* a, CallingConvention convention = kWin64)
+    { return commit(a->bytecode(), a->numBytes(), convention); }
+
+  /// \brief  look for a kernel matching some machine code, and copy it into the cache if one isn't found.
+  inline Kernel commit(const void* code, size_t num_bytes, CallingConvention convention = kWin64)
+    {
+      const uint64_t hash = hashBytes(code, num_bytes, convention);
+      std::pair<Map::iterator, Map::iterator> range = m_map.equal_range(hash);
+      for (Map::iterator it = range.first; it != range.second; ++it)
+      {
+        const Kernel& k = it->second->kernel;
+        if (k.numBytes == num_bytes && k.convention == convention && !memcmp(k.code, code, num_bytes))
+        {
+          // move to the front of the LRU list
+          m_lru.splice(m_lru.begin(), m_lru, it->second);
+          ++m_stats.hits;
+          return k;
+        }
+      }
+
+      // only evict once the new kernel is safely in the arena
+      ++m_stats.misses;
+      Kernel k = m_arena.commit(code, num_bytes, convention);
+      if (k.code)
+      {
+        const Entry e = { k, hash };
+        m_lru.push_front(e);
+        m_map.insert(Map::value_type(hash, m_lru.begin()));
+        ++m_stats.numKernels;
+        m_stats.codeBytes += num_bytes;
+        evict();
+      }
+      return k;
+    }
+
+  /// \brief  remove all kernels from the cache (all kernels previously returned become invalid)
+  inline void clear()
+    {
+      m_map.clear();
+      m_lru.clear();
+      m_arena.reset();
+      m_stats.numKernels = 0;
+      m_stats.codeBytes = 0;
+    }
+
+  /// \brief  query the hit rate & memory usage
+  inline const KernelCacheStats& stats() const
+    { return m_stats; }
+
+  /// \brief  the memory usage of the underlying arena
+  inline const ArenaStats& arenaStats() const
+    { return m_arena.stats(); }
+
+private:
+
+  struct Entry
+  {
+    Kernel kernel;
+    uint64_t hash;  ///< the key of the kernel in m_map
+  };
+
+  typedef std::list<Entry> List;
+  typedef std::unordered_multimap<uint64_t, List::iterator> Map;
+
+  /// evict least recently used kernels (other than the most recent one) until the cache is within its size limit
+  inline void evict()
+    {
+      if (!m_maxCodeBytes)
+        return;
+      while (m_lru.size() > 1 && m_stats.codeBytes > m_maxCodeBytes)
+      {
+        const Kernel& k = m_lru.back().kernel;
+        std::pair<Map::iterator, Map::iterator> range = m_map.equal_range(m_lru.back().hash);
+        for (Map::iterator it = range.first; it != range.second; ++it)
+        {
+          if (&it->second->kernel == &k)
+          {
+            m_map.erase(it);
+            break;
+          }
+        }
+        m_stats.codeBytes -= k.numBytes;
+        --m_stats.numKernels;
+        ++m_stats.evictions;
+        m_arena.release(k);
+        m_lru.pop_back();
+      }
+    }
+
+  // no copies
+  KernelCache(const KernelCache&);
+  KernelCache& operator = (const KernelCache&);
+
+  CodeArena m_arena;
+  List m_lru;
+  Map m_map;
+  size_t m_maxCodeBytes;
+  KernelCacheStats m_stats;
+};
+
+} // vpu
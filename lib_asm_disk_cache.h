@@ -0,0 +1,537 @@
+/// \file   lib_asm_disk_cache.h
+/// \brief  A persistent cache of finished kernels. Kernels are saved to a file along with a fingerprint of the CPU and
+///         the build of the library that generated them. On the next run the file is memory mapped, and the kernels
+///         can be run straight from the mapping, without assembling anything. If the CPU or the library differs, the
+///         file is ignored (and replaced the next time the cache is saved).
+/// \note   Copyright Rob Bateman. I accept no liability for any damage done to you, your computer(s), your client(s), or any other hardware/software
+///         problem that may arise from using this software. Use at your own risk.
+
+#pragma once
+#include "lib_asm_cache.h"
+#include <cstdio>
+#include <string>
+#if defined(_MSC_VER)
+# include <intrin.h>
+#else
+# include <cpuid.h>
+#endif
+
+namespace vpu
+{
+/// \brief  returns a hash of the features of the CPU this process is running on (vendor, family & model, the feature
+///         flags, and which register states the OS has enabled). Code generated on one machine should only be reused
+///         on another that has the same fingerprint.
+inline uint64_t cpuFingerprint()
+{
+  uint32_t info[16] = { 0 };
+  uint32_t r[4];
+#if defined(_MSC_VER)
+# define VPU_CPUID(LEAF, SUB) __cpuidex((int*)r, LEAF, SUB)
+#else
+# define VPU_CPUID(LEAF, SUB) __cpuid_count(LEAF, SUB, r[0], r[1], r[2], r[3])
+#endif
+  VPU_CPUID(0, 0);
+  const uint32_t max_leaf = r[0];
+  info[0] = r[1]; info[1] = r[3]; info[2] = r[2]; // vendor string
+  VPU_CPUID(1, 0);
+  info[3] = r[0] & 0x0FFF0FF0;  // family & model, ignoring the stepping
+  info[4] = r[2];
+  info[5] = r[3];
+  if (max_leaf >= 7)
+  {
+    VPU_CPUID(7, 0);
+    info[6] = r[1]; info[7] = r[2]; info[8] = r[3];
+  }
+  VPU_CPUID(0x80000000, 0);
+  if (r[0] >= 0x80000001)
+  {
+    VPU_CPUID(0x80000001, 0);
+    info[9] = r[2]; info[10] = r[3];
+  }
+#undef VPU_CPUID
+
+  // if the OS supports xgetbv, find out which register states it saves (e.g. whether YMM registers can be used)
+  if (info[4] & (1 << 27))
+  {
+#if defined(_MSC_VER)
+    const uint64_t xcr0 = _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    const uint64_t xcr0 = (uint64_t(hi) << 32) | lo;
+#endif
+    info[11] = uint32_t(xcr0);
+    info[12] = uint32_t(xcr0 >> 32);
+  }
+  return hashBytes(info, sizeof(info));
+}
+
+/// \brief  hit rates of a DiskCache
+struct DiskCacheStats
+{
+  size_t hits;          ///< number of successful finds
+  size_t misses;        ///< number of finds that failed (the kernel needs to be assembled and inserted)
+  size_t numKernels;    ///< number of kernels in the cache
+  size_t mappedBytes;   ///< size of the file that is currently mapped
+  bool mappedExecutable;///< true if kernels run directly from the mapped file, false if they have to be copied out first
+};
+
+/// \brief  A cache of kernels that can be saved to disk, keyed by a 64bit value of your choosing (e.g. a hash of the
+///         node graph the kernel was generated from, or of its name).
+///
+///         The code is position independent, so the only thing that can change between runs is the function table.
+///         Each kernel records the name, index and type of each function it calls, and find() will only return the
+///         kernel if those functions have the same indices within the table you pass in.
+///
+///         Kernels found in the file remain valid until the file is unloaded (by load(), save(), or the destructor).
+///         Kernels that have been inserted remain valid until the cache is destroyed, or another kernel is inserted
+///         with the same key. The cache is not thread safe.
+class DiskCache
+{
+public:
+
+  enum : uint32_t
+  {
+    kMagic = 0x43555056,  ///< 'VPUC'
+    kFormatVersion = 1    ///< bump whenever the layout of the file changes
+  };
+
+  /// \brief  ctor
+  /// \param  lib the library the kernels are being assembled with, used to detect when the library changes.
+  /// \param  arena_flags flags for the CodeArena that inserted kernels are stored in
+  inline DiskCache(const AssemblerLib& lib, uint32_t arena_flags = 0)
+    : m_arena(CodeArena::kDefaultRegionSize, 32, arena_flags), m_cpu(cpuFingerprint()), m_library(lib.buildId()),
+      m_file(0), m_fileSize(0), m_executable(false)
+#if defined(_WIN32)
+      , m_fileHandle(INVALID_HANDLE_VALUE), m_mappingHandle(0)
+#endif
+    {
+      memset(&m_stats, 0, sizeof(m_stats));
+    }
+
+  /// \brief  dtor, unmaps the file
+  inline ~DiskCache()
+    { unmapFile(); }
+
+  /// \brief  map a previously saved cache file. Any kernels previously loaded from a file are lost (inserted kernels are kept).
+  /// \return false if the file does not exist, is corrupt, or was generated on a different CPU or by a different library
+  inline bool load(const char* path)
+    {
+      // forget everything that came from the previous file (including any copies of it in the arena)
+      unmapFile();
+      for (Map::iterator it = m_map.begin(); it != m_map.end(); )
+      {
+        if (it->second.fromFile)
+        {
+          if (it->second.inArena)
+            m_arena.release(it->second.kernel);
+          it = m_map.erase(it);
+        }
+        else
+          ++it;
+      }
+
+      if (!mapFile(path))
+        return false;
+
+      // validate the header
+      const FileHeader* header = (const FileHeader*)m_file;
+      if (m_fileSize < sizeof(FileHeader) || header->magic != kMagic || header->formatVersion != kFormatVersion ||
+          header->cpu != m_cpu || header->library != m_library || header->fileSize != m_fileSize ||
+          !inFile(header->entriesOffset, header->numEntries * sizeof(FileEntry)) ||
+          !inFile(header->functionsOffset, header->numFunctions * sizeof(FileFunction)) ||
+          !inFile(header->namesOffset, header->namesSize) ||
+          (header->namesSize && m_file[header->namesOffset + header->namesSize - 1] != 0))
+      {
+        unmapFile();
+        return false;
+      }
+
+      const FileEntry* entries = (const FileEntry*)(m_file + header->entriesOffset);
+      const FileFunction* functions = (const FileFunction*)(m_file + header->functionsOffset);
+      const char* names = (const char*)(m_file + header->namesOffset);
+      for (uint32_t i = 0; i < header->numEntries; ++i)
+      {
+        const FileEntry& fe = entries[i];
+        if (!inFile(fe.codeOffset, fe.numBytes) || !fe.numBytes || fe.firstFunction > header->numFunctions ||
+            fe.numFunctions > header->numFunctions - fe.firstFunction || fe.convention > kSystemV)
+          continue;
+
+        // kernels inserted since the last save take precedence
+        Map::iterator it = m_map.find(fe.key);
+        if (it != m_map.end())
+          continue;
+
+        Entry& e = m_map[fe.key];
+        e.fromFile = true;
+        e.inArena = false;
+        e.source = m_file + fe.codeOffset;
+        e.kernel.code = m_executable ? e.source : 0;
+        e.kernel.writable = 0;
+        e.kernel.numBytes = size_t(fe.numBytes);
+        e.kernel.convention = CallingConvention(fe.convention);
+        for (uint32_t j = 0; j < fe.numFunctions; ++j)
+        {
+          const FileFunction& ff = functions[fe.firstFunction + j];
+          if (ff.nameOffset >= header->namesSize)
+            break;
+          Function f = { names + ff.nameOffset, ff.index, FunctionType(ff.type) };
+          e.functions.push_back(f);
+        }
+      }
+      return true;
+    }
+
+  /// \brief  look for a kernel in the cache
+  /// \param  key the key the kernel was inserted with
+  /// \param  table the function table the kernel will be run with, if it calls any functions.
+  /// \return the kernel, or a kernel with a null code pointer if it needs to be assembled (and inserted).
+  inline Kernel find(uint64_t key, const IFunctionTable* table = 0)
+    {
+      Map::iterator it = m_map.find(key);
+      if (it == m_map.end() || !functionsMatch(it->second, table))
+      {
+        ++m_stats.misses;
+        Kernel k = { 0, 0, 0, kWin64 };
+        return k;
+      }
+
+      Entry& e = it->second;
+      if (!e.kernel.code)
+      {
+        // the file could not be mapped as executable, so copy the code out (leaving the entry as it was on failure)
+        const Kernel k = m_arena.commit(e.source, e.kernel.numBytes, e.kernel.convention);
+        if (!k.code)
+        {
+          ++m_stats.misses;
+          return k;
+        }
+        e.kernel = k;
+        e.source = k.code;
+        e.inArena = true;
+      }
+      ++m_stats.hits;
+      return e.kernel;
+    }
+
+  /// \brief  add a kernel to the cache, replacing any existing kernel with the same key.
+  /// \param  key the key to store the kernel under
+  /// \param  a the assembler to copy the code from. end() must have been called.
+  /// \param  convention the calling convention the assembler was created with.
+  /// \param  table the function table the kernel calls functions from (or null)
+  /// \param  function_names the names of the functions the kernel calls
+  /// \param  num_functions the number of function names
+  /// \return the kernel (copied into executable memory), or a kernel with a null code pointer on failure.
+  inline Kernel insert(uint64_t key, const IAssembler* a, CallingConvention convention = kWin64,
+                       const IFunctionTable* table = 0, const char* const* function_names = 0, uint32_t num_functions = 0)
+    { return insert(key, a->bytecode(), a->numBytes(), convention, table, function_names, num_functions); }
+
+  /// \brief  add some machine code to the cache, replacing any existing kernel with the same key.
+  inline Kernel insert(uint64_t key, const void* code, size_t num_bytes, CallingConvention convention = kWin64,
+                       const IFunctionTable* table = 0, const char* const* function_names = 0, uint32_t num_functions = 0)
+    {
+      Kernel k = { 0, 0, 0, convention };
+      Entry e;
+      e.fromFile = false;
+      e.inArena = true;
+      for (uint32_t i = 0; i < num_functions; ++i)
+      {
+        Function f = { function_names[i], -1, kNoArgs };
+        if (!table || (f.index = table->funcInfo(function_names[i], f.type)) < 0)
+          return k;
+        e.functions.push_back(f);
+      }
+
+      k = m_arena.commit(code, num_bytes, convention);
+      if (!k.code)
+        return k;
+      e.kernel = k;
+      e.source = k.code;
+
+      // the kernel being replaced is no longer reachable, so give its memory back
+      Map::iterator it = m_map.find(key);
+      if (it != m_map.end() && it->second.inArena)
+        m_arena.release(it->second.kernel);
+      m_map[key] = e;
+      return k;
+    }
+
+  /// \brief  write all of the kernels in the cache to a file, and then map it. Kernels previously found in a file
+  ///         become invalid. The file is written to a temporary file first, and then renamed, so other processes
+  ///         never see a partially written cache.
+  /// \return false if the file could not be written
+  inline bool save(const char* path)
+    {
+      // lay out the file: header, entries, functions, names, code
+      std::vector<FileEntry> entries;
+      std::vector<FileFunction> functions;
+      std::string names;
+      uint64_t codeOffset = 0;
+      for (Map::const_iterator it = m_map.begin(); it != m_map.end(); ++it)
+      {
+        const Entry& e = it->second;
+        FileEntry fe;
+        memset(&fe, 0, sizeof(fe));
+        fe.key = it->first;
+        fe.codeOffset = codeOffset;
+        fe.numBytes = e.kernel.numBytes;
+        fe.convention = e.kernel.convention;
+        fe.firstFunction = uint32_t(functions.size());
+        fe.numFunctions = uint32_t(e.functions.size());
+        for (size_t i = 0; i < e.functions.size(); ++i)
+        {
+          FileFunction ff = { uint32_t(names.size()), e.functions[i].index, uint32_t(e.functions[i].type), 0 };
+          names += e.functions[i].name;
+          names += '\0';
+          functions.push_back(ff);
+        }
+        entries.push_back(fe);
+        codeOffset = (codeOffset + fe.numBytes + 31) & ~uint64_t(31);
+      }
+
+      FileHeader header;
+      memset(&header, 0, sizeof(header));
+      header.magic = kMagic;
+      header.formatVersion = kFormatVersion;
+      header.cpu = m_cpu;
+      header.library = m_library;
+      header.numEntries = uint32_t(entries.size());
+      header.numFunctions = uint32_t(functions.size());
+      header.entriesOffset = sizeof(FileHeader);
+      header.functionsOffset = header.entriesOffset + entries.size() * sizeof(FileEntry);
+      header.namesOffset = header.functionsOffset + functions.size() * sizeof(FileFunction);
+      header.namesSize = names.size();
+
+      // the code starts on a page boundary, so the kernels keep their 32 byte alignment when mapped
+      const uint64_t codeStart = (header.namesOffset + header.namesSize + 4095) & ~uint64_t(4095);
+      header.fileSize = codeStart + codeOffset;
+      for (size_t i = 0; i < entries.size(); ++i)
+        entries[i].codeOffset += codeStart;
+
+      std::string temp = std::string(path) + ".tmp";
+      FILE* fp = fopen(temp.c_str(), "wb");
+      if (!fp)
+        return false;
+      bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+      if (!entries.empty())
+        ok = ok && fwrite(&entries[0], sizeof(FileEntry), entries.size(), fp) == entries.size();
+      if (!functions.empty())
+        ok = ok && fwrite(&functions[0], sizeof(FileFunction), functions.size(), fp) == functions.size();
+      if (!names.empty())
+        ok = ok && fwrite(names.data(), 1, names.size(), fp) == names.size();
+      ok = ok && writePadding(fp, codeStart - (header.namesOffset + header.namesSize));
+      size_t i = 0;
+      for (Map::const_iterator it = m_map.begin(); ok && it != m_map.end(); ++it, ++i)
+      {
+        const Entry& e = it->second;
+        const uint64_t end = (i + 1 < entries.size()) ? entries[i + 1].codeOffset : header.fileSize;
+        ok = fwrite(e.source, 1, e.kernel.numBytes, fp) == e.kernel.numBytes &&
+             writePadding(fp, end - (entries[i].codeOffset + e.kernel.numBytes));
+      }
+      ok = (fclose(fp) == 0) && ok;
+
+      // the file being replaced may be the one that is mapped (which Windows will not allow)
+      unmapFile();
+      if (ok)
+      {
+#if defined(_WIN32)
+        ok = MoveFileExA(temp.c_str(), path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        ok = rename(temp.c_str(), path) == 0;
+#endif
+      }
+      if (!ok)
+      {
+        // put back whatever was there before
+        remove(temp.c_str());
+        load(path);
+        return false;
+      }
+      return load(path);
+    }
+
+  /// \brief  query the hit rate
+  inline const DiskCacheStats& stats()
+    {
+      m_stats.numKernels = m_map.size();
+      m_stats.mappedBytes = m_fileSize;
+      m_stats.mappedExecutable = m_executable;
+      return m_stats;
+    }
+
+private:
+
+  struct FileHeader
+  {
+    uint32_t magic;
+    uint32_t formatVersion;
+    uint64_t cpu;             ///< cpuFingerprint() of the machine that wrote the file
+    uint64_t library;         ///< AssemblerLib::buildId() of the library that generated the code
+    uint64_t fileSize;
+    uint32_t numEntries;
+    uint32_t numFunctions;
+    uint64_t entriesOffset;   ///< FileEntry[numEntries]
+    uint64_t functionsOffset; ///< FileFunction[numFunctions]
+    uint64_t namesOffset;     ///< null terminated function names
+    uint64_t namesSize;
+  };
+
+  struct FileEntry
+  {
+    uint64_t key;
+    uint64_t codeOffset;      ///< offset of the code from the start of the file
+    uint64_t numBytes;
+    uint32_t convention;
+    uint32_t firstFunction;   ///< index of the first FileFunction the kernel calls
+    uint32_t numFunctions;
+    uint32_t pad;
+  };
+
+  struct FileFunction
+  {
+    uint32_t nameOffset;      ///< offset into the names
+    int32_t index;            ///< index of the function within the table
+    uint32_t type;            ///< FunctionType
+    uint32_t pad;
+  };
+
+  struct Function
+  {
+    std::string name;
+    int32_t index;
+    FunctionType type;
+  };
+
+  struct Entry
+  {
+    Kernel kernel;            ///< code is null if the kernel is in a file that could not be mapped as executable
+    const uint8_t* source;    ///< where to copy the kernel from when saving
+    std::vector<Function> functions;
+    bool fromFile;
+    bool inArena;             ///< the kernel has been copied into m_arena (by insert, or by find), so must be released
+  };
+
+  typedef std::unordered_map<uint64_t, Entry> Map;
+
+  inline bool functionsMatch(const Entry& e, const IFunctionTable* table) const
+    {
+      for (size_t i = 0; i < e.functions.size(); ++i)
+      {
+        FunctionType type;
+        if (!table || table->funcInfo(e.functions[i].name.c_str(), type) != e.functions[i].index || type != e.functions[i].type)
+          return false;
+      }
+      return true;
+    }
+
+  inline bool inFile(uint64_t offset, uint64_t size) const
+    { return offset <= m_fileSize && size <= m_fileSize - offset; }
+
+  inline static bool writePadding(FILE* fp, uint64_t num_bytes)
+    {
+      static const uint8_t zeros[4096] = { 0 };
+      while (num_bytes)
+      {
+        size_t n = num_bytes < sizeof(zeros) ? size_t(num_bytes) : sizeof(zeros);
+        if (fwrite(zeros, 1, n, fp) != n)
+          return false;
+        num_bytes -= n;
+      }
+      return true;
+    }
+
+  /// maps the file as read + execute, falling back to read only (e.g. a filesystem mounted noexec)
+  inline bool mapFile(const char* path)
+    {
+#if defined(_WIN32)
+      m_fileHandle = CreateFileA(path, GENERIC_READ | GENERIC_EXECUTE, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+      if (m_fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+      LARGE_INTEGER size;
+      if (!GetFileSizeEx(m_fileHandle, &size) || !size.QuadPart)
+      {
+        unmapFile();
+        return false;
+      }
+      m_fileSize = size_t(size.QuadPart);
+      m_executable = true;
+      m_mappingHandle = CreateFileMappingA(m_fileHandle, 0, PAGE_EXECUTE_READ, 0, 0, 0);
+      if (m_mappingHandle)
+        m_file = (const uint8_t*)MapViewOfFile(m_mappingHandle, FILE_MAP_READ | FILE_MAP_EXECUTE, 0, 0, 0);
+      if (!m_file)
+      {
+        m_executable = false;
+        if (m_mappingHandle)
+          CloseHandle(m_mappingHandle);
+        m_mappingHandle = CreateFileMappingA(m_fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+        if (m_mappingHandle)
+          m_file = (const uint8_t*)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+      }
+#else
+      int fd = open(path, O_RDONLY | O_CLOEXEC);
+      if (fd < 0)
+        return false;
+      struct stat st;
+      if (fstat(fd, &st) != 0 || st.st_size <= 0)
+      {
+        close(fd);
+        return false;
+      }
+      m_fileSize = size_t(st.st_size);
+      m_executable = true;
+      void* ptr = mmap(0, m_fileSize, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+      if (ptr == MAP_FAILED)
+      {
+        m_executable = false;
+        ptr = mmap(0, m_fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+      }
+      close(fd);
+      m_file = ptr == MAP_FAILED ? 0 : (const uint8_t*)ptr;
+#endif
+      if (!m_file)
+      {
+        unmapFile();
+        return false;
+      }
+      return true;
+    }
+
+  inline void unmapFile()
+    {
+#if defined(_WIN32)
+      if (m_file)
+        UnmapViewOfFile(m_file);
+      if (m_mappingHandle)
+        CloseHandle(m_mappingHandle);
+      if (m_fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(m_fileHandle);
+      m_mappingHandle = 0;
+      m_fileHandle = INVALID_HANDLE_VALUE;
+#else
+      if (m_file)
+        munmap((void*)m_file, m_fileSize);
+#endif
+      m_file = 0;
+      m_fileSize = 0;
+      m_executable = false;
+    }
+
+  // no copies
+  DiskCache(const DiskCache&);
+  DiskCache& operator = (const DiskCache&);
+
+  CodeArena m_arena;
+  Map m_map;
+  uint64_t m_cpu;
+  uint64_t m_library;
+  const uint8_t* m_file;
+  size_t m_fileSize;
+  bool m_executable;
+#if defined(_WIN32)
+  HANDLE m_fileHandle;
+  HANDLE m_mappingHandle;
+#endif
+  DiskCacheStats m_stats;
+};
+
+} // vpu
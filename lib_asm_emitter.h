@@ -0,0 +1,5237 @@
+/// \file   lib_asm_emitter.h
+/// \brief  A header only alternative to the IAssembler interface. vpu::Emitter has the same instruction methods as
+///         IAssembler (addps, movaps, fmaddps, ...), however none of them are virtual, and the machine code is written
+///         straight into a buffer that you provide. When assembling large kernels, this removes an indirect call across
+///         the DLL boundary for every instruction, and allows the compiler to inline the encoding into your code generator.
+///         The bytes produced are identical to those of the DLL (warts and all, each noted on the method concerned, e.g.
+///         extractf128), so the two can be used interchangeably, and the result can be handed to a CodeArena or 
+///         KernelCache in exactly the same way.
+///         With a C++14 compiler, StaticEmitter can also assemble kernels at compile time (see below), and
+///         Emitter::function() generates the prologue & epilogue of a function for you.
+/// \code
+/// uint8_t buffer[4096];
+/// vpu::Emitter e(buffer, sizeof(buffer));
+/// e.begin();
+///   e.movaps(vpu::YMM0, vpu::RCX, 0);
+///   e.addps(vpu::YMM0, vpu::YMM0, vpu::YMM0);
+///   e.movaps(vpu::RCX, 0, vpu::YMM0);
+///   e.ret();
+/// e.end();
+/// vpu::Kernel k = arena.commit(e.bytecode(), e.numBytes());
+/// \endcode
+/// \note   Copyright Rob Bateman. I accept no liability for any damage done to you, your computer(s), your client(s), or any other hardware/software
+///         problem that may arise from using this software. Use at your own risk.
+
+#pragma once
+#include "lib_asm.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// VPU_CONSTEXPR14 marks the instruction encoders as constexpr when the compiler supports C++14 constexpr functions
+/// (in which case VPU_HAS_CONSTEXPR14 is defined), otherwise they are simply inline.
+#if __cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+# define VPU_HAS_CONSTEXPR14 1
+# define VPU_CONSTEXPR14 constexpr
+# include <array>
+# include <utility>
+#else
+# define VPU_CONSTEXPR14 inline
+#endif
+
+namespace vpu
+{
+/// \brief  The forms of instruction described to EncoderBase::useInstruction
+enum InstructionForm
+{
+  kFormOther,     ///< an instruction that isn't described any further (calls, blends, constant loads)
+  kFormRR,        ///< VEX, register operands reg, vvvv & rm (followed by an immediate for some ops)
+  kFormRM,        ///< VEX, reg, vvvv & the memory operand [rm + disp] (+ index * scale, if scale isn't 0)
+  kFormMR,        ///< VEX store, [rm + disp] = reg (+ index * scale), where map 2 is a masked store (mask in vvvv)
+  kFormGpr,       ///< REX.W op reg, [rm + disp] (+ index * scale) (mov64, lea, and the ALU ops; map 1 for 0F ops)
+  kFormGprMove,   ///< mov reg, rm
+  kFormGprOnly,   ///< push, pop, loadcount & mov, inc & dec (op is 0x50, 0x58, 0xB8, 0xFF), which only use the GPR rm
+  kFormImm,       ///< REX.W 81 /op rm, imm (where disp is the immediate)
+  kFormGprRR,     ///< REX.W op reg, rm, both registers (the ALU ops, test, imul & cmovcc; map 1 for 0F ops, and disp
+                  ///< is the immediate of imul)
+  kFormGprUnary,  ///< op /reg rm (neg, not, test & the shifts, where disp is the immediate or shift count, and setcc,
+                  ///< where map is 1). A shift by CL has op 0xD3.
+  kFormJump,      ///< jcc, where op is the condition, and disp the offset from the end of the jump
+  kFormRet,
+  kFormGather,    ///< VEX, reg, the mask vvvv, & the memory operand [rm + index * scale + disp]
+  kFormAlign,     ///< the NOPs written by align(), where disp is the boundary (this may be 0 bytes long)
+  kFormPrefetch   ///< prefetch [rm + disp] (+ index * scale), where reg is the PrefetchHint
+};
+
+/// \brief  A description of an instruction's encoding, passed to EncoderBase::useInstruction before it is written
+struct InstructionInfo
+{
+  uint8_t form;   ///< InstructionForm
+  uint8_t map;    ///< VEX map (1 = 0F, 2 = 0F38, 3 = 0F3A)
+  uint8_t pp;     ///< VEX pp (0 = none, 1 = 66, 2 = F3, 3 = F2)
+  uint8_t op;
+  uint8_t W;
+  uint8_t L;
+  uint8_t reg;
+  uint8_t vvvv;
+  uint8_t rm;     ///< a register, or the base register of the memory operand
+  uint8_t index;  ///< the index register of a gather, or of a memory operand with a scale
+  uint8_t scale;  ///< 1, 2, 4, or 8 if the memory operand has an index register (always 0 for a gather)
+  int32_t disp;
+};
+
+/// \brief  A memory operand [base + index * scale + disp], which every EncoderBase method that takes a base register
+///         and displacement also accepts in their place. Unlike those, any register can be the base, and the shortest
+///         encoding is always used (so the code may differ from the DLL's). RSP can't be an index register, so an index
+///         of RSP means there is none:
+/// \code
+/// e.movaps(vpu::YMM0, vpu::Mem{ vpu::RCX, vpu::RAX, 4, 32 });    // vmovaps ymm0, [rcx + rax * 4 + 32]
+/// e.movaps(vpu::Mem{ vpu::RSP, vpu::RSP, 1, 64 }, vpu::YMM0);    // vmovaps [rsp + 64], ymm0
+/// \endcode
+///         For the gathers, the index is the vector of indices, so the index of the Mem must be RSP.
+struct Mem
+{
+  Reg base;
+  Reg index;        ///< RSP for none
+  uint8_t scale;    ///< 1, 2, 4, or 8
+  int32_t disp;
+};
+
+/// \brief  The cache level prefetch() loads a line into (the values are the ModRM reg field of 0F 18)
+enum PrefetchHint
+{
+  kPrefetchNTA,   ///< prefetchnta: close to the processor, but without polluting the caches (data used once)
+  kPrefetchT0,    ///< prefetcht0: every level of cache
+  kPrefetchT1,    ///< prefetcht1: level 2 and above
+  kPrefetchT2     ///< prefetcht2: level 3 and above
+};
+
+/// \brief  The instruction encoder. The derived class owns the memory the machine code is written to, and must provide:
+/// \code
+/// uint8_t* reserve(size_t num_bytes);   // returns the write position, with room for at least num_bytes
+/// void commit(uint8_t* end);            // called once the bytes up to end have been written
+/// size_t numBytes() const;              // the number of bytes committed so far
+/// \endcode
+/// No more than kMaxReserve bytes are ever reserved at once. The encoder has no state of its own, and every method is
+/// VPU_CONSTEXPR14, so if the derived class is a literal type, instructions can be encoded in a constant expression.
+/// As with IAssembler, the methods that take a base register and displacement cannot use RSP or R12 as the base (they
+/// return false, and emit nothing). Their Mem overloads can: those bases are encoded with a SIB byte (see Mem).
+template<typename Derived>
+class EncoderBase
+{
+public:
+
+  enum : size_t { kMaxReserve = 32 };
+
+  /// \name   Instructions
+  /// \brief  See the equivalent IAssembler methods.
+
+  VPU_CONSTEXPR14 void lshift_u128(AVXReg target, AVXReg a, uint8_t num_bytes)
+    { encodeRR(1, 0x73, 3, target, a, 1); emit8(num_bytes); }
+
+  VPU_CONSTEXPR14 void rshift_u128(AVXReg target, AVXReg a, uint8_t num_bytes)
+    { encodeRR(1, 0x73, 7, target, a, 1); emit8(num_bytes); }
+
+  VPU_CONSTEXPR14 void lshift_u16(AVXReg target, AVXReg a, uint8_t num_bits)
+    { encodeRR(1, 0x71, 6, target, a, 1); emit8(num_bits); }
+
+  VPU_CONSTEXPR14 void lshift_u32(AVXReg target, AVXReg a, uint8_t num_bits)
+    { encodeRR(1, 0x72, 6, target, a, 1); emit8(num_bits); }
+
+  VPU_CONSTEXPR14 void lshift_u64(AVXReg target, AVXReg a, uint8_t num_bits)
+    { encodeRR(1, 0x73, 6, target, a, 1); emit8(num_bits); }
+
+  VPU_CONSTEXPR14 void rshift_u16(AVXReg target, AVXReg a, uint8_t num_bits)
+    { encodeRR(1, 0x71, 2, target, a, 1); emit8(num_bits); }
+
+  VPU_CONSTEXPR14 void rshift_u32(AVXReg target, AVXReg a, uint8_t num_bits)
+    { encodeRR(1, 0x72, 2, target, a, 1); emit8(num_bits); }
+
+  VPU_CONSTEXPR14 void rshift_u64(AVXReg target, AVXReg a, uint8_t num_bits)
+    { encodeRR(1, 0x73, 2, target, a, 1); emit8(num_bits); }
+
+  VPU_CONSTEXPR14 void rshift_i16(AVXReg target, AVXReg a, uint8_t num_bits)
+    { encodeRR(1, 0x71, 4, target, a, 1); emit8(num_bits); }
+
+  VPU_CONSTEXPR14 void rshift_i32(AVXReg target, AVXReg a, uint8_t num_bits)
+    { encodeRR(1, 0x72, 4, target, a, 1); emit8(num_bits); }
+
+  VPU_CONSTEXPR14 void lshift_u16(AVXReg target, AVXReg a, AVXReg num_bits)
+    { encodeRR(1, 0xF1, target, a, num_bits, 1); }
+  VPU_CONSTEXPR14 bool lshift_u16(AVXReg target, AVXReg a, Reg num_bits, uint32_t disp)
+    { return encodeRM(1, 0xF1, target, a, num_bits, disp, 1); }
+  VPU_CONSTEXPR14 bool lshift_u16(AVXReg target, AVXReg a, Mem num_bits)
+    { return encodeRM(1, 0xF1, target, a, num_bits, 1); }
+
+  VPU_CONSTEXPR14 void lshift_u32(AVXReg target, AVXReg a, AVXReg num_bits)
+    { encodeRR(1, 0xF2, target, a, num_bits, 1); }
+  VPU_CONSTEXPR14 bool lshift_u32(AVXReg target, AVXReg a, Reg num_bits, uint32_t disp)
+    { return encodeRM(1, 0xF2, target, a, num_bits, disp, 1); }
+  VPU_CONSTEXPR14 bool lshift_u32(AVXReg target, AVXReg a, Mem num_bits)
+    { return encodeRM(1, 0xF2, target, a, num_bits, 1); }
+
+  VPU_CONSTEXPR14 void lshift_u64(AVXReg target, AVXReg a, AVXReg num_bits)
+    { encodeRR(1, 0xF3, target, a, num_bits, 1); }
+  VPU_CONSTEXPR14 bool lshift_u64(AVXReg target, AVXReg a, Reg num_bits, uint32_t disp)
+    { return encodeRM(1, 0xF3, target, a, num_bits, disp, 1); }
+  VPU_CONSTEXPR14 bool lshift_u64(AVXReg target, AVXReg a, Mem num_bits)
+    { return encodeRM(1, 0xF3, target, a, num_bits, 1); }
+
+  VPU_CONSTEXPR14 void rshift_u16(AVXReg target, AVXReg a, AVXReg num_bits)
+    { encodeRR(1, 0xD1, target, a, num_bits, 1); }
+  VPU_CONSTEXPR14 bool rshift_u16(AVXReg target, AVXReg a, Reg num_bits, uint32_t disp)
+    { return encodeRM(1, 0xD1, target, a, num_bits, disp, 1); }
+  VPU_CONSTEXPR14 bool rshift_u16(AVXReg target, AVXReg a, Mem num_bits)
+    { return encodeRM(1, 0xD1, target, a, num_bits, 1); }
+
+  VPU_CONSTEXPR14 void rshift_u32(AVXReg target, AVXReg a, AVXReg num_bits)
+    { encodeRR(1, 0xD2, target, a, num_bits, 1); }
+  VPU_CONSTEXPR14 bool rshift_u32(AVXReg target, AVXReg a, Reg num_bits, uint32_t disp)
+    { return encodeRM(1, 0xD2, target, a, num_bits, disp, 1); }
+  VPU_CONSTEXPR14 bool rshift_u32(AVXReg target, AVXReg a, Mem num_bits)
+    { return encodeRM(1, 0xD2, target, a, num_bits, 1); }
+
+  VPU_CONSTEXPR14 void rshift_u64(AVXReg target, AVXReg a, AVXReg num_bits)
+    { encodeRR(1, 0xD3, target, a, num_bits, 1); }
+  VPU_CONSTEXPR14 bool rshift_u64(AVXReg target, AVXReg a, Reg num_bits, uint32_t disp)
+    { return encodeRM(1, 0xD3, target, a, num_bits, disp, 1); }
+  VPU_CONSTEXPR14 bool rshift_u64(AVXReg target, AVXReg a, Mem num_bits)
+    { return encodeRM(1, 0xD3, target, a, num_bits, 1); }
+
+  VPU_CONSTEXPR14 void rshift_i16(AVXReg target, AVXReg a, AVXReg num_bits)
+    { encodeRR(1, 0xE1, target, a, num_bits, 1); }
+  VPU_CONSTEXPR14 bool rshift_i16(AVXReg target, AVXReg a, Reg num_bits, uint32_t disp)
+    { return encodeRM(1, 0xE1, target, a, num_bits, disp, 1); }
+  VPU_CONSTEXPR14 bool rshift_i16(AVXReg target, AVXReg a, Mem num_bits)
+    { return encodeRM(1, 0xE1, target, a, num_bits, 1); }
+
+  VPU_CONSTEXPR14 void rshift_i32(AVXReg target, AVXReg a, AVXReg num_bits)
+    { encodeRR(1, 0xE2, target, a, num_bits, 1); }
+  VPU_CONSTEXPR14 bool rshift_i32(AVXReg target, AVXReg a, Reg num_bits, uint32_t disp)
+    { return encodeRM(1, 0xE2, target, a, num_bits, disp, 1); }
+  VPU_CONSTEXPR14 bool rshift_i32(AVXReg target, AVXReg a, Mem num_bits)
+    { return encodeRM(1, 0xE2, target, a, num_bits, 1); }
+
+  VPU_CONSTEXPR14 void lshiftv_u32(AVXReg target, AVXReg a, AVXReg num_bits)
+    { encodeRR3(1, 0x47, target, a, num_bits, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool lshiftv_u32(AVXReg target, AVXReg a, Reg num_bits, uint32_t disp)
+    { return encodeRM3(1, 0x47, target, a, num_bits, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool lshiftv_u32(AVXReg target, AVXReg a, Mem num_bits)
+    { return encodeRM3(1, 0x47, target, a, num_bits, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void lshiftv_u64(AVXReg target, AVXReg a, AVXReg num_bits)
+    { encodeRR3(1, 0x47, target, a, num_bits, 1, 1, 2); }
+  VPU_CONSTEXPR14 bool lshiftv_u64(AVXReg target, AVXReg a, Reg num_bits, uint32_t disp)
+    { return encodeRM3(1, 0x47, target, a, num_bits, disp, 1, 1, 2); }
+  VPU_CONSTEXPR14 bool lshiftv_u64(AVXReg target, AVXReg a, Mem num_bits)
+    { return encodeRM3(1, 0x47, target, a, num_bits, 1, 1, 2); }
+
+  VPU_CONSTEXPR14 void rshiftv_u32(AVXReg target, AVXReg a, AVXReg num_bits)
+    { encodeRR3(1, 0x45, target, a, num_bits, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool rshiftv_u32(AVXReg target, AVXReg a, Reg num_bits, uint32_t disp)
+    { return encodeRM3(1, 0x45, target, a, num_bits, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool rshiftv_u32(AVXReg target, AVXReg a, Mem num_bits)
+    { return encodeRM3(1, 0x45, target, a, num_bits, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void rshiftv_u64(AVXReg target, AVXReg a, AVXReg num_bits)
+    { encodeRR3(1, 0x45, target, a, num_bits, 1, 1, 2); }
+  VPU_CONSTEXPR14 bool rshiftv_u64(AVXReg target, AVXReg a, Reg num_bits, uint32_t disp)
+    { return encodeRM3(1, 0x45, target, a, num_bits, disp, 1, 1, 2); }
+  VPU_CONSTEXPR14 bool rshiftv_u64(AVXReg target, AVXReg a, Mem num_bits)
+    { return encodeRM3(1, 0x45, target, a, num_bits, 1, 1, 2); }
+
+  VPU_CONSTEXPR14 void rshiftv_i32(AVXReg target, AVXReg a, AVXReg num_bits)
+    { encodeRR3(1, 0x46, target, a, num_bits, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool rshiftv_i32(AVXReg target, AVXReg a, Reg num_bits, uint32_t disp)
+    { return encodeRM3(1, 0x46, target, a, num_bits, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool rshiftv_i32(AVXReg target, AVXReg a, Mem num_bits)
+    { return encodeRM3(1, 0x46, target, a, num_bits, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void shufflei8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool shufflei8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool shufflei8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void broadcasti8(AVXReg target, AVXReg source)
+    { encodeRR3(1, 0x78, target, 0, source, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcasti8(AVXReg target, Reg source, uint32_t disp)
+    { return encodeRM3(1, 0x78, target, 0, source, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcasti8(AVXReg target, Mem source)
+    { return encodeRM3(1, 0x78, target, 0, source, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void movemaski8(Reg target, AVXReg a)
+    { encodeRR(1, 0xD7, target, 0, a, 1); }
+
+  VPU_CONSTEXPR14 void absi8(AVXReg target, AVXReg b)
+    { encodeRR3(1, 0x1C, target, 0, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool absi8(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x1C, target, 0, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool absi8(AVXReg target, Mem b)
+    { return encodeRM3(1, 0x1C, target, 0, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void avgi8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xE0, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool avgi8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xE0, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool avgi8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xE0, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void addi8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xFC, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool addi8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xFC, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool addi8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xFC, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void addsi8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xEC, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool addsi8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xEC, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool addsi8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xEC, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void addsu8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xDC, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool addsu8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xDC, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool addsu8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xDC, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void subi8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xF8, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool subi8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xF8, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool subi8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xF8, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void subsi8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xE8, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool subsi8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xE8, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool subsi8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xE8, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void subsu8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xD8, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool subsu8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xD8, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool subsu8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xD8, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void maxu8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xDE, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool maxu8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xDE, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool maxu8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xDE, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void minu8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xDA, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool minu8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xDA, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool minu8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xDA, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void maxi8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x3C, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool maxi8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x3C, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool maxi8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x3C, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void mini8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x38, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool mini8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x38, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool mini8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x38, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void broadcasti16(AVXReg target, AVXReg source)
+    { encodeRR3(1, 0x79, target, 0, source, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcasti16(AVXReg target, Reg source, uint32_t disp)
+    { return encodeRM3(1, 0x79, target, 0, source, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcasti16(AVXReg target, Mem source)
+    { return encodeRM3(1, 0x79, target, 0, source, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void absi16(AVXReg target, AVXReg b)
+    { encodeRR3(1, 0x1D, target, 0, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool absi16(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x1D, target, 0, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool absi16(AVXReg target, Mem b)
+    { return encodeRM3(1, 0x1D, target, 0, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void avgi16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xE3, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool avgi16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xE3, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool avgi16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xE3, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void addi16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xFD, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool addi16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xFD, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool addi16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xFD, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void addsi16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xED, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool addsi16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xED, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool addsi16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xED, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void addsu16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xDD, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool addsu16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xDD, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool addsu16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xDD, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void haddi16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 1, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool haddi16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 1, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool haddi16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 1, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void haddsi16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 3, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool haddsi16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 3, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool haddsi16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 3, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void hsubi16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 5, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool hsubi16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 5, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool hsubi16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 5, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void hsubsi16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 7, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool hsubsi16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 7, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool hsubsi16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 7, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void subi16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xF9, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool subi16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xF9, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool subi16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xF9, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void subsi16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xE9, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool subsi16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xE9, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool subsi16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xE9, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void subsu16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xD9, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool subsu16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xD9, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool subsu16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xD9, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void maxi16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xEE, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool maxi16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xEE, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool maxi16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xEE, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void mini16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xEA, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool mini16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xEA, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool mini16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xEA, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void maxu16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x3E, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool maxu16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x3E, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool maxu16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x3E, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void minu16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x3A, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool minu16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x3A, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool minu16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x3A, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void mulli16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xD5, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool mulli16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xD5, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool mulli16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xD5, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void mulhi16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xE5, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool mulhi16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xE5, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool mulhi16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xE5, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void mulhu16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xE4, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool mulhu16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xE4, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool mulhu16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xE4, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void broadcasti32(AVXReg target, AVXReg source)
+    { encodeRR3(1, 0x58, target, 0, source, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcasti32(AVXReg target, Reg source, uint32_t disp)
+    { return encodeRM3(1, 0x58, target, 0, source, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcasti32(AVXReg target, Mem source)
+    { return encodeRM3(1, 0x58, target, 0, source, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void absi32(AVXReg target, AVXReg b)
+    { encodeRR3(1, 0x1E, target, 0, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool absi32(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x1E, target, 0, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool absi32(AVXReg target, Mem b)
+    { return encodeRM3(1, 0x1E, target, 0, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void addi32(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xFE, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool addi32(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xFE, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool addi32(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xFE, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void haddi32(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 2, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool haddi32(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 2, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool haddi32(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 2, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void hsubi32(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 6, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool hsubi32(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 6, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool hsubi32(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 6, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void subi32(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xFA, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool subi32(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xFA, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool subi32(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xFA, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void mulli32(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x40, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool mulli32(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x40, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool mulli32(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x40, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void muli32(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x28, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool muli32(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x28, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool muli32(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x28, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void maxi32(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x3D, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool maxi32(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x3D, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool maxi32(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x3D, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void mini32(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x39, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool mini32(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x39, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool mini32(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x39, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void maxu32(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x3F, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool maxu32(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x3F, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool maxu32(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x3F, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void minu32(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x3B, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool minu32(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x3B, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool minu32(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x3B, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void addi64(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xD4, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool addi64(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xD4, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool addi64(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xD4, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void subi64(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0xFB, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool subi64(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0xFB, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool subi64(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0xFB, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void broadcasti64(AVXReg target, AVXReg source)
+    { encodeRR3(1, 0x59, target, 0, source, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcasti64(AVXReg target, Reg source, uint32_t disp)
+    { return encodeRM3(1, 0x59, target, 0, source, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcasti64(AVXReg target, Mem source)
+    { return encodeRM3(1, 0x59, target, 0, source, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 bool broadcasti128(AVXReg target, Reg source, uint32_t disp)
+    { return encodeRM3(1, 0x5A, target, 0, source, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcasti128(AVXReg target, Mem source)
+    { return encodeRM3(1, 0x5A, target, 0, source, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 bool broadcastf128(AVXReg target, Reg source, uint32_t disp)
+    { return encodeRM3(1, 0x1A, target, 0, source, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcastf128(AVXReg target, Mem source)
+    { return encodeRM3(1, 0x1A, target, 0, source, 0, 1, 2); }
+
+  /// \note   the DLL encodes extractf128 as VEX.256.66.0F38 19 /r, which is vbroadcastsd (target = the lowest double 
+  ///         of b, or of [b + disp], in all four elements), rather than vextractf128 (0F3A 19 /r ib). This does the 
+  ///         same, so the code matches the DLL's. To move the upper 128 bits of a register down, use permute2f128.
+  VPU_CONSTEXPR14 void extractf128(AVXReg target, AVXReg b)
+    { encodeRR3(1, 0x19, target, 0, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool extractf128(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x19, target, 0, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool extractf128(AVXReg target, Mem b)
+    { return encodeRM3(1, 0x19, target, 0, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void insertf128(AVXReg target, AVXReg src, AVXReg in, uint8_t mask)
+    { encodeRR3(1, 0x18, target, src, in, 0, 1, 3); emit8(mask); }
+  VPU_CONSTEXPR14 bool insertf128(AVXReg target, AVXReg src, Reg in, int32_t disp, uint8_t mask)
+    { if (!encodeRM3(1, 0x18, target, src, in, disp, 0, 1, 3)) return false; emit8(mask); return true; }
+  VPU_CONSTEXPR14 bool insertf128(AVXReg target, AVXReg src, Mem in, uint8_t mask)
+    { if (!encodeRM3(1, 0x18, target, src, in, 0, 1, 3)) return false; emit8(mask); return true; }
+
+  VPU_CONSTEXPR14 void inserti128(AVXReg target, AVXReg src, AVXReg in, uint8_t mask)
+    { encodeRR3(1, 0x38, target, src, in, 0, 1, 3); emit8(mask); }
+  VPU_CONSTEXPR14 bool inserti128(AVXReg target, AVXReg src, Reg in, int32_t disp, uint8_t mask)
+    { if (!encodeRM3(1, 0x38, target, src, in, disp, 0, 1, 3)) return false; emit8(mask); return true; }
+  VPU_CONSTEXPR14 bool inserti128(AVXReg target, AVXReg src, Mem in, uint8_t mask)
+    { if (!encodeRM3(1, 0x38, target, src, in, 0, 1, 3)) return false; emit8(mask); return true; }
+
+  VPU_CONSTEXPR14 void permute2f128(AVXReg target, AVXReg src, AVXReg in, uint8_t mask)
+    { encodeRR3(1, 6, target, src, in, 0, 1, 3); emit8(mask); }
+  VPU_CONSTEXPR14 bool permute2f128(AVXReg target, AVXReg src, Reg in, int32_t disp, uint8_t mask)
+    { if (!encodeRM3(1, 6, target, src, in, disp, 0, 1, 3)) return false; emit8(mask); return true; }
+  VPU_CONSTEXPR14 bool permute2f128(AVXReg target, AVXReg src, Mem in, uint8_t mask)
+    { if (!encodeRM3(1, 6, target, src, in, 0, 1, 3)) return false; emit8(mask); return true; }
+
+  VPU_CONSTEXPR14 void permute2i128(AVXReg target, AVXReg src, AVXReg in, uint8_t mask)
+    { encodeRR3(1, 0x46, target, src, in, 0, 1, 3); emit8(mask); }
+  VPU_CONSTEXPR14 bool permute2i128(AVXReg target, AVXReg src, Reg in, int32_t disp, uint8_t mask)
+    { if (!encodeRM3(1, 0x46, target, src, in, disp, 0, 1, 3)) return false; emit8(mask); return true; }
+  VPU_CONSTEXPR14 bool permute2i128(AVXReg target, AVXReg src, Mem in, uint8_t mask)
+    { if (!encodeRM3(1, 0x46, target, src, in, 0, 1, 3)) return false; emit8(mask); return true; }
+
+  VPU_CONSTEXPR14 void broadcastss(AVXReg target, AVXReg source)
+    { encodeRR3(1, 0x18, target, 0, source, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcastss(AVXReg target, Reg source, uint32_t disp)
+    { return encodeRM3(1, 0x18, target, 0, source, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcastss(AVXReg target, Mem source)
+    { return encodeRM3(1, 0x18, target, 0, source, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void blendvps(AVXReg target, AVXReg fres, AVXReg tres, AVXReg cmp)
+    { encodeBlendRR(1, 0x4A, target, fres, tres, cmp, 0); }
+  VPU_CONSTEXPR14 bool blendvps(AVXReg target, AVXReg fres, Reg tres, int32_t disp, AVXReg cmp)
+    { return encodeBlendRM(1, 0x4A, target, fres, tres, disp, cmp, 0); }
+  VPU_CONSTEXPR14 bool blendvps(AVXReg target, AVXReg fres, Mem tres, AVXReg cmp)
+    { return encodeBlendRM(1, 0x4A, target, fres, tres, cmp, 0); }
+
+  VPU_CONSTEXPR14 void fmaddps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeFmaRR(1, 0xB8, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool fmaddps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeFmaRM(1, 0xB8, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool fmaddps(AVXReg target, AVXReg a, Mem b)
+    { return encodeFmaRM(1, 0xB8, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void fmsubps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeFmaRR(1, 0xBA, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool fmsubps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeFmaRM(1, 0xBA, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool fmsubps(AVXReg target, AVXReg a, Mem b)
+    { return encodeFmaRM(1, 0xBA, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void fnmaddps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeFmaRR(1, 0xBC, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool fnmaddps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeFmaRM(1, 0xBC, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool fnmaddps(AVXReg target, AVXReg a, Mem b)
+    { return encodeFmaRM(1, 0xBC, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void fnmsubps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeFmaRR(1, 0xBE, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool fnmsubps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeFmaRM(1, 0xBE, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool fnmsubps(AVXReg target, AVXReg a, Mem b)
+    { return encodeFmaRM(1, 0xBE, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void fmaddsubps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeFmaRR(1, 0xB6, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool fmaddsubps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeFmaRM(1, 0xB6, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool fmaddsubps(AVXReg target, AVXReg a, Mem b)
+    { return encodeFmaRM(1, 0xB6, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void fmsubaddps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeFmaRR(1, 0xB7, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool fmsubaddps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeFmaRM(1, 0xB7, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool fmsubaddps(AVXReg target, AVXReg a, Mem b)
+    { return encodeFmaRM(1, 0xB7, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void movaps(AVXReg to, AVXReg from)
+    { encodeRR(0, 0x28, to, 0, from, 1); }
+  VPU_CONSTEXPR14 bool movaps(AVXReg to, Reg from, int32_t disp)
+    { return encodeRM(0, 0x28, to, 0, from, disp, 1); }
+  VPU_CONSTEXPR14 bool movaps(AVXReg to, Mem from)
+    { return encodeRM(0, 0x28, to, 0, from, 1); }
+  VPU_CONSTEXPR14 bool movaps(Reg to, AVXReg from)
+    { return encodeMR(0, 0x29, to, from, 0, 1); }
+  VPU_CONSTEXPR14 bool movaps(Reg to, int32_t disp, AVXReg from)
+    { return encodeMR(0, 0x29, to, from, disp, 1); }
+  VPU_CONSTEXPR14 bool movaps(Mem to, AVXReg from)
+    { return encodeMR(0, 0x29, to, from, 1); }
+
+  VPU_CONSTEXPR14 void movups(AVXReg to, AVXReg from)
+    { encodeRR(0, 0x10, to, 0, from, 1); }
+  VPU_CONSTEXPR14 bool movups(AVXReg to, Reg from, int32_t disp)
+    { return encodeRM(0, 0x10, to, 0, from, disp, 1); }
+  VPU_CONSTEXPR14 bool movups(AVXReg to, Mem from)
+    { return encodeRM(0, 0x10, to, 0, from, 1); }
+  VPU_CONSTEXPR14 bool movups(Reg to, AVXReg from)
+    { return encodeMR(0, 0x11, to, from, 0, 1); }
+  VPU_CONSTEXPR14 bool movups(Reg to, int32_t disp, AVXReg from)
+    { return encodeMR(0, 0x11, to, from, disp, 1); }
+  VPU_CONSTEXPR14 bool movups(Mem to, AVXReg from)
+    { return encodeMR(0, 0x11, to, from, 1); }
+
+  VPU_CONSTEXPR14 void addps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(0, 0x58, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool addps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(0, 0x58, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool addps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(0, 0x58, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void addsubps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(3, 0xD0, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool addsubps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(3, 0xD0, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool addsubps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(3, 0xD0, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void mulps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(0, 0x59, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool mulps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(0, 0x59, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool mulps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(0, 0x59, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void andps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(0, 0x54, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool andps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(0, 0x54, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool andps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(0, 0x54, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void andnotps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(0, 0x55, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool andnotps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(0, 0x55, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool andnotps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(0, 0x55, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void orps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(0, 0x56, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool orps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(0, 0x56, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool orps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(0, 0x56, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void xorps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(0, 0x57, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool xorps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(0, 0x57, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool xorps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(0, 0x57, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void subps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(0, 0x5C, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool subps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(0, 0x5C, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool subps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(0, 0x5C, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void minps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(0, 0x5D, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool minps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(0, 0x5D, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool minps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(0, 0x5D, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void maxps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(0, 0x5F, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool maxps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(0, 0x5F, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool maxps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(0, 0x5F, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void divps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(0, 0x5E, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool divps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(0, 0x5E, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool divps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(0, 0x5E, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void cmpps(AVXReg target, AVXReg a, AVXReg b, cmp mode)
+    { encodeRR(0, 0xC2, target, a, b, 1); emit8(mode); }
+  VPU_CONSTEXPR14 bool cmpps(AVXReg target, AVXReg a, Reg b, int32_t disp, cmp mode)
+    { if (!encodeRM(0, 0xC2, target, a, b, disp, 1)) return false; emit8(mode); return true; }
+  VPU_CONSTEXPR14 bool cmpps(AVXReg target, AVXReg a, Mem b, cmp mode)
+    { if (!encodeRM(0, 0xC2, target, a, b, 1)) return false; emit8(mode); return true; }
+
+  VPU_CONSTEXPR14 void haddps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(3, 0x7C, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool haddps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(3, 0x7C, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool haddps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(3, 0x7C, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void hsubps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(3, 0x7D, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool hsubps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(3, 0x7D, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool hsubps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(3, 0x7D, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void sqrtps(AVXReg target, AVXReg b)
+    { encodeRR(0, 0x51, target, 0, b, 1); }
+  VPU_CONSTEXPR14 bool sqrtps(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(0, 0x51, target, 0, b, disp, 1); }
+  VPU_CONSTEXPR14 bool sqrtps(AVXReg target, Mem b)
+    { return encodeRM(0, 0x51, target, 0, b, 1); }
+
+  VPU_CONSTEXPR14 void rsqrtps(AVXReg target, AVXReg b)
+    { encodeRR(0, 0x52, target, 0, b, 1); }
+  VPU_CONSTEXPR14 bool rsqrtps(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(0, 0x52, target, 0, b, disp, 1); }
+  VPU_CONSTEXPR14 bool rsqrtps(AVXReg target, Mem b)
+    { return encodeRM(0, 0x52, target, 0, b, 1); }
+
+  VPU_CONSTEXPR14 void rcpps(AVXReg target, AVXReg b)
+    { encodeRR(0, 0x53, target, 0, b, 1); }
+  VPU_CONSTEXPR14 bool rcpps(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(0, 0x53, target, 0, b, disp, 1); }
+  VPU_CONSTEXPR14 bool rcpps(AVXReg target, Mem b)
+    { return encodeRM(0, 0x53, target, 0, b, 1); }
+
+  VPU_CONSTEXPR14 void shuffleps(AVXReg target, AVXReg a, AVXReg b, uint8_t x, uint8_t y, uint8_t z, uint8_t w)
+    { encodeRR(0, 0xC6, target, a, b, 1); emit8(shuffleImm(x, y, z, w)); }
+  VPU_CONSTEXPR14 bool shuffleps(AVXReg target, AVXReg a, Reg b, int32_t disp, uint8_t x, uint8_t y, uint8_t z, uint8_t w)
+    { if (!encodeRM(0, 0xC6, target, a, b, disp, 1)) return false; emit8(shuffleImm(x, y, z, w)); return true; }
+  VPU_CONSTEXPR14 bool shuffleps(AVXReg target, AVXReg a, Mem b, uint8_t x, uint8_t y, uint8_t z, uint8_t w)
+    { if (!encodeRM(0, 0xC6, target, a, b, 1)) return false; emit8(shuffleImm(x, y, z, w)); return true; }
+
+  VPU_CONSTEXPR14 void roundps(AVXReg target, AVXReg a, RoundMode mode)
+    { encodeRR3(1, 8, target, 0, a, 0, 1, 3); emit8(mode); }
+  VPU_CONSTEXPR14 bool roundps(AVXReg target, Reg a, int32_t disp, RoundMode mode)
+    { if (!encodeRM3(1, 8, target, 0, a, disp, 0, 1, 3)) return false; emit8(mode); return true; }
+  VPU_CONSTEXPR14 bool roundps(AVXReg target, Mem a, RoundMode mode)
+    { if (!encodeRM3(1, 8, target, 0, a, 0, 1, 3)) return false; emit8(mode); return true; }
+
+  VPU_CONSTEXPR14 void dpps(AVXReg target, AVXReg a, AVXReg b, uint8_t mask)
+    { encodeRR3(1, 0x40, target, a, b, 0, 1, 3); emit8(mask); }
+  VPU_CONSTEXPR14 bool dpps(AVXReg target, AVXReg a, Reg b, int32_t disp, uint8_t mask)
+    { if (!encodeRM3(1, 0x40, target, a, b, disp, 0, 1, 3)) return false; emit8(mask); return true; }
+  VPU_CONSTEXPR14 bool dpps(AVXReg target, AVXReg a, Mem b, uint8_t mask)
+    { if (!encodeRM3(1, 0x40, target, a, b, 0, 1, 3)) return false; emit8(mask); return true; }
+
+  VPU_CONSTEXPR14 void movemaskps(Reg target, AVXReg a)
+    { encodeRR(0, 0x50, target, 0, a, 1); }
+
+  VPU_CONSTEXPR14 void unpacklops(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(0, 0x14, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool unpacklops(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(0, 0x14, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool unpacklops(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(0, 0x14, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void unpackhips(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(0, 0x15, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool unpackhips(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(0, 0x15, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool unpackhips(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(0, 0x15, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void movehdupps(AVXReg target, AVXReg b)
+    { encodeRR(2, 0x16, target, 0, b, 1); }
+  VPU_CONSTEXPR14 bool movehdupps(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(2, 0x16, target, 0, b, disp, 1); }
+  VPU_CONSTEXPR14 bool movehdupps(AVXReg target, Mem b)
+    { return encodeRM(2, 0x16, target, 0, b, 1); }
+
+  VPU_CONSTEXPR14 void moveldupps(AVXReg target, AVXReg b)
+    { encodeRR(2, 0x12, target, 0, b, 1); }
+  VPU_CONSTEXPR14 bool moveldupps(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(2, 0x12, target, 0, b, disp, 1); }
+  VPU_CONSTEXPR14 bool moveldupps(AVXReg target, Mem b)
+    { return encodeRM(2, 0x12, target, 0, b, 1); }
+
+  VPU_CONSTEXPR14 void permutevar8ps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x16, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool permutevar8ps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x16, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool permutevar8ps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x16, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void permutevarps(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x0C, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool permutevarps(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x0C, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool permutevarps(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x0C, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void permuteps(AVXReg target, AVXReg b, uint8_t x, uint8_t y, uint8_t z, uint8_t w)
+    { encodeRR3(1, 4, target, 0, b, 0, 1, 3); emit8(shuffleImm(x, y, z, w)); }
+  VPU_CONSTEXPR14 bool permuteps(AVXReg target, Reg b, int32_t disp, uint8_t x, uint8_t y, uint8_t z, uint8_t w)
+    { if (!encodeRM3(1, 4, target, 0, b, disp, 0, 1, 3)) return false; emit8(shuffleImm(x, y, z, w)); return true; }
+  VPU_CONSTEXPR14 bool permuteps(AVXReg target, Mem b, uint8_t x, uint8_t y, uint8_t z, uint8_t w)
+    { if (!encodeRM3(1, 4, target, 0, b, 0, 1, 3)) return false; emit8(shuffleImm(x, y, z, w)); return true; }
+
+  VPU_CONSTEXPR14 void cvtpspd(AVXReg target, AVXReg b)
+    { encodeRR(0, 0x5A, target, 0, b, 1); }
+  VPU_CONSTEXPR14 bool cvtpspd(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(0, 0x5A, target, 0, b, disp, 1); }
+  VPU_CONSTEXPR14 bool cvtpspd(AVXReg target, Mem b)
+    { return encodeRM(0, 0x5A, target, 0, b, 1); }
+
+  VPU_CONSTEXPR14 void cvtpsdq(AVXReg target, AVXReg b)
+    { encodeRR(1, 0x5B, target, 0, b, 1); }
+  VPU_CONSTEXPR14 bool cvtpsdq(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(1, 0x5B, target, 0, b, disp, 1); }
+  VPU_CONSTEXPR14 bool cvtpsdq(AVXReg target, Mem b)
+    { return encodeRM(1, 0x5B, target, 0, b, 1); }
+
+  VPU_CONSTEXPR14 void cvtdqps(AVXReg target, AVXReg b)
+    { encodeRR(0, 0x5B, target, 0, b, 1); }
+  VPU_CONSTEXPR14 bool cvtdqps(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(0, 0x5B, target, 0, b, disp, 1); }
+  VPU_CONSTEXPR14 bool cvtdqps(AVXReg target, Mem b)
+    { return encodeRM(0, 0x5B, target, 0, b, 1); }
+
+  /// \name   Half floats (F16C)
+  /// \brief  vcvtph2ps widens 8 half floats (the lower 128 bits of b, or 16 bytes of memory) to 8 floats. vcvtps2ph
+  ///         narrows the 8 floats of b to half floats, rounded by mode (FROUND_CUR_DIRECTION uses MXCSR), into the lower
+  ///         128 bits of target (zeroing the rest), or into 16 bytes of memory. As with movntps, any register can be the
+  ///         base of the (Reg, disp) store form.
+  VPU_CONSTEXPR14 void cvtphps(AVXReg target, AVXReg b)
+    { encodeRR3(1, 0x13, target, 0, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool cvtphps(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x13, target, 0, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool cvtphps(AVXReg target, Mem b)
+    { return encodeRM3(1, 0x13, target, 0, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void cvtpsph(AVXReg target, AVXReg b, RoundMode mode)
+    { encodeRR3(1, 0x1D, b, 0, target, 0, 1, 3); emit8(mode); }
+  VPU_CONSTEXPR14 bool cvtpsph(Reg to, int32_t disp, AVXReg b, RoundMode mode)
+    { return cvtpsph(Mem{ to, RSP, 1, disp }, b, mode); }
+  VPU_CONSTEXPR14 bool cvtpsph(Mem to, AVXReg b, RoundMode mode)
+    { if (!encodeMem(kFormMR, 3, 1, 0x1D, b, 0, to, 0, 1)) return false; emit8(mode); return true; }
+
+  VPU_CONSTEXPR14 void cvtsi2ss(AVXReg target, AVXReg b)
+    { encodeRR(2, 0x2A, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool cvtsi2ss(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(2, 0x2A, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool cvtsi2ss(AVXReg target, Mem b)
+    { return encodeRM(2, 0x2A, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void cvttss2si(Reg target, AVXReg b)
+    { encodeRR(2, 0x2C, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool cvttss2si(Reg target, Reg b, int32_t disp)
+    { return encodeRM(2, 0x2C, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool cvttss2si(Reg target, Mem b)
+    { return encodeRM(2, 0x2C, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void cvtss2si(Reg target, AVXReg b)
+    { encodeRR(2, 0x2D, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool cvtss2si(Reg target, Reg b, int32_t disp)
+    { return encodeRM(2, 0x2D, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool cvtss2si(Reg target, Mem b)
+    { return encodeRM(2, 0x2D, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void cvtsi2sd(AVXReg target, Reg b)
+    { encodeRR(3, 0x2A, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool cvtsi2sd(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(3, 0x2A, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool cvtsi2sd(AVXReg target, Mem b)
+    { return encodeRM(3, 0x2A, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void cvttsd2si(Reg target, AVXReg b)
+    { encodeRR(3, 0x2C, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool cvttsd2si(Reg target, Reg b, int32_t disp)
+    { return encodeRM(3, 0x2C, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool cvttsd2si(Reg target, Mem b)
+    { return encodeRM(3, 0x2C, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void cvtsd2si(Reg target, AVXReg b)
+    { encodeRR(3, 0x2D, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool cvtsd2si(Reg target, Reg b, int32_t disp)
+    { return encodeRM(3, 0x2D, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool cvtsd2si(Reg target, Mem b)
+    { return encodeRM(3, 0x2D, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void cvtpi2ps(AVXReg target, AVXReg b)
+    { encodeRR(0, 0x2A, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool cvtpi2ps(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(0, 0x2A, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool cvtpi2ps(AVXReg target, Mem b)
+    { return encodeRM(0, 0x2A, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void cvtps2pi(AVXReg target, AVXReg b)
+    { encodeRR(0, 0x2D, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool cvtps2pi(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(0, 0x2D, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool cvtps2pi(AVXReg target, Mem b)
+    { return encodeRM(0, 0x2D, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void cvtpi2pd(AVXReg target, AVXReg b)
+    { encodeRR(1, 0x2A, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool cvtpi2pd(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(1, 0x2A, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool cvtpi2pd(AVXReg target, Mem b)
+    { return encodeRM(1, 0x2A, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void cvtpd2pi(AVXReg target, AVXReg b)
+    { encodeRR(1, 0x2D, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool cvtpd2pi(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(1, 0x2D, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool cvtpd2pi(AVXReg target, Mem b)
+    { return encodeRM(1, 0x2D, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void cvttps2pi(AVXReg target, AVXReg b)
+    { encodeRR(0, 0x2C, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool cvttps2pi(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(0, 0x2C, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool cvttps2pi(AVXReg target, Mem b)
+    { return encodeRM(0, 0x2C, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void cvttpd2pi(AVXReg target, AVXReg b)
+    { encodeRR(1, 0x2C, target, 0, b, 1); }
+  VPU_CONSTEXPR14 bool cvttpd2pi(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(1, 0x2C, target, 0, b, disp, 1); }
+  VPU_CONSTEXPR14 bool cvttpd2pi(AVXReg target, Mem b)
+    { return encodeRM(1, 0x2C, target, 0, b, 1); }
+
+  VPU_CONSTEXPR14 void cmpgti8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x64, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool cmpgti8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x64, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool cmpgti8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x64, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void cmpgti16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x65, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool cmpgti16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x65, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool cmpgti16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x65, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void cmpgti32(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x66, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool cmpgti32(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x66, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool cmpgti32(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x66, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void cmpgti64(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x37, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool cmpgti64(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x37, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool cmpgti64(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x37, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void cmpeqi8(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x74, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool cmpeqi8(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x74, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool cmpeqi8(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x74, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void cmpeqi16(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x75, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool cmpeqi16(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x75, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool cmpeqi16(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x75, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void cmpeqi32(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x76, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool cmpeqi32(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x76, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool cmpeqi32(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x76, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void cmpeqi64(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x29, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool cmpeqi64(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x29, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool cmpeqi64(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x29, target, a, b, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void broadcastsd(AVXReg target, AVXReg source)
+    { encodeRR3(1, 0x19, target, 0, source, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcastsd(AVXReg target, Reg source, uint32_t disp)
+    { return encodeRM3(1, 0x19, target, 0, source, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool broadcastsd(AVXReg target, Mem source)
+    { return encodeRM3(1, 0x19, target, 0, source, 0, 1, 2); }
+
+  VPU_CONSTEXPR14 void blendvpd(AVXReg target, AVXReg fres, AVXReg tres, AVXReg cmp)
+    { encodeBlendRR(1, 0x4B, target, fres, tres, cmp, 0); }
+  VPU_CONSTEXPR14 bool blendvpd(AVXReg target, AVXReg fres, Reg tres, int32_t disp, AVXReg cmp)
+    { return encodeBlendRM(1, 0x4B, target, fres, tres, disp, cmp, 0); }
+  VPU_CONSTEXPR14 bool blendvpd(AVXReg target, AVXReg fres, Mem tres, AVXReg cmp)
+    { return encodeBlendRM(1, 0x4B, target, fres, tres, cmp, 0); }
+
+  VPU_CONSTEXPR14 void fmaddpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeFmaRR(1, 0xB8, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool fmaddpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeFmaRM(1, 0xB8, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool fmaddpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeFmaRM(1, 0xB8, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void fmsubpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeFmaRR(1, 0xBA, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool fmsubpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeFmaRM(1, 0xBA, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool fmsubpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeFmaRM(1, 0xBA, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void fnmaddpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeFmaRR(1, 0xBC, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool fnmaddpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeFmaRM(1, 0xBC, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool fnmaddpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeFmaRM(1, 0xBC, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void fnmsubpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeFmaRR(1, 0xBE, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool fnmsubpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeFmaRM(1, 0xBE, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool fnmsubpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeFmaRM(1, 0xBE, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void fmaddsubpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeFmaRR(1, 0xB6, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool fmaddsubpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeFmaRM(1, 0xB6, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool fmaddsubpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeFmaRM(1, 0xB6, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void fmsubaddpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeFmaRR(1, 0xB7, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool fmsubaddpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeFmaRM(1, 0xB7, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool fmsubaddpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeFmaRM(1, 0xB7, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void movapd(AVXReg to, AVXReg from)
+    { encodeRR(1, 0x28, to, 0, from, 1); }
+  VPU_CONSTEXPR14 bool movapd(AVXReg to, Reg from, int32_t disp)
+    { return encodeRM(1, 0x28, to, 0, from, disp, 1); }
+  VPU_CONSTEXPR14 bool movapd(AVXReg to, Mem from)
+    { return encodeRM(1, 0x28, to, 0, from, 1); }
+  VPU_CONSTEXPR14 bool movapd(Reg to, AVXReg from)
+    { return encodeMR(1, 0x29, to, from, 0, 1); }
+  VPU_CONSTEXPR14 bool movapd(Reg to, int32_t disp, AVXReg from)
+    { return encodeMR(1, 0x29, to, from, disp, 1); }
+  VPU_CONSTEXPR14 bool movapd(Mem to, AVXReg from)
+    { return encodeMR(1, 0x29, to, from, 1); }
+
+  VPU_CONSTEXPR14 void movupd(AVXReg to, AVXReg from)
+    { encodeRR(1, 0x10, to, 0, from, 1); }
+  VPU_CONSTEXPR14 bool movupd(AVXReg to, Reg from, int32_t disp)
+    { return encodeRM(1, 0x10, to, 0, from, disp, 1); }
+  VPU_CONSTEXPR14 bool movupd(AVXReg to, Mem from)
+    { return encodeRM(1, 0x10, to, 0, from, 1); }
+  VPU_CONSTEXPR14 bool movupd(Reg to, AVXReg from)
+    { return encodeMR(1, 0x11, to, from, 0, 1); }
+  VPU_CONSTEXPR14 bool movupd(Reg to, int32_t disp, AVXReg from)
+    { return encodeMR(1, 0x11, to, from, disp, 1); }
+  VPU_CONSTEXPR14 bool movupd(Mem to, AVXReg from)
+    { return encodeMR(1, 0x11, to, from, 1); }
+
+  VPU_CONSTEXPR14 void addpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x58, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool addpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x58, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool addpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x58, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void mulpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x59, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool mulpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x59, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool mulpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x59, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void andpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x54, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool andpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x54, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool andpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x54, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void andnotpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x55, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool andnotpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x55, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool andnotpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x55, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void orpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x56, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool orpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x56, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool orpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x56, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void xorpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x57, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool xorpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x57, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool xorpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x57, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void subpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x5C, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool subpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x5C, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool subpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x5C, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void minpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x5D, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool minpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x5D, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool minpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x5D, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void maxpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x5F, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool maxpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x5F, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool maxpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x5F, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void divpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x5E, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool divpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x5E, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool divpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x5E, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void cmppd(AVXReg target, AVXReg a, AVXReg b, cmp mode)
+    { encodeRR(1, 0xC2, target, a, b, 1); emit8(mode); }
+  VPU_CONSTEXPR14 bool cmppd(AVXReg target, AVXReg a, Reg b, int32_t disp, cmp mode)
+    { if (!encodeRM(1, 0xC2, target, a, b, disp, 1)) return false; emit8(mode); return true; }
+  VPU_CONSTEXPR14 bool cmppd(AVXReg target, AVXReg a, Mem b, cmp mode)
+    { if (!encodeRM(1, 0xC2, target, a, b, 1)) return false; emit8(mode); return true; }
+
+  VPU_CONSTEXPR14 void sqrtpd(AVXReg target, AVXReg b)
+    { encodeRR(1, 0x51, target, 0, b, 1); }
+  VPU_CONSTEXPR14 bool sqrtpd(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(1, 0x51, target, 0, b, disp, 1); }
+  VPU_CONSTEXPR14 bool sqrtpd(AVXReg target, Mem b)
+    { return encodeRM(1, 0x51, target, 0, b, 1); }
+
+  VPU_CONSTEXPR14 void shufflepd(AVXReg target, AVXReg a, AVXReg b, uint8_t x, uint8_t y)
+    { encodeRR(1, 0xC6, target, a, b, 1); emit8(uint8_t((y & 1) << 1 | (x & 1))); }
+  VPU_CONSTEXPR14 bool shufflepd(AVXReg target, AVXReg a, Reg b, int32_t disp, uint8_t x, uint8_t y)
+    { if (!encodeRM(1, 0xC6, target, a, b, disp, 1)) return false; emit8(uint8_t((y & 1) << 1 | (x & 1))); return true; }
+  VPU_CONSTEXPR14 bool shufflepd(AVXReg target, AVXReg a, Mem b, uint8_t x, uint8_t y)
+    { if (!encodeRM(1, 0xC6, target, a, b, 1)) return false; emit8(uint8_t((y & 1) << 1 | (x & 1))); return true; }
+
+  VPU_CONSTEXPR14 void roundpd(AVXReg target, AVXReg a, RoundMode mode)
+    { encodeRR3(1, 9, target, 0, a, 0, 1, 3); emit8(mode); }
+  VPU_CONSTEXPR14 bool roundpd(AVXReg target, Reg a, int32_t disp, RoundMode mode)
+    { if (!encodeRM3(1, 9, target, 0, a, disp, 0, 1, 3)) return false; emit8(mode); return true; }
+  VPU_CONSTEXPR14 bool roundpd(AVXReg target, Mem a, RoundMode mode)
+    { if (!encodeRM3(1, 9, target, 0, a, 0, 1, 3)) return false; emit8(mode); return true; }
+
+  VPU_CONSTEXPR14 void dppd(AVXReg target, AVXReg a, AVXReg b, uint8_t mask)
+    { encodeRR3(1, 0x41, target, a, b, 0, 1, 3); emit8(mask); }
+  VPU_CONSTEXPR14 bool dppd(AVXReg target, AVXReg a, Reg b, int32_t disp, uint8_t mask)
+    { if (!encodeRM3(1, 0x41, target, a, b, disp, 0, 1, 3)) return false; emit8(mask); return true; }
+  VPU_CONSTEXPR14 bool dppd(AVXReg target, AVXReg a, Mem b, uint8_t mask)
+    { if (!encodeRM3(1, 0x41, target, a, b, 0, 1, 3)) return false; emit8(mask); return true; }
+
+  VPU_CONSTEXPR14 void haddpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x7C, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool haddpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x7C, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool haddpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x7C, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void hsubpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x7D, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool hsubpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x7D, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool hsubpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x7D, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void movemaskpd(Reg target, AVXReg a)
+    { encodeRR(1, 0x50, target, 0, a, 1); }
+
+  VPU_CONSTEXPR14 void unpacklopd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x14, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool unpacklopd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x14, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool unpacklopd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x14, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void unpackhipd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(1, 0x15, target, a, b, 1); }
+  VPU_CONSTEXPR14 bool unpackhipd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(1, 0x15, target, a, b, disp, 1); }
+  VPU_CONSTEXPR14 bool unpackhipd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(1, 0x15, target, a, b, 1); }
+
+  VPU_CONSTEXPR14 void moveduppd(AVXReg target, AVXReg b)
+    { encodeRR(3, 0x12, target, 0, b, 1); }
+  VPU_CONSTEXPR14 bool moveduppd(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(3, 0x12, target, 0, b, disp, 1); }
+  VPU_CONSTEXPR14 bool moveduppd(AVXReg target, Mem b)
+    { return encodeRM(3, 0x12, target, 0, b, 1); }
+
+  VPU_CONSTEXPR14 void permutevarpd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR3(1, 0x0D, target, a, b, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool permutevarpd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM3(1, 0x0D, target, a, b, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool permutevarpd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM3(1, 0x0D, target, a, b, 0, 1, 2); }
+
+  /// \note   x & y select the element (0 or 1) of each pair. The DLL masks y with 3 in the memory form (so y = 2 or 3 
+  ///         also sets bit 2 of the immediate), but with 1 in the register form. Every form here masks with 1, so the 
+  ///         code only matches the DLL's memory form for y = 0 or 1.
+  VPU_CONSTEXPR14 void permutepd(AVXReg target, AVXReg b, uint8_t x, uint8_t y)
+    { encodeRR3(1, 5, target, 0, b, 0, 1, 3); emit8(permutepdImm(x, y)); }
+  VPU_CONSTEXPR14 bool permutepd(AVXReg target, Reg b, int32_t disp, uint8_t x, uint8_t y)
+    { if (!encodeRM3(1, 5, target, 0, b, disp, 0, 1, 3)) return false; emit8(permutepdImm(x, y)); return true; }
+  VPU_CONSTEXPR14 bool permutepd(AVXReg target, Mem b, uint8_t x, uint8_t y)
+    { if (!encodeRM3(1, 5, target, 0, b, 0, 1, 3)) return false; emit8(permutepdImm(x, y)); return true; }
+
+  VPU_CONSTEXPR14 void movss(AVXReg to, AVXReg from)
+    { encodeRR(2, 0x10, to, 0, from, 0); }
+  VPU_CONSTEXPR14 bool movss(AVXReg to, Reg from, int32_t disp)
+    { return encodeRM(2, 0x10, to, 0, from, disp, 0); }
+  VPU_CONSTEXPR14 bool movss(AVXReg to, Mem from)
+    { return encodeRM(2, 0x10, to, 0, from, 0); }
+  VPU_CONSTEXPR14 bool movss(Reg to, AVXReg from)
+    { return encodeMR(2, 0x11, to, from, 0, 0); }
+  VPU_CONSTEXPR14 bool movss(Reg to, int32_t disp, AVXReg from)
+    { return encodeMR(2, 0x11, to, from, disp, 0); }
+  VPU_CONSTEXPR14 bool movss(Mem to, AVXReg from)
+    { return encodeMR(2, 0x11, to, from, 0); }
+
+  VPU_CONSTEXPR14 void addss(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(2, 0x58, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool addss(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(2, 0x58, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool addss(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(2, 0x58, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void mulss(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(2, 0x59, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool mulss(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(2, 0x59, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool mulss(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(2, 0x59, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void subss(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(2, 0x5C, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool subss(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(2, 0x5C, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool subss(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(2, 0x5C, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void minss(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(2, 0x5D, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool minss(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(2, 0x5D, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool minss(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(2, 0x5D, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void maxss(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(2, 0x5F, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool maxss(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(2, 0x5F, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool maxss(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(2, 0x5F, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void divss(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(2, 0x5E, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool divss(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(2, 0x5E, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool divss(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(2, 0x5E, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void cmpss(AVXReg target, AVXReg a, AVXReg b, cmp mode)
+    { encodeRR(2, 0xC2, target, a, b, 0); emit8(mode); }
+  VPU_CONSTEXPR14 bool cmpss(AVXReg target, AVXReg a, Reg b, int32_t disp, cmp mode)
+    { if (!encodeRM(2, 0xC2, target, a, b, disp, 0)) return false; emit8(mode); return true; }
+  VPU_CONSTEXPR14 bool cmpss(AVXReg target, AVXReg a, Mem b, cmp mode)
+    { if (!encodeRM(2, 0xC2, target, a, b, 0)) return false; emit8(mode); return true; }
+
+  VPU_CONSTEXPR14 void sqrtss(AVXReg target, AVXReg b)
+    { encodeRR(2, 0x51, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool sqrtss(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(2, 0x51, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool sqrtss(AVXReg target, Mem b)
+    { return encodeRM(2, 0x51, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void rsqrtss(AVXReg target, AVXReg b)
+    { encodeRR(2, 0x52, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool rsqrtss(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(2, 0x52, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool rsqrtss(AVXReg target, Mem b)
+    { return encodeRM(2, 0x52, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void rcpss(AVXReg target, AVXReg b)
+    { encodeRR(2, 0x53, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool rcpss(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(2, 0x53, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool rcpss(AVXReg target, Mem b)
+    { return encodeRM(2, 0x53, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void roundss(AVXReg target, AVXReg a, RoundMode mode)
+    { encodeRR3(1, 0x0A, target, 0, a, 0, 0, 3); emit8(mode); }
+  VPU_CONSTEXPR14 bool roundss(AVXReg target, Reg a, uint32_t disp, RoundMode mode)
+    { if (!encodeRM3(1, 0x0A, target, 0, a, disp, 0, 0, 3)) return false; emit8(mode); return true; }
+  VPU_CONSTEXPR14 bool roundss(AVXReg target, Mem a, RoundMode mode)
+    { if (!encodeRM3(1, 0x0A, target, 0, a, 0, 0, 3)) return false; emit8(mode); return true; }
+
+  VPU_CONSTEXPR14 void movsd(AVXReg to, AVXReg from)
+    { encodeRR(3, 0x10, to, 0, from, 0); }
+  VPU_CONSTEXPR14 bool movsd(AVXReg to, Reg from, int32_t disp)
+    { return encodeRM(3, 0x10, to, 0, from, disp, 0); }
+  VPU_CONSTEXPR14 bool movsd(AVXReg to, Mem from)
+    { return encodeRM(3, 0x10, to, 0, from, 0); }
+  VPU_CONSTEXPR14 bool movsd(Reg to, AVXReg from)
+    { return encodeMR(3, 0x11, to, from, 0, 0); }
+  VPU_CONSTEXPR14 bool movsd(Reg to, int32_t disp, AVXReg from)
+    { return encodeMR(3, 0x11, to, from, disp, 0); }
+  VPU_CONSTEXPR14 bool movsd(Mem to, AVXReg from)
+    { return encodeMR(3, 0x11, to, from, 0); }
+
+  VPU_CONSTEXPR14 void addsd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(3, 0x58, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool addsd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(3, 0x58, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool addsd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(3, 0x58, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void mulsd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(3, 0x59, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool mulsd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(3, 0x59, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool mulsd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(3, 0x59, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void subsd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(3, 0x5C, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool subsd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(3, 0x5C, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool subsd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(3, 0x5C, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void minsd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(3, 0x5D, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool minsd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(3, 0x5D, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool minsd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(3, 0x5D, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void maxsd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(3, 0x5F, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool maxsd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(3, 0x5F, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool maxsd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(3, 0x5F, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void divsd(AVXReg target, AVXReg a, AVXReg b)
+    { encodeRR(3, 0x5E, target, a, b, 0); }
+  VPU_CONSTEXPR14 bool divsd(AVXReg target, AVXReg a, Reg b, int32_t disp)
+    { return encodeRM(3, 0x5E, target, a, b, disp, 0); }
+  VPU_CONSTEXPR14 bool divsd(AVXReg target, AVXReg a, Mem b)
+    { return encodeRM(3, 0x5E, target, a, b, 0); }
+
+  VPU_CONSTEXPR14 void cmpsd(AVXReg target, AVXReg a, AVXReg b, cmp mode)
+    { encodeRR(3, 0xC2, target, a, b, 0); emit8(mode); }
+  VPU_CONSTEXPR14 bool cmpsd(AVXReg target, AVXReg a, Reg b, int32_t disp, cmp mode)
+    { if (!encodeRM(3, 0xC2, target, a, b, disp, 0)) return false; emit8(mode); return true; }
+  VPU_CONSTEXPR14 bool cmpsd(AVXReg target, AVXReg a, Mem b, cmp mode)
+    { if (!encodeRM(3, 0xC2, target, a, b, 0)) return false; emit8(mode); return true; }
+
+  VPU_CONSTEXPR14 void sqrtsd(AVXReg target, AVXReg b)
+    { encodeRR(3, 0x51, target, 0, b, 0); }
+  VPU_CONSTEXPR14 bool sqrtsd(AVXReg target, Reg b, int32_t disp)
+    { return encodeRM(3, 0x51, target, 0, b, disp, 0); }
+  VPU_CONSTEXPR14 bool sqrtsd(AVXReg target, Mem b)
+    { return encodeRM(3, 0x51, target, 0, b, 0); }
+
+  VPU_CONSTEXPR14 void roundsd(AVXReg target, AVXReg a, RoundMode mode)
+    { encodeRR3(1, 0x0B, target, 0, a, 0, 0, 3); emit8(mode); }
+  VPU_CONSTEXPR14 bool roundsd(AVXReg target, Reg a, int32_t disp, RoundMode mode)
+    { if (!encodeRM3(1, 0x0B, target, 0, a, disp, 0, 0, 3)) return false; emit8(mode); return true; }
+  VPU_CONSTEXPR14 bool roundsd(AVXReg target, Mem a, RoundMode mode)
+    { if (!encodeRM3(1, 0x0B, target, 0, a, 0, 0, 3)) return false; emit8(mode); return true; }
+
+  /// \name   General Purpose register manipulation
+
+  VPU_CONSTEXPR14 void push(Reg reg)
+    { self().useRegister(reg); describe(kFormGprOnly, 0, 0, 0x50, 1, 0, 0, 0, reg, 0); emit2(reg < 8 ? 0x40 : 0x49, uint8_t(0x50 | (reg & 7))); }
+  VPU_CONSTEXPR14 void pop(Reg reg)
+    { self().useRegister(reg); describe(kFormGprOnly, 0, 0, 0x58, 1, 0, 0, 0, reg, 0); emit2(reg < 8 ? 0x40 : 0x49, uint8_t(0x58 | (reg & 7))); }
+
+  /// \note   encodes the same instruction as mov64(output, input, offset), just like the DLL
+  VPU_CONSTEXPR14 void add(Reg output, Reg input, int32_t offset)
+    { encodeGpr(0x8B, input, output, offset); }
+  VPU_CONSTEXPR14 void mov64(Reg output, Reg input, int32_t offset)
+    { encodeGpr(0x8B, input, output, offset); }
+  VPU_CONSTEXPR14 void mov64(Reg output, int32_t offset, Reg input)
+    { encodeGpr(0x89, output, input, offset); }
+  VPU_CONSTEXPR14 void lea(Reg target, Reg b, int32_t offset)
+    { encodeGpr(0x8D, b, target, offset); }
+  VPU_CONSTEXPR14 bool mov64(Reg output, Mem input)
+    { return encodeGpr(0x8B, input, output); }
+  VPU_CONSTEXPR14 bool mov64(Mem output, Reg input)
+    { return encodeGpr(0x89, output, input); }
+  VPU_CONSTEXPR14 bool lea(Reg target, Mem b)
+    { return encodeGpr(0x8D, b, target); }
+
+  VPU_CONSTEXPR14 void setzero(AVXReg r)
+    { xorps(r, YMM0, YMM0); }
+
+  VPU_CONSTEXPR14 void loadcount(Reg r, uint32_t count)
+    {
+      self().useRegister(r);
+      describe(kFormGprOnly, 0, 0, 0xB8, 1, 0, 0, 0, r, int32_t(count));
+      uint8_t* p = self().reserve(10);
+      if (r < 8)
+      {
+        *p++ = uint8_t(0xB8 | r);
+        p = write32(p, count);
+      }
+      else
+      {
+        // the DLL uses the 64bit form for R8 -> R15
+        *p++ = 0x49;
+        *p++ = uint8_t(0xB8 | (r & 7));
+        p = write32(p, count);
+        p = write32(p, 0);
+      }
+      self().commit(p);
+    }
+
+  VPU_CONSTEXPR14 void dec(Reg r)
+    { self().useRegister(r); describe(kFormGprOnly, 0, 0, 0xFF, 1, 0, 1, 0, r, 0); emit3(r < 8 ? 0x48 : 0x49, 0xFF, uint8_t(0xC8 | (r & 7))); }
+  VPU_CONSTEXPR14 void inc(Reg r)
+    { self().useRegister(r); describe(kFormGprOnly, 0, 0, 0xFF, 1, 0, 0, 0, r, 0); emit3(r < 8 ? 0x48 : 0x49, 0xFF, uint8_t(0xC0 | (r & 7))); }
+
+  VPU_CONSTEXPR14 void add(Reg r, int32_t immediate)
+    { encodeImm(0, r, immediate); }
+  VPU_CONSTEXPR14 void or(Reg r, int32_t immediate)
+    { encodeImm(1, r, immediate); }
+  VPU_CONSTEXPR14 void adc(Reg r, int32_t immediate)
+    { encodeImm(2, r, immediate); }
+  VPU_CONSTEXPR14 void sbb(Reg r, int32_t immediate)
+    { encodeImm(3, r, immediate); }
+  VPU_CONSTEXPR14 void and(Reg r, int32_t immediate)
+    { encodeImm(4, r, immediate); }
+  VPU_CONSTEXPR14 void sub(Reg r, int32_t immediate)
+    { encodeImm(5, r, immediate); }
+  VPU_CONSTEXPR14 void xor(Reg r, int32_t immediate)
+    { encodeImm(6, r, immediate); }
+  VPU_CONSTEXPR14 void cmp(Reg r, int32_t immediate)
+    { encodeImm(7, r, immediate); }
+
+  /// \brief  target = target op a. The memory forms take a Mem, since add(Reg, Reg, int32_t) is mov64.
+  VPU_CONSTEXPR14 void add(Reg target, Reg a)
+    { encodeGprRR(0, 0x03, target, a); }
+  VPU_CONSTEXPR14 bool add(Reg target, Mem a)
+    { return encodeGpr(0x03, a, target); }
+  VPU_CONSTEXPR14 void or(Reg target, Reg a)
+    { encodeGprRR(0, 0x0B, target, a); }
+  VPU_CONSTEXPR14 bool or(Reg target, Mem a)
+    { return encodeGpr(0x0B, a, target); }
+  VPU_CONSTEXPR14 void adc(Reg target, Reg a)
+    { encodeGprRR(0, 0x13, target, a); }
+  VPU_CONSTEXPR14 bool adc(Reg target, Mem a)
+    { return encodeGpr(0x13, a, target); }
+  VPU_CONSTEXPR14 void sbb(Reg target, Reg a)
+    { encodeGprRR(0, 0x1B, target, a); }
+  VPU_CONSTEXPR14 bool sbb(Reg target, Mem a)
+    { return encodeGpr(0x1B, a, target); }
+  VPU_CONSTEXPR14 void and(Reg target, Reg a)
+    { encodeGprRR(0, 0x23, target, a); }
+  VPU_CONSTEXPR14 bool and(Reg target, Mem a)
+    { return encodeGpr(0x23, a, target); }
+  VPU_CONSTEXPR14 void sub(Reg target, Reg a)
+    { encodeGprRR(0, 0x2B, target, a); }
+  VPU_CONSTEXPR14 bool sub(Reg target, Mem a)
+    { return encodeGpr(0x2B, a, target); }
+  VPU_CONSTEXPR14 void xor(Reg target, Reg a)
+    { encodeGprRR(0, 0x33, target, a); }
+  VPU_CONSTEXPR14 bool xor(Reg target, Mem a)
+    { return encodeGpr(0x33, a, target); }
+  VPU_CONSTEXPR14 void cmp(Reg target, Reg a)
+    { encodeGprRR(0, 0x3B, target, a); }
+  VPU_CONSTEXPR14 bool cmp(Reg target, Mem a)
+    { return encodeGpr(0x3B, a, target); }
+
+  /// sets the flags from a & b
+  VPU_CONSTEXPR14 void test(Reg a, Reg b)
+    { encodeGprRR(0, 0x85, b, a); }
+  VPU_CONSTEXPR14 bool test(Reg a, Mem b)
+    { return encodeGpr(0x85, b, a); }
+  VPU_CONSTEXPR14 void test(Reg r, int32_t immediate)
+    { encodeUnary(0, 0xF7, 0, r, immediate); }
+
+  /// target = target * a, or a * immediate (the low 64 bits of the product)
+  VPU_CONSTEXPR14 void imul(Reg target, Reg a)
+    { encodeGprRR(1, 0xAF, target, a); }
+  VPU_CONSTEXPR14 bool imul(Reg target, Mem a)
+    { return encodeGpr(0xAF, a, target, 1); }
+  VPU_CONSTEXPR14 void imul(Reg target, Reg a, int32_t immediate)
+    { encodeGprRR(0, (immediate >= -128 && immediate <= 127) ? 0x6B : 0x69, target, a, immediate); }
+
+  VPU_CONSTEXPR14 void neg(Reg r)
+    { encodeUnary(0, 0xF7, 3, r); }
+  VPU_CONSTEXPR14 void not(Reg r)
+    { encodeUnary(0, 0xF7, 2, r); }
+
+  /// \brief  shifts by a constant (the count is masked to 0 -> 63), or by CL (count must be RCX, otherwise nothing is
+  ///         emitted, and these return false)
+  VPU_CONSTEXPR14 void shl(Reg r, uint8_t count)
+    { encodeShift(4, r, count); }
+  VPU_CONSTEXPR14 void shr(Reg r, uint8_t count)
+    { encodeShift(5, r, count); }
+  VPU_CONSTEXPR14 void sar(Reg r, uint8_t count)
+    { encodeShift(7, r, count); }
+  VPU_CONSTEXPR14 bool shl(Reg r, Reg count)
+    { return encodeShift(4, r, count); }
+  VPU_CONSTEXPR14 bool shr(Reg r, Reg count)
+    { return encodeShift(5, r, count); }
+  VPU_CONSTEXPR14 bool sar(Reg r, Reg count)
+    { return encodeShift(7, r, count); }
+
+  /// \brief  target = a, if the flags meet the condition (the same conditions as the jumps)
+  VPU_CONSTEXPR14 void cmov_eq(Reg target, Reg a)
+    { encodeGprRR(1, 0x44, target, a); }
+  VPU_CONSTEXPR14 bool cmov_eq(Reg target, Mem a)
+    { return encodeGpr(0x44, a, target, 1); }
+  VPU_CONSTEXPR14 void cmov_ne(Reg target, Reg a)
+    { encodeGprRR(1, 0x45, target, a); }
+  VPU_CONSTEXPR14 bool cmov_ne(Reg target, Mem a)
+    { return encodeGpr(0x45, a, target, 1); }
+  VPU_CONSTEXPR14 void cmov_lt(Reg target, Reg a)
+    { encodeGprRR(1, 0x4C, target, a); }
+  VPU_CONSTEXPR14 bool cmov_lt(Reg target, Mem a)
+    { return encodeGpr(0x4C, a, target, 1); }
+  VPU_CONSTEXPR14 void cmov_gt(Reg target, Reg a)
+    { encodeGprRR(1, 0x4F, target, a); }
+  VPU_CONSTEXPR14 bool cmov_gt(Reg target, Mem a)
+    { return encodeGpr(0x4F, a, target, 1); }
+  VPU_CONSTEXPR14 void cmov_le(Reg target, Reg a)
+    { encodeGprRR(1, 0x4E, target, a); }
+  VPU_CONSTEXPR14 bool cmov_le(Reg target, Mem a)
+    { return encodeGpr(0x4E, a, target, 1); }
+  VPU_CONSTEXPR14 void cmov_ge(Reg target, Reg a)
+    { encodeGprRR(1, 0x4D, target, a); }
+  VPU_CONSTEXPR14 bool cmov_ge(Reg target, Mem a)
+    { return encodeGpr(0x4D, a, target, 1); }
+
+  /// \brief  sets the low byte of r to 1 if the flags meet the condition, otherwise 0. The rest of r is unchanged, so
+  ///         zero it first: with xor before the cmp (since xor writes the flags), or with mov(r, 0) after it.
+  VPU_CONSTEXPR14 void set_eq(Reg r)
+    { encodeUnary(1, 0x94, 0, r); }
+  VPU_CONSTEXPR14 void set_ne(Reg r)
+    { encodeUnary(1, 0x95, 0, r); }
+  VPU_CONSTEXPR14 void set_lt(Reg r)
+    { encodeUnary(1, 0x9C, 0, r); }
+  VPU_CONSTEXPR14 void set_gt(Reg r)
+    { encodeUnary(1, 0x9F, 0, r); }
+  VPU_CONSTEXPR14 void set_le(Reg r)
+    { encodeUnary(1, 0x9E, 0, r); }
+  VPU_CONSTEXPR14 void set_ge(Reg r)
+    { encodeUnary(1, 0x9D, 0, r); }
+
+  /// \brief  r = value, in the shortest encoding: mov r32, imm32 (which zeroes the upper half) if the value fits in 32
+  ///         bits unsigned, REX.W C7 /0 imm32 (which sign extends it) if it fits in 32 bits signed, and REX.W B8 imm64
+  ///         otherwise. Unlike xor r, r, this leaves the flags alone.
+  VPU_CONSTEXPR14 void mov(Reg r, int64_t value)
+    {
+      self().useRegister(r);
+      describe(kFormGprOnly, 0, 0, 0xB8, 1, 0, 0, 0, r, int32_t(value));
+      uint8_t* p = self().reserve(10);
+      if (value >= 0 && value <= int64_t(0xFFFFFFFFu))
+      {
+        if (r >= 8)
+          *p++ = 0x41;
+        *p++ = uint8_t(0xB8 | (r & 7));
+        p = write32(p, uint32_t(value));
+      }
+      else
+      if (value >= -int64_t(0x80000000u) && value < 0)
+      {
+        *p++ = r < 8 ? 0x48 : 0x49;
+        *p++ = 0xC7;
+        *p++ = uint8_t(0xC0 | (r & 7));
+        p = write32(p, uint32_t(value));
+      }
+      else
+      {
+        *p++ = r < 8 ? 0x48 : 0x49;
+        *p++ = uint8_t(0xB8 | (r & 7));
+        p = write32(p, uint32_t(value));
+        p = write32(p, uint32_t(uint64_t(value) >> 32));
+      }
+      self().commit(p);
+    }
+
+  // jump to a previous location within the code
+  VPU_CONSTEXPR14 void jump_eq_to(uint32_t location)
+    { jump_eq(jumpOffset(location)); }
+  VPU_CONSTEXPR14 void jump_ne_to(uint32_t location)
+    { jump_ne(jumpOffset(location)); }
+  VPU_CONSTEXPR14 void jump_lt_to(uint32_t location)
+    { jump_lt(jumpOffset(location)); }
+  VPU_CONSTEXPR14 void jump_gt_to(uint32_t location)
+    { jump_gt(jumpOffset(location)); }
+  VPU_CONSTEXPR14 void jump_le_to(uint32_t location)
+    { jump_le(jumpOffset(location)); }
+  VPU_CONSTEXPR14 void jump_ge_to(uint32_t location)
+    { jump_ge(jumpOffset(location)); }
+
+  // jump relative to the end of the jump instruction
+  VPU_CONSTEXPR14 void jump_eq(int32_t offset)
+    { jump(0x4, offset); }
+  VPU_CONSTEXPR14 void jump_ne(int32_t offset)
+    { jump(0x5, offset); }
+  VPU_CONSTEXPR14 void jump_lt(int32_t offset)
+    { jump(0xC, offset); }
+  VPU_CONSTEXPR14 void jump_gt(int32_t offset)
+    { jump(0xF, offset); }
+  VPU_CONSTEXPR14 void jump_le(int32_t offset)
+    { jump(0xE, offset); }
+  VPU_CONSTEXPR14 void jump_ge(int32_t offset)
+    { jump(0xD, offset); }
+
+  /// copy register value
+  VPU_CONSTEXPR14 void mov(Reg target, Reg a)
+    {
+      self().useRegister(target);
+      self().useRegister(a);
+      describe(kFormGprMove, 0, 0, 0x8B, 1, 0, target, 0, a, 0);
+      emit3(uint8_t(0x48 | (a >> 3) | (target >> 3) << 2), 0x8B, uint8_t(0xC0 | (target & 7) << 3 | (a & 7)));
+    }
+
+  /// function return!
+  VPU_CONSTEXPR14 void ret()
+    { describe(kFormRet, 0, 0, 0xC3, 0, 0, 0, 0, 0, 0); emit8(0xC3); }
+
+  /// \brief  vzeroupper: zeroes the upper halves of every YMM register, which avoids the penalty for mixing AVX with
+  ///         legacy SSE code (see EmitterBase::setZeroUpper)
+  VPU_CONSTEXPR14 void zeroupper()
+    { describe(kFormOther, 1, 0, 0x77, 0, 0, 0, 0, 0, 0); emit3(0xC5, 0xF8, 0x77); }
+
+  /// \brief  pads the code with NOPs (the recommended multi-byte forms), until its size is a multiple of boundary. The
+  ///         code must be placed on the same boundary to run (e.g. by a CodeArena with that alignment).
+  /// \param  boundary a power of 2
+  VPU_CONSTEXPR14 void align(uint32_t boundary)
+    {
+      if (!boundary || (boundary & (boundary - 1)))
+        return;
+      describe(kFormAlign, 0, 0, 0x90, 0, 0, 0, 0, 0, int32_t(boundary));
+      for (uint32_t num_bytes = uint32_t(0 - self().numBytes()) & (boundary - 1); num_bytes; )
+      {
+        const uint32_t n = num_bytes < kMaxReserve ? num_bytes : uint32_t(kMaxReserve);
+        uint8_t* p = self().reserve(n);
+        self().commit(writeNops(p, n));
+        num_bytes -= n;
+      }
+    }
+
+  /// \name   Masked loads & stores
+  /// \brief  Only the elements whose mask element has its top bit set are read (the others are zeroed) or written.
+  ///         Elements that aren't accessed don't fault, so these can read & write the partial vector at the end of an
+  ///         array (see EmitterBase::tail_mask).
+
+  VPU_CONSTEXPR14 bool maskmovps(AVXReg to, AVXReg mask, Reg from, int32_t disp)
+    { return encodeRM3(1, 0x2C, to, mask, from, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool maskmovps(AVXReg to, AVXReg mask, Mem from)
+    { return encodeRM3(1, 0x2C, to, mask, from, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool maskmovps(Reg to, int32_t disp, AVXReg mask, AVXReg from)
+    { return encodeMaskStore(0x2E, 0, to, disp, mask, from); }
+  VPU_CONSTEXPR14 bool maskmovps(Mem to, AVXReg mask, AVXReg from)
+    { return encodeMaskStore(0x2E, 0, to, mask, from); }
+  VPU_CONSTEXPR14 bool maskmovpd(AVXReg to, AVXReg mask, Reg from, int32_t disp)
+    { return encodeRM3(1, 0x2D, to, mask, from, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool maskmovpd(AVXReg to, AVXReg mask, Mem from)
+    { return encodeRM3(1, 0x2D, to, mask, from, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool maskmovpd(Reg to, int32_t disp, AVXReg mask, AVXReg from)
+    { return encodeMaskStore(0x2F, 0, to, disp, mask, from); }
+  VPU_CONSTEXPR14 bool maskmovpd(Mem to, AVXReg mask, AVXReg from)
+    { return encodeMaskStore(0x2F, 0, to, mask, from); }
+  VPU_CONSTEXPR14 bool pmaskmovd(AVXReg to, AVXReg mask, Reg from, int32_t disp)
+    { return encodeRM3(1, 0x8C, to, mask, from, disp, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool pmaskmovd(AVXReg to, AVXReg mask, Mem from)
+    { return encodeRM3(1, 0x8C, to, mask, from, 0, 1, 2); }
+  VPU_CONSTEXPR14 bool pmaskmovd(Reg to, int32_t disp, AVXReg mask, AVXReg from)
+    { return encodeMaskStore(0x8E, 0, to, disp, mask, from); }
+  VPU_CONSTEXPR14 bool pmaskmovd(Mem to, AVXReg mask, AVXReg from)
+    { return encodeMaskStore(0x8E, 0, to, mask, from); }
+  VPU_CONSTEXPR14 bool pmaskmovq(AVXReg to, AVXReg mask, Reg from, int32_t disp)
+    { return encodeRM3(1, 0x8C, to, mask, from, disp, 1, 1, 2); }
+  VPU_CONSTEXPR14 bool pmaskmovq(AVXReg to, AVXReg mask, Mem from)
+    { return encodeRM3(1, 0x8C, to, mask, from, 1, 1, 2); }
+  VPU_CONSTEXPR14 bool pmaskmovq(Reg to, int32_t disp, AVXReg mask, AVXReg from)
+    { return encodeMaskStore(0x8E, 1, to, disp, mask, from); }
+  VPU_CONSTEXPR14 bool pmaskmovq(Mem to, AVXReg mask, AVXReg from)
+    { return encodeMaskStore(0x8E, 1, to, mask, from); }
+
+  /// vmovd: target = the low 32 bits of source, with the rest of target zeroed
+  VPU_CONSTEXPR14 void movd(AVXReg target, Reg source)
+    {
+      self().useRegister(target);
+      self().useRegister(source);
+      describe(kFormOther, 1, 1, 0x6E, 0, 0, target, 0, source, 0);
+      uint8_t* p = self().reserve(5);
+      if (source < 8)
+      {
+        *p++ = 0xC5;
+        *p++ = uint8_t(vexR(target) | 0x79);
+      }
+      else
+      {
+        *p++ = 0xC4;
+        *p++ = uint8_t(vexR(target) | 0x41);
+        *p++ = 0x79;
+      }
+      *p++ = 0x6E;
+      *p++ = uint8_t(0xC0 | (target & 7) << 3 | (source & 7));
+      self().commit(p);
+    }
+
+  /// \name   Non-temporal stores & prefetches
+  /// \brief  vmovntps, vmovntpd & vmovntdq write to memory without reading the line into the cache first, or keeping it
+  ///         there afterwards. The address must be 32 byte aligned. The stores are weakly ordered, so follow a run of
+  ///         them with sfence before another thread may read the memory. Unlike the other (Reg, disp) forms, any
+  ///         register can be the base.
+  VPU_CONSTEXPR14 bool movntps(Reg to, int32_t disp, AVXReg from)
+    { return movntps(Mem{ to, RSP, 1, disp }, from); }
+  VPU_CONSTEXPR14 bool movntps(Mem to, AVXReg from)
+    { return encodeMR(0, 0x2B, to, from, 1); }
+  VPU_CONSTEXPR14 bool movntpd(Reg to, int32_t disp, AVXReg from)
+    { return movntpd(Mem{ to, RSP, 1, disp }, from); }
+  VPU_CONSTEXPR14 bool movntpd(Mem to, AVXReg from)
+    { return encodeMR(1, 0x2B, to, from, 1); }
+  VPU_CONSTEXPR14 bool movntdq(Reg to, int32_t disp, AVXReg from)
+    { return movntdq(Mem{ to, RSP, 1, disp }, from); }
+  VPU_CONSTEXPR14 bool movntdq(Mem to, AVXReg from)
+    { return encodeMR(1, 0xE7, to, from, 1); }
+
+  VPU_CONSTEXPR14 void sfence()
+    { describe(kFormOther, 1, 0, 0xAE, 0, 0, 7, 0, 0, 0); emit3(0x0F, 0xAE, 0xF8); }
+
+  /// \brief  hints that the cache line containing the address will be read soon (see PrefetchHint). A prefetch never
+  ///         faults, so it can safely run past the end of an array.
+  VPU_CONSTEXPR14 bool prefetch(Reg address, int32_t disp, PrefetchHint hint)
+    { return prefetch(Mem{ address, RSP, 1, disp }, hint); }
+  VPU_CONSTEXPR14 bool prefetch(Mem address, PrefetchHint hint)
+    {
+      self().useRegister(address.base);
+      if (address.index != RSP)
+        self().useRegister(address.index);
+      if (address.index != RSP && scaleBits(address.scale) == 1)
+        return false;
+      describe(kFormPrefetch, 1, 0, 0x18, 0, 0, uint8_t(hint & 3), 0, address.base, address.disp,
+        address.index == RSP ? 0 : address.index, describedScale(address));
+      uint8_t* p = self().reserve(10);
+      if ((address.base | address.index) & 8)
+        *p++ = uint8_t(0x40 | ((address.index >> 3) & 1) << 1 | (address.base >> 3));
+      *p++ = 0x0F;
+      *p++ = 0x18;
+      p = writeMem(p, uint8_t(hint & 3), address);
+      self().commit(p);
+      return true;
+    }
+  VPU_CONSTEXPR14 bool prefetcht0(Reg address, int32_t disp)
+    { return prefetch(address, disp, kPrefetchT0); }
+  VPU_CONSTEXPR14 bool prefetcht0(Mem address)
+    { return prefetch(address, kPrefetchT0); }
+  VPU_CONSTEXPR14 bool prefetcht1(Reg address, int32_t disp)
+    { return prefetch(address, disp, kPrefetchT1); }
+  VPU_CONSTEXPR14 bool prefetcht1(Mem address)
+    { return prefetch(address, kPrefetchT1); }
+  VPU_CONSTEXPR14 bool prefetcht2(Reg address, int32_t disp)
+    { return prefetch(address, disp, kPrefetchT2); }
+  VPU_CONSTEXPR14 bool prefetcht2(Mem address)
+    { return prefetch(address, kPrefetchT2); }
+  VPU_CONSTEXPR14 bool prefetchnta(Reg address, int32_t disp)
+    { return prefetch(address, disp, kPrefetchNTA); }
+  VPU_CONSTEXPR14 bool prefetchnta(Mem address)
+    { return prefetch(address, kPrefetchNTA); }
+
+  /// \name   Gathers
+
+  VPU_CONSTEXPR14 bool i32gatherps(AVXReg target, AVXReg indices, AVXReg mask, Reg address, uint32_t disp, uint8_t scale)
+    { return encodeGather(0x92, 0, 1, target, indices, mask, address, disp, scale); }
+  VPU_CONSTEXPR14 bool i32gatherps(AVXReg target, AVXReg indices, AVXReg mask, Mem address)
+    { return encodeGather(0x92, 0, 1, target, indices, mask, address); }
+  VPU_CONSTEXPR14 bool i64gatherps(AVXReg target, AVXReg indices, AVXReg mask, Reg address, uint32_t disp, uint8_t scale)
+    { return encodeGather(0x93, 0, 1, target, indices, mask, address, disp, scale); }
+  VPU_CONSTEXPR14 bool i64gatherps(AVXReg target, AVXReg indices, AVXReg mask, Mem address)
+    { return encodeGather(0x93, 0, 1, target, indices, mask, address); }
+  VPU_CONSTEXPR14 bool i32gatherpd(AVXReg target, AVXReg indices, AVXReg mask, Reg address, uint32_t disp, uint8_t scale)
+    { return encodeGather(0x92, 1, 1, target, indices, mask, address, disp, scale); }
+  VPU_CONSTEXPR14 bool i32gatherpd(AVXReg target, AVXReg indices, AVXReg mask, Mem address)
+    { return encodeGather(0x92, 1, 1, target, indices, mask, address); }
+  VPU_CONSTEXPR14 bool i64gatherpd(AVXReg target, AVXReg indices, AVXReg mask, Reg address, uint32_t disp, uint8_t scale)
+    { return encodeGather(0x93, 1, 0, target, indices, mask, address, disp, scale); }
+  VPU_CONSTEXPR14 bool i64gatherpd(AVXReg target, AVXReg indices, AVXReg mask, Mem address)
+    { return encodeGather(0x93, 1, 0, target, indices, mask, address); }
+
+protected:
+
+  VPU_CONSTEXPR14 Derived& self()
+    { return *static_cast<Derived*>(this); }
+
+  /// \brief  Called with every register operand of each instruction (and with the constants that fill unused operand
+  ///         fields), before the instruction is written. These do nothing, but the derived class may hide them to
+  ///         track register usage (see EmitterBase::function).
+  template<typename T>
+  VPU_CONSTEXPR14 void useRegister(T) {}
+
+  /// \brief  Called by each jcc, with the offset from the end of the jump, before the jump is written.
+  VPU_CONSTEXPR14 void useJump(int32_t) {}
+
+  /// \brief  Called once for each instruction, after the useRegister calls and before any of its bytes are written.
+  ///         This does nothing, but the derived class may hide it to record the instructions (see
+  ///         EmitterBase::setOptimisations). An instruction that wraps another describes itself first.
+  VPU_CONSTEXPR14 void useInstruction(const InstructionInfo&) {}
+
+  VPU_CONSTEXPR14 void describe(uint8_t form, uint8_t map, uint8_t pp, uint8_t op, uint8_t W, uint8_t L, uint8_t reg,
+                                uint8_t vvvv, uint8_t rm, int32_t disp, uint8_t index = 0, uint8_t scale = 0)
+    {
+      const InstructionInfo info = { form, map, pp, op, W, L, reg, vvvv, rm, index, scale, disp };
+      self().useInstruction(info);
+    }
+
+  VPU_CONSTEXPR14 static uint8_t* write32(uint8_t* p, uint32_t value)
+    {
+      p[0] = uint8_t(value);
+      p[1] = uint8_t(value >> 8);
+      p[2] = uint8_t(value >> 16);
+      p[3] = uint8_t(value >> 24);
+      return p + 4;
+    }
+
+  /// write num_bytes of NOPs, in as few instructions as possible (at most 9 bytes each)
+  VPU_CONSTEXPR14 static uint8_t* writeNops(uint8_t* p, uint32_t num_bytes)
+    {
+      for (; num_bytes > 2; )
+      {
+        // 0F 1F /0 (with a 66 prefix for the 6 & 9 byte forms)
+        const uint32_t n = num_bytes < 9 ? num_bytes : 9;
+        if (n == 6 || n == 9)
+          *p++ = 0x66;
+        *p++ = 0x0F;
+        *p++ = 0x1F;
+        switch (n)
+        {
+        case 3: *p++ = 0x00; break;
+        case 4: *p++ = 0x40; *p++ = 0x00; break;
+        case 5: case 6: *p++ = 0x44; *p++ = 0x00; *p++ = 0x00; break;
+        case 7: *p++ = 0x80; p = write32(p, 0); break;
+        default: *p++ = 0x84; *p++ = 0x00; p = write32(p, 0); break;
+        }
+        num_bytes -= n;
+      }
+      if (num_bytes == 2)
+        *p++ = 0x66;
+      if (num_bytes)
+        *p++ = 0x90;
+      return p;
+    }
+
+  VPU_CONSTEXPR14 void emit8(uint8_t a)
+    { uint8_t* p = self().reserve(1); p[0] = a; self().commit(p + 1); }
+  VPU_CONSTEXPR14 void emit2(uint8_t a, uint8_t b)
+    { uint8_t* p = self().reserve(2); p[0] = a; p[1] = b; self().commit(p + 2); }
+  VPU_CONSTEXPR14 void emit3(uint8_t a, uint8_t b, uint8_t c)
+    { uint8_t* p = self().reserve(3); p[0] = a; p[1] = b; p[2] = c; self().commit(p + 3); }
+
+  /// the immediate for shuffleps & permuteps
+  VPU_CONSTEXPR14 static uint8_t shuffleImm(uint8_t x, uint8_t y, uint8_t z, uint8_t w)
+    { return uint8_t((x & 3) | (y & 3) << 2 | (z & 3) << 4 | (w & 3) << 6); }
+
+  /// the immediate for permutepd
+  VPU_CONSTEXPR14 static uint8_t permutepdImm(uint8_t x, uint8_t y)
+    { return uint8_t((y & 1) << 1 | (x & 1)); }
+
+  /// the ModRM mod field for [base + disp].
+  VPU_CONSTEXPR14 static uint8_t modBits(int32_t disp)
+    { return disp == 0 ? 0x00 : (disp >= -128 && disp <= 127) ? 0x40 : 0x80; }
+
+  /// write the displacement that follows a ModRM byte
+  VPU_CONSTEXPR14 static uint8_t* writeDisp(uint8_t* p, uint8_t mod, int32_t disp)
+    {
+      if (mod == 0x40)
+        *p++ = uint8_t(disp);
+      else
+      if (mod == 0x80)
+        p = write32(p, disp);
+      return p;
+    }
+
+  /// VEX bits: inverted R, B, and vvvv
+  VPU_CONSTEXPR14 static uint8_t vexR(uint8_t reg)
+    { return (reg & 8) ? 0x00 : 0x80; }
+  VPU_CONSTEXPR14 static uint8_t vexB(uint8_t rm)
+    { return (rm & 8) ? 0x00 : 0x20; }
+  VPU_CONSTEXPR14 static uint8_t vexV(uint8_t vvvv)
+    { return uint8_t((~vvvv & 0xF) << 3); }
+
+  /// the SIB scale bits, or 1 if the scale isn't 1, 2, 4 or 8
+  VPU_CONSTEXPR14 static uint8_t scaleBits(uint8_t scale)
+    { return scale == 1 ? 0x00 : scale == 2 ? 0x40 : scale == 4 ? 0x80 : scale == 8 ? 0xC0 : 1; }
+
+  /// the scale of a memory operand recorded by describe (0 if there is no index register)
+  VPU_CONSTEXPR14 static uint8_t describedScale(Mem m)
+    { return m.index == RSP ? 0 : m.scale; }
+
+  /// the ModRM byte, SIB byte (if needed), and displacement of a memory operand
+  VPU_CONSTEXPR14 static uint8_t* writeMem(uint8_t* p, uint8_t reg, Mem m)
+    {
+      const uint8_t mod = (m.disp == 0 && (m.base & 7) == 5) ? 0x40 : modBits(m.disp);
+      if (m.index == RSP && (m.base & 7) != 4)
+        *p++ = uint8_t(mod | (reg & 7) << 3 | (m.base & 7));
+      else
+      {
+        *p++ = uint8_t(mod | (reg & 7) << 3 | 4);
+        *p++ = uint8_t((m.index == RSP ? 0 : scaleBits(m.scale)) | (m.index & 7) << 3 | (m.base & 7));
+      }
+      return writeDisp(p, mod, m.disp);
+    }
+
+  /// the VEX prefix of an instruction with a memory operand: the 2 byte form if map 0F, W0, and the low registers
+  /// allow it
+  VPU_CONSTEXPR14 static uint8_t* writeVex(uint8_t* p, uint8_t map, uint8_t pp, uint8_t W, uint8_t L, uint8_t reg,
+                                           uint8_t vvvv, uint8_t index, Reg base)
+    {
+      if (map == 1 && !W && !(index & 8) && !(base & 8))
+      {
+        *p++ = 0xC5;
+        *p++ = uint8_t(vexR(reg) | vexV(vvvv) | (L & 1) << 2 | (pp & 3));
+        return p;
+      }
+      *p++ = 0xC4;
+      *p++ = uint8_t(vexR(reg) | ((index & 8) ? 0x00 : 0x40) | vexB(base) | (map & 0x1F));
+      *p++ = uint8_t(W << 7 | vexV(vvvv) | (L & 1) << 2 | (pp & 3));
+      return p;
+    }
+
+  /// Map 0F, register operands. Uses the 2 byte VEX prefix unless vvvv or rm need the high registers.
+  /// (the 3 byte form always sets VEX.X, and never VEX.W)
+  template<typename R, typename V, typename M>
+  VPU_CONSTEXPR14 void encodeRR(uint8_t pp, uint8_t op, R reg, V vvvv, M rm, uint8_t L)
+    {
+      self().useRegister(reg);
+      self().useRegister(vvvv);
+      self().useRegister(rm);
+      describe(kFormRR, 1, pp, op, 0, L, reg, vvvv, rm, 0);
+      uint8_t* p = self().reserve(5);
+      if (vvvv < 8 && rm < 8)
+      {
+        *p++ = 0xC5;
+        *p++ = uint8_t(vexR(reg) | vexV(vvvv) | (L & 1) << 2 | (pp & 3));
+      }
+      else
+      {
+        *p++ = 0xC4;
+        *p++ = uint8_t(vexR(reg) | vexB(rm) | 0x01);
+        *p++ = uint8_t(vexV(vvvv) | (L & 1) << 2 | (pp & 3));
+      }
+      *p++ = op;
+      *p++ = uint8_t(0xC0 | (reg & 7) << 3 | (rm & 7));
+      self().commit(p);
+    }
+
+  /// Map 0F, memory operand [base + disp]. RBP & R13 always use a 32bit displacement.
+  template<typename R, typename V>
+  VPU_CONSTEXPR14 bool encodeRM(uint8_t pp, uint8_t op, R reg, V vvvv, Reg base, int32_t disp, uint8_t L)
+    {
+      self().useRegister(reg);
+      self().useRegister(vvvv);
+      self().useRegister(base);
+      if ((base & 7) == 4)
+        return false;
+      describe(kFormRM, 1, pp, op, 0, L, reg, vvvv, base, disp);
+      const uint8_t mod = (base & 7) == 5 ? 0x80 : modBits(disp);
+      uint8_t* p = self().reserve(10);
+      if (vvvv < 8 && base < 8)
+      {
+        *p++ = 0xC5;
+        *p++ = uint8_t(vexR(reg) | vexV(vvvv) | (L & 1) << 2 | (pp & 3));
+      }
+      else
+      {
+        *p++ = 0xC4;
+        *p++ = uint8_t(vexR(reg) | vexB(base) | 0x01);
+        *p++ = uint8_t(vexV(vvvv) | (L & 1) << 2 | (pp & 3));
+      }
+      *p++ = op;
+      *p++ = uint8_t(mod | (reg & 7) << 3 | (base & 7));
+      p = writeDisp(p, mod, disp);
+      self().commit(p);
+      return true;
+    }
+
+  /// Map 0F stores, [base + disp] = src. As with the DLL, this always uses the 2 byte VEX prefix, so the base register
+  /// cannot be R8 -> R15 (RBP & R13 always use a 32bit displacement).
+  template<typename S>
+  VPU_CONSTEXPR14 bool encodeMR(uint8_t pp, uint8_t op, Reg base, S src, int32_t disp, uint8_t L)
+    {
+      self().useRegister(base);
+      self().useRegister(src);
+      if ((base & 7) == 4)
+        return false;
+      describe(kFormMR, 1, pp, op, 0, L, src, 0, base, disp);
+      const uint8_t mod = (base & 7) == 5 ? 0x80 : modBits(disp);
+      uint8_t* p = self().reserve(9);
+      *p++ = 0xC5;
+      *p++ = uint8_t(vexR(src) | 0x78 | (L & 1) << 2 | (pp & 3));
+      *p++ = op;
+      *p++ = uint8_t(mod | (src & 7) << 3 | (base & 7));
+      p = writeDisp(p, mod, disp);
+      self().commit(p);
+      return true;
+    }
+
+  /// 3 byte VEX prefix, register operands
+  template<typename R, typename V, typename M>
+  VPU_CONSTEXPR14 void encodeRR3(uint8_t pp, uint8_t op, R reg, V vvvv, M rm, uint8_t W, uint8_t L, uint8_t map)
+    {
+      self().useRegister(reg);
+      self().useRegister(vvvv);
+      self().useRegister(rm);
+      describe(kFormRR, map, pp, op, W, L, reg, vvvv, rm, 0);
+      uint8_t* p = self().reserve(5);
+      *p++ = 0xC4;
+      *p++ = uint8_t(vexR(reg) | 0x40 | vexB(rm) | (map & 0x1F));
+      *p++ = uint8_t(W << 7 | vexV(vvvv) | (L & 1) << 2 | (pp & 3));
+      *p++ = op;
+      *p++ = uint8_t(0xC0 | (reg & 7) << 3 | (rm & 7));
+      self().commit(p);
+    }
+
+  /// 3 byte VEX prefix, memory operand [base + disp]
+  template<typename R, typename V>
+  VPU_CONSTEXPR14 bool encodeRM3(uint8_t pp, uint8_t op, R reg, V vvvv, Reg base, int32_t disp, uint8_t W, uint8_t L, uint8_t map)
+    {
+      self().useRegister(reg);
+      self().useRegister(vvvv);
+      self().useRegister(base);
+      if ((base & 7) == 4)
+        return false;
+      describe(kFormRM, map, pp, op, W, L, reg, vvvv, base, disp);
+      const uint8_t mod = (disp == 0 && (base & 7) == 5) ? 0x40 : modBits(disp);
+      uint8_t* p = self().reserve(10);
+      *p++ = 0xC4;
+      *p++ = uint8_t(vexR(reg) | 0x40 | vexB(base) | (map & 0x1F));
+      *p++ = uint8_t(W << 7 | vexV(vvvv) | (L & 1) << 2 | (pp & 3));
+      *p++ = op;
+      *p++ = uint8_t(mod | (reg & 7) << 3 | (base & 7));
+      p = writeDisp(p, mod, disp);
+      self().commit(p);
+      return true;
+    }
+
+  /// FMA (map 0F38, 256bit)
+  template<typename R, typename V, typename M>
+  VPU_CONSTEXPR14 void encodeFmaRR(uint8_t pp, uint8_t op, R reg, V vvvv, M rm, uint8_t W)
+    { encodeRR3(pp, op, reg, vvvv, rm, W, 1, 2); }
+  template<typename R, typename V>
+  VPU_CONSTEXPR14 bool encodeFmaRM(uint8_t pp, uint8_t op, R reg, V vvvv, Reg base, int32_t disp, uint8_t W)
+    { return encodeRM3(pp, op, reg, vvvv, base, disp, W, 1, 2); }
+
+  /// blendv (map 0F3A, 256bit), where the 4th register is stored in the top bits of an immediate.
+  template<typename R, typename V, typename M>
+  VPU_CONSTEXPR14 void encodeBlendRR(uint8_t pp, uint8_t op, R reg, V vvvv, M rm, AVXReg is4, uint8_t W)
+    {
+      self().useRegister(is4);
+      describe(kFormOther, 3, pp, op, W, 1, reg, vvvv, rm, 0);
+      encodeRR3(pp, op, reg, vvvv, rm, W, 1, 3);
+      emit8(uint8_t(is4 << 4));
+    }
+
+  /// \note   unlike the other memory forms, RBP & R13 with a zero displacement are not special cased (just like the DLL)
+  template<typename R, typename V>
+  VPU_CONSTEXPR14 bool encodeBlendRM(uint8_t pp, uint8_t op, R reg, V vvvv, Reg base, int32_t disp, AVXReg is4, uint8_t W)
+    {
+      self().useRegister(reg);
+      self().useRegister(vvvv);
+      self().useRegister(base);
+      self().useRegister(is4);
+      if ((base & 7) == 4)
+        return false;
+      describe(kFormOther, 3, pp, op, W, 1, reg, vvvv, base, disp);
+      const uint8_t mod = modBits(disp);
+      uint8_t* p = self().reserve(11);
+      *p++ = 0xC4;
+      *p++ = uint8_t(vexR(reg) | 0x40 | vexB(base) | 0x03);
+      *p++ = uint8_t(W << 7 | vexV(vvvv) | 0x04 | (pp & 3));
+      *p++ = op;
+      *p++ = uint8_t(mod | (reg & 7) << 3 | (base & 7));
+      p = writeDisp(p, mod, disp);
+      *p++ = uint8_t(is4 << 4);
+      self().commit(p);
+      return true;
+    }
+
+  /// VSIB addressing, [base + indices * scale + disp].
+  VPU_CONSTEXPR14 bool encodeGather(uint8_t op, uint8_t W, uint8_t L, AVXReg reg, AVXReg indices, AVXReg mask, Reg base, int32_t disp, uint8_t scale)
+    {
+      self().useRegister(reg);
+      self().useRegister(indices);
+      self().useRegister(mask);
+      self().useRegister(base);
+      uint8_t ss = 0;
+      switch (scale)
+      {
+      case 1: ss = 0x00; break;
+      case 2: ss = 0x40; break;
+      case 4: ss = 0x80; break;
+      case 8: ss = 0xC0; break;
+      default: return false;
+      }
+      describe(kFormGather, 2, 1, op, W, L, reg, mask, base, disp, indices);
+      const uint8_t mod = (disp == 0 && (base & 7) == 5) ? 0x40 : modBits(disp);
+      uint8_t* p = self().reserve(11);
+      *p++ = 0xC4;
+      *p++ = uint8_t(vexR(reg) | 0x40 | vexB(base) | 0x02);
+      *p++ = uint8_t(W << 7 | vexV(mask) | (L & 1) << 2 | 0x01);
+      *p++ = op;
+      *p++ = uint8_t(mod | (reg & 7) << 3 | 4);
+      *p++ = uint8_t(ss | (indices & 7) << 3 | (base & 7));
+      p = writeDisp(p, mod, disp);
+      self().commit(p);
+      return true;
+    }
+
+  /// REX.W + op, [rm + disp].
+  /// \note   the DLL rejects RSP and R12 as the register operand (rather than the base), so this does too
+  VPU_CONSTEXPR14 void encodeGpr(uint8_t op, Reg rm, Reg reg, int32_t disp)
+    {
+      self().useRegister(rm);
+      self().useRegister(reg);
+      if ((reg & 7) == 4)
+        return;
+      describe(kFormGpr, 0, 0, op, 1, 0, reg, 0, rm, disp);
+      const uint8_t mod = (disp == 0 && (rm & 7) == 5) ? 0x40 : modBits(disp);
+      uint8_t* p = self().reserve(8);
+      *p++ = uint8_t(0x48 | (reg >> 3) << 2 | (rm >> 3));
+      *p++ = op;
+      *p++ = uint8_t(mod | (reg & 7) << 3 | (rm & 7));
+      if ((rm & 7) == 4)
+        *p++ = 0x24;
+      p = writeDisp(p, mod, disp);
+      self().commit(p);
+    }
+
+  /// VEX, any map, memory operand [base + index * scale + disp] (form is kFormRM, kFormMR for a store, or kFormOther)
+  template<typename R, typename V>
+  VPU_CONSTEXPR14 bool encodeMem(uint8_t form, uint8_t map, uint8_t pp, uint8_t op, R reg, V vvvv, Mem m, uint8_t W,
+                                 uint8_t L)
+    {
+      self().useRegister(reg);
+      self().useRegister(vvvv);
+      self().useRegister(m.base);
+      if (m.index != RSP)
+        self().useRegister(m.index);
+      if (m.index != RSP && scaleBits(m.scale) == 1)
+        return false;
+      describe(form, map, pp, op, W, L, reg, vvvv, m.base, m.disp, m.index == RSP ? 0 : m.index, describedScale(m));
+      uint8_t* p = self().reserve(11);
+      p = writeVex(p, map, pp, W, L, reg, vvvv, m.index, m.base);
+      *p++ = op;
+      p = writeMem(p, reg, m);
+      self().commit(p);
+      return true;
+    }
+
+  /// the same as those above, with a Mem in place of the base & displacement
+  template<typename R, typename V>
+  VPU_CONSTEXPR14 bool encodeRM(uint8_t pp, uint8_t op, R reg, V vvvv, Mem m, uint8_t L)
+    { return encodeMem(kFormRM, 1, pp, op, reg, vvvv, m, 0, L); }
+  template<typename S>
+  VPU_CONSTEXPR14 bool encodeMR(uint8_t pp, uint8_t op, Mem m, S src, uint8_t L)
+    { return encodeMem(kFormMR, 1, pp, op, src, 0, m, 0, L); }
+  template<typename R, typename V>
+  VPU_CONSTEXPR14 bool encodeRM3(uint8_t pp, uint8_t op, R reg, V vvvv, Mem m, uint8_t W, uint8_t L, uint8_t map)
+    { return encodeMem(kFormRM, map, pp, op, reg, vvvv, m, W, L); }
+  template<typename R, typename V>
+  VPU_CONSTEXPR14 bool encodeFmaRM(uint8_t pp, uint8_t op, R reg, V vvvv, Mem m, uint8_t W)
+    { return encodeMem(kFormRM, 2, pp, op, reg, vvvv, m, W, 1); }
+  template<typename R, typename V>
+  VPU_CONSTEXPR14 bool encodeBlendRM(uint8_t pp, uint8_t op, R reg, V vvvv, Mem m, AVXReg is4, uint8_t W)
+    {
+      self().useRegister(is4);
+      if (!encodeMem(kFormOther, 3, pp, op, reg, vvvv, m, W, 1))
+        return false;
+      emit8(uint8_t(is4 << 4));
+      return true;
+    }
+
+  /// vmaskmovps etc [m], mask, src: VEX.256.66.0F38, with the mask in vvvv
+  VPU_CONSTEXPR14 bool encodeMaskStore(uint8_t op, uint8_t W, Mem m, AVXReg mask, AVXReg src)
+    { return encodeMem(kFormMR, 2, 1, op, src, mask, m, W, 1); }
+  VPU_CONSTEXPR14 bool encodeMaskStore(uint8_t op, uint8_t W, Reg base, int32_t disp, AVXReg mask, AVXReg src)
+    {
+      const Mem m = { base, RSP, 1, disp };
+      if ((base & 7) == 4)
+      {
+        self().useRegister(base);
+        self().useRegister(mask);
+        self().useRegister(src);
+        return false;
+      }
+      return encodeMaskStore(op, W, m, mask, src);
+    }
+
+  /// VSIB addressing, [m.base + indices * m.scale + m.disp] (m.index must be RSP)
+  VPU_CONSTEXPR14 bool encodeGather(uint8_t op, uint8_t W, uint8_t L, AVXReg reg, AVXReg indices, AVXReg mask, Mem m)
+    {
+      self().useRegister(reg);
+      self().useRegister(indices);
+      self().useRegister(mask);
+      self().useRegister(m.base);
+      if (m.index != RSP || scaleBits(m.scale) == 1)
+        return false;
+      describe(kFormGather, 2, 1, op, W, L, reg, mask, m.base, m.disp, indices);
+      const uint8_t mod = (m.disp == 0 && (m.base & 7) == 5) ? 0x40 : modBits(m.disp);
+      uint8_t* p = self().reserve(11);
+      p = writeVex(p, 2, 1, W, L, reg, mask, indices, m.base);
+      *p++ = op;
+      *p++ = uint8_t(mod | (reg & 7) << 3 | 4);
+      *p++ = uint8_t(scaleBits(m.scale) | (indices & 7) << 3 | (m.base & 7));
+      p = writeDisp(p, mod, m.disp);
+      self().commit(p);
+      return true;
+    }
+
+  /// REX.W + op (0F op if map is 1), [base + index * scale + disp]
+  VPU_CONSTEXPR14 bool encodeGpr(uint8_t op, Mem m, Reg reg, uint8_t map = 0)
+    {
+      self().useRegister(m.base);
+      if (m.index != RSP)
+        self().useRegister(m.index);
+      self().useRegister(reg);
+      if (m.index != RSP && scaleBits(m.scale) == 1)
+        return false;
+      describe(kFormGpr, map, 0, op, 1, 0, reg, 0, m.base, m.disp, m.index == RSP ? 0 : m.index, describedScale(m));
+      uint8_t* p = self().reserve(10);
+      *p++ = uint8_t(0x48 | (reg >> 3) << 2 | ((m.index >> 3) & 1) << 1 | (m.base >> 3));
+      if (map)
+        *p++ = 0x0F;
+      *p++ = op;
+      p = writeMem(p, reg, m);
+      self().commit(p);
+      return true;
+    }
+
+  /// REX.W + 83 /digit ib, or REX.W + 81 /digit id
+  VPU_CONSTEXPR14 void encodeImm(uint8_t digit, Reg r, int32_t immediate)
+    {
+      self().useRegister(r);
+      describe(kFormImm, 0, 0, digit, 1, 0, 0, 0, r, immediate);
+      const bool imm8 = immediate >= -128 && immediate <= 127;
+      uint8_t* p = self().reserve(7);
+      *p++ = r < 8 ? 0x48 : 0x49;
+      *p++ = imm8 ? 0x83 : 0x81;
+      *p++ = uint8_t(0xC0 | digit << 3 | (r & 7));
+      if (imm8)
+        *p++ = uint8_t(immediate);
+      else
+        p = write32(p, immediate);
+      self().commit(p);
+    }
+
+  /// REX.W + op (0F op if map is 1), reg, rm, followed by the immediate of imul (op 0x6B or 0x69)
+  VPU_CONSTEXPR14 void encodeGprRR(uint8_t map, uint8_t op, Reg reg, Reg rm, int32_t immediate = 0)
+    {
+      self().useRegister(reg);
+      self().useRegister(rm);
+      describe(kFormGprRR, map, 0, op, 1, 0, reg, 0, rm, immediate);
+      uint8_t* p = self().reserve(9);
+      *p++ = uint8_t(0x48 | (reg >> 3) << 2 | (rm >> 3));
+      if (map)
+        *p++ = 0x0F;
+      *p++ = op;
+      *p++ = uint8_t(0xC0 | (reg & 7) << 3 | (rm & 7));
+      if (op == 0x6B)
+        *p++ = uint8_t(immediate);
+      else
+      if (op == 0x69)
+        p = write32(p, immediate);
+      self().commit(p);
+    }
+
+  /// REX.W + D1 /digit (a shift by 1), C1 /digit ib, or D3 /digit (a shift by CL)
+  VPU_CONSTEXPR14 void encodeShift(uint8_t digit, Reg r, uint8_t count)
+    { encodeUnary(0, (count & 63) == 1 ? 0xD1 : 0xC1, digit, r, count & 63); }
+  VPU_CONSTEXPR14 bool encodeShift(uint8_t digit, Reg r, Reg count)
+    {
+      self().useRegister(count);
+      if (count != RCX)
+        return false;
+      encodeUnary(0, 0xD3, digit, r);
+      return true;
+    }
+
+  /// REX.W + op /digit rm, followed by the shift count (op 0xC1) or the immediate of test (op 0xF7 /0). setcc (0F op)
+  /// writes a byte register, so has a REX prefix (without REX.W) for SPL, BPL, SIL & DIL, which would otherwise be AH,
+  /// CH, DH & BH.
+  VPU_CONSTEXPR14 void encodeUnary(uint8_t map, uint8_t op, uint8_t digit, Reg r, int32_t immediate = 0)
+    {
+      self().useRegister(r);
+      describe(kFormGprUnary, map, 0, op, map ? 0 : 1, 0, digit, 0, r, immediate);
+      uint8_t* p = self().reserve(8);
+      if (!map || r >= 4)
+        *p++ = uint8_t((map ? 0x40 : 0x48) | (r >> 3));
+      if (map)
+        *p++ = 0x0F;
+      *p++ = op;
+      *p++ = uint8_t(0xC0 | digit << 3 | (r & 7));
+      if (op == 0xC1)
+        *p++ = uint8_t(immediate);
+      else
+      if (op == 0xF7 && digit == 0)
+        p = write32(p, immediate);
+      self().commit(p);
+    }
+
+  /// jcc rel8, or jcc rel32
+  VPU_CONSTEXPR14 void jump(uint8_t cc, int32_t offset)
+    {
+      self().useJump(offset);
+      describe(kFormJump, 0, 0, cc, 0, 0, 0, 0, 0, offset);
+      uint8_t* p = self().reserve(6);
+      if (offset >= -128 && offset <= 127)
+      {
+        *p++ = uint8_t(0x70 | cc);
+        *p++ = uint8_t(offset);
+      }
+      else
+      {
+        *p++ = 0x0F;
+        *p++ = uint8_t(0x80 | cc);
+        p = write32(p, offset);
+      }
+      self().commit(p);
+    }
+
+  /// the offset passed to jump() by the jump_xx_to methods.
+  /// \note   the DLL assumes a forward jump is always short, so forward jumps of more than 127 bytes land 4 bytes early.
+  VPU_CONSTEXPR14 int32_t jumpOffset(uint32_t location)
+    {
+      const int32_t offset = int32_t(location - uint32_t(self().numBytes()));
+      return offset >= -126 ? offset - 2 : offset - 6;
+    }
+};
+
+/// \brief  A label (or procedure) created by EmitterBase::new_label()
+struct LabelId
+{
+  uint32_t index;
+};
+
+/// \brief  A function within an IFunctionTable. The offset is the value returned from IFunctionTable::funcInfo (the
+///         byte offset of the function pointer within the table), which doesn't change once the function is added.
+struct FunctionHandle
+{
+  int32_t offset;     ///< -1 if the function was not found
+  FunctionType type;
+};
+
+/// \brief  look up a function once, so that it can be called repeatedly without a lookup by name
+inline FunctionHandle findFunction(const IFunctionTable* table, const char* name)
+{
+  FunctionHandle fn = { -1, kNoArgs };
+  if (table)
+    fn.offset = table->funcInfo(name, fn.type);
+  return fn;
+}
+
+/// \brief  the address of a function, given the raw function table (see resolveFunctionTable in lib_asm_arena.h)
+inline const void* functionAddress(void* const* functions, FunctionHandle fn)
+{
+  return fn.offset == -1 ? 0 : functions[fn.offset / sizeof(void*)];
+}
+
+/// \brief  Resolves virtual registers to the registers they have been allocated (implemented by EmitterBase)
+class VirtualRegisters
+{
+public:
+  virtual AVXReg ymm(uint32_t index) = 0;
+  virtual Reg gpr(uint32_t index) = 0;
+protected:
+  ~VirtualRegisters() {}
+};
+
+/// \brief  A virtual YMM register, created by EmitterBase::new_ymm() within function(). It converts to the AVXReg it
+///         has been allocated, so can be passed to any instruction method in place of an AVXReg.
+struct VReg
+{
+  VirtualRegisters* owner;
+  uint32_t index;
+  inline operator AVXReg() const
+    { return owner->ymm(index); }
+};
+
+/// \brief  A virtual general purpose register, created by EmitterBase::new_gpr() within function(). It converts to the
+///         Reg it has been allocated, so can be passed to any instruction method in place of a Reg.
+struct VGpr
+{
+  VirtualRegisters* owner;
+  uint32_t index;
+  inline operator Reg() const
+    { return owner->gpr(index); }
+};
+
+/// \brief  Optional passes over the code, performed by EmitterBase::end() (see EmitterBase::setOptimisations)
+enum Optimisation
+{
+  kRemoveNops = 1 << 0,             ///< removes lea r, [r + 0], mov r, r, and add/sub r, 0 (when the flags are unused)
+  kForwardStores = 1 << 1,          ///< a load from the location that was just stored to becomes a register move
+  kRemoveRedundantMoves = 1 << 2,   ///< removes movaps x, x, and movaps t, s when the next op overwrites t (reading s
+                                    ///  in place of t)
+  kFuseMultiplyAdd = 1 << 3,        ///< fuses mulps + addps (and mulpd + addpd) into an FMA, which rounds once rather
+                                    ///  than twice, so may change the results slightly (which is why kPeephole doesn't)
+  kSchedule = 1 << 4,               ///< reorders runs of independent AVX instructions, so that the long latency ones
+                                    ///  (divides, square roots, gathers) overlap (see Microarchitecture)
+  kRelaxBranches = 1 << 5,          ///< every jump (to a label, or an offset) uses a jcc rel8 if its target is in reach
+  kAlignLoops = 1 << 6,             ///< pads the start of each loop, and each procedure, to a 32 byte boundary
+  kAlignJumps = 1 << 7,             ///< pads before each jcc (and the cmp, add, sub, and, inc or dec it fuses
+                                    ///  with), so that it doesn't cross or end on a 32 byte boundary (which avoids
+                                    ///  the microcode update for the Skylake JCC erratum)
+  kPeephole = kRemoveNops | kForwardStores | kRemoveRedundantMoves
+};
+
+/// \brief  The processors kSchedule has latencies for. The timings are approximate (256bit forms, from the published
+///         instruction tables), and only need to be good enough to rank one order of the code against another.
+enum Microarchitecture
+{
+  kHaswell,       ///< Intel Haswell & Broadwell
+  kSkylake,       ///< Intel Skylake and its derivatives (Kaby Lake, Coffee Lake, etc)
+  kZen2           ///< AMD Zen 2
+};
+
+/// \brief  What the peephole passes did during EmitterBase::end()
+struct PeepholeStats
+{
+  uint32_t numInstructions;     ///< before the passes
+  uint32_t nopsRemoved;
+  uint32_t loadsForwarded;      ///< loads replaced by a register move (or removed, if the register still holds the value)
+  uint32_t movesRemoved;
+  uint32_t multiplyAddsFused;   ///< each removes a mulps
+  uint32_t numRemoved;          ///< the instructions removed by all of the passes
+  uint32_t jumpsShortened;      ///< jcc rel32 that became a jcc rel8
+  uint32_t paddingBytes;        ///< the NOPs written by align(), kAlignLoops, and kAlignJumps
+};
+
+/// \brief  What the scheduler did during EmitterBase::end()
+struct ScheduleStats
+{
+  uint32_t numBlocks;           ///< runs of (two or more) instructions the scheduler could reorder
+  uint32_t numReordered;        ///< the blocks that were reordered
+  uint32_t cyclesBefore;        ///< the estimated cycles to execute all of the blocks once, as written
+  uint32_t cyclesAfter;         ///< ... and once scheduled
+};
+
+/// \brief  Constants shared by every kernel assembled with the pool (see EmitterBase::setConstantPool), rather than
+///         stored after the code of each one. Each value is only stored once, aligned to its size (32 bytes for a whole
+///         YMM register), so that no load of it splits a cache line. The memory must be readable by the kernels, and
+///         within 2GB of them, e.g. a block reserved from the same CodeArena (see CodeArena::reserve). Constants are
+///         never removed, so the pool must outlive the kernels that use it.
+class ConstantPool
+{
+public:
+
+  /// \brief  ctor
+  /// \param  memory the memory the kernels read the constants from (32 byte aligned)
+  /// \param  writable the same memory, viewed through a writable mapping (the same as memory, unless it is mapped twice)
+  /// \param  num_bytes the size of the memory
+  inline ConstantPool(const void* memory, void* writable, size_t num_bytes)
+    : m_memory(static_cast<const uint8_t*>(memory)), m_writable(static_cast<uint8_t*>(writable)),
+      m_capacity(num_bytes & ~size_t(31)), m_used(0), m_small(0), m_smallEnd(0) {}
+
+  /// \brief  adds a constant to the pool, unless the same value is already there
+  /// \param  value the bytes of the constant
+  /// \param  num_bytes 4, 8 (for a constant that is broadcast), or 32
+  /// \return the address of the constant, or null if the pool is full
+  inline const void* add(const void* value, uint32_t num_bytes)
+    {
+      if (num_bytes != 4 && num_bytes != 8 && num_bytes != 32)
+        return 0;
+      const std::string key(static_cast<const char*>(value), num_bytes);
+      const Offsets::const_iterator it = m_offsets.find(key);
+      if (it != m_offsets.end())
+        return m_memory + it->second;
+      if (num_bytes < 32)
+      {
+        // 4 & 8 byte constants are packed into 32 byte blocks of their own
+        m_small = (m_small + num_bytes - 1) & ~size_t(num_bytes - 1);
+        if (m_small + num_bytes > m_smallEnd)
+        {
+          if (m_used + 32 > m_capacity)
+            return 0;
+          m_small = m_used;
+          m_smallEnd = m_used += 32;
+        }
+      }
+      else
+      if (m_used + 32 > m_capacity)
+        return 0;
+      const size_t offset = num_bytes < 32 ? m_small : m_used;
+      if (num_bytes < 32)
+        m_small += num_bytes;
+      else
+        m_used += 32;
+      memcpy(m_writable + offset, value, num_bytes);
+      m_offsets.insert(Offsets::value_type(key, offset));
+      return m_memory + offset;
+    }
+
+  /// \brief  the number of different constants in the pool
+  inline size_t numConstants() const
+    { return m_offsets.size(); }
+
+  /// \brief  the bytes of the pool that have been used
+  inline size_t numBytes() const
+    { return m_used; }
+
+  /// \brief  the size of the pool
+  inline size_t capacity() const
+    { return m_capacity; }
+
+private:
+
+  typedef std::unordered_map<std::string, size_t> Offsets;
+
+  const uint8_t* m_memory;
+  uint8_t* m_writable;
+  size_t m_capacity;
+  size_t m_used;            ///< whole 32 byte blocks
+  size_t m_small;           ///< the next free byte of the block the 4 & 8 byte constants are packed into
+  size_t m_smallEnd;
+  Offsets m_offsets;        ///< the offset of each value
+};
+
+/// \brief  Adds constants, labels, procedures, and function calls to EncoderBase. These are resolved by end(), so in
+///         addition to the EncoderBase requirements, the derived class must provide:
+/// \code
+/// void rewind();                        // discard all code
+/// uint8_t* bytecode();                  // the start of the code
+/// bool overflowed() const;              // true if some of the code was discarded
+/// \endcode
+template<typename Derived>
+class EmitterBase : public EncoderBase<Derived>, private VirtualRegisters
+{
+public:
+
+  /// \brief  ctor
+  /// \param  convention the calling convention of the generated code (only affects call())
+  inline EmitterBase(CallingConvention convention = kWin64)
+    : m_runtimeAddress(0), m_convention(convention), m_numVirtuals(0), m_numGprScratch(0), m_numYmmScratch(0),
+      m_numPending(0), m_pendingEnd(0), m_optimisations(0), m_target(kSkylake), m_zeroUpper(false),
+      m_upperDirty(false), m_upperUsed(false), m_inProcedure(false), m_pool(0), m_broadcast(false),
+      m_unlinked(false), m_prefetchDistance(0), m_prefetchHint(kPrefetchT0)
+    {
+      m_frame.mode = kFrameOff;
+      memset(&m_peepholeStats, 0, sizeof(m_peepholeStats));
+      memset(&m_scheduleStats, 0, sizeof(m_scheduleStats));
+    }
+
+  /// \name   General Usage
+
+  /// \brief  resets the emitter to take new input. Any previous code, constants, or labels will be lost
+  inline void begin()
+    {
+      self().rewind();
+      m_constants.clear();
+      m_constantRefs.clear();
+      m_labelLocations.clear();
+      m_labelRefs.clear();
+      m_labelNames.clear();
+      m_procedureNames.clear();
+      m_instructions.clear();
+      m_procedures.clear();
+      m_zeroUppers.clear();
+      m_poolConstants.clear();
+      m_poolRefs.clear();
+      m_unlinked = false;
+      m_upperDirty = false;
+      m_upperUsed = false;
+      m_inProcedure = false;
+    }
+
+  /// \brief  runs the optimisation passes (if any), then appends the constants to the code, and resolves any references
+  ///         to constants, labels, and procedures
+  inline void end()
+    {
+      memset(&m_peepholeStats, 0, sizeof(m_peepholeStats));
+      memset(&m_scheduleStats, 0, sizeof(m_scheduleStats));
+      if (m_optimisations)
+        optimise();
+      m_instructions.clear();
+      uint32_t code_size = 0;
+      if (!m_constants.empty())
+      {
+        // constants start on the next 32byte boundary after the code
+        while (self().numBytes() & 31)
+          emit8(0);
+        code_size = uint32_t(self().numBytes());
+        for (size_t i = 0; i < m_constants.size(); ++i)
+        {
+          uint8_t* p = self().reserve(32);
+          memcpy(p, m_constants[i].bytes, 32);
+          self().commit(p + 32);
+        }
+      }
+      for (size_t i = 0; i < m_constantRefs.size(); ++i)
+      {
+        const ConstantRef& ref = m_constantRefs[i];
+        if (ref.index & kPoolConstant)
+        {
+          // until the code is linked, the displacement is a sentinel: negative, so that unlinked code reads from 1-2GB
+          // before itself (which is rarely mapped) rather than near by, and holding the low bits of the address of
+          // the constant, so that code using different constants never looks the same to a KernelCache
+          m_poolRefs.push_back(ref);
+          m_unlinked = true;
+          patch32(ref.offset - 4, uint32_t(uintptr_t(m_poolConstants[ref.index & ~kPoolConstant].address)) | 0x80000000u);
+        }
+        else
+          patch32(ref.offset - 4, code_size + 32 * ref.index - ref.offset);
+      }
+      m_constants.clear();
+      m_constantRefs.clear();
+      if (m_runtimeAddress)
+        linkConstants(self().bytecode(), m_runtimeAddress);
+      for (size_t i = 0; i < m_labelRefs.size(); ++i)
+      {
+        const LabelRef& ref = m_labelRefs[i];
+        patch32(ref.offset, m_labelLocations[ref.label] - ref.offset - 4);
+      }
+      m_labelRefs.clear();
+      m_labelLocations.clear();
+      m_labelNames.clear();
+      m_procedureNames.clear();
+    }
+
+  /// \brief  call a function from the function table (see IAssembler::call)
+  /// \param  avx_target true if the function is compiled for AVX (see setZeroUpper)
+  inline bool call(const char* name, const IFunctionTable* func_map, bool avx_target = false)
+    { return call(findFunction(func_map, name), avx_target); }
+
+  /// \brief  call a function from the function table, without looking it up by name.
+  /// \param  fn the function, from findFunction()
+  /// \param  avx_target true if the function is compiled for AVX (see setZeroUpper)
+  /// \return false if the handle is invalid
+  inline bool call(FunctionHandle fn, bool avx_target = false)
+    {
+      if (fn.offset == -1)
+        return false;
+      // call [table + offset]
+      const Reg table_reg = argumentRegister(m_convention, 1);
+      beginCall(callStackSpace(m_convention, fn.type), table_reg);
+      if (!avx_target && !numArguments(fn.type))
+        zeroUpperIfDirty();
+      const uint8_t table = table_reg & 7;
+      describe(kFormOther, 0, 0, 0xFF, 1, 0, 2, 0, table_reg, fn.offset);
+      uint8_t* p = self().reserve(6);
+      *p++ = 0xFF;
+      if (fn.offset == 0)
+      {
+        *p++ = 0x10 | table;
+      }
+      else
+      if (fn.offset >= -128 && fn.offset <= 127)
+      {
+        *p++ = 0x50 | table;
+        *p++ = uint8_t(fn.offset);
+      }
+      else
+      {
+        *p++ = 0x90 | table;
+        p = write32(p, fn.offset);
+      }
+      self().commit(p);
+      endCall();
+      return true;
+    }
+
+  /// \brief  call a function directly, rather than through the function table (so the table register need not hold
+  ///         the table). If the code's runtime address is known (see setRuntimeAddress), and the function is within
+  ///         2GB of it, this is a call rel32. Otherwise the address is loaded into RAX (which is not preserved by a
+  ///         call in any case) and called from there.
+  /// \note   The address of the function is baked into the code, so kernels that use this cannot be saved to a
+  ///         DiskCache.
+  /// \param  fn the address of the function (e.g. from functionAddress())
+  /// \param  type the arguments the function takes (used within function(), to size the stack space for the call, and
+  ///         by setZeroUpper)
+  /// \param  avx_target true if the function is compiled for AVX (see setZeroUpper)
+  inline void call_direct(const void* fn, FunctionType type = kFiveArgs, bool avx_target = false)
+    {
+      beginCall(callStackSpace(m_convention, type), RSP);
+      if (!avx_target && !numArguments(type))
+        zeroUpperIfDirty();
+      const intptr_t next = intptr_t(m_runtimeAddress) + intptr_t(self().numBytes()) + 5;
+      const intptr_t rel = intptr_t(fn) - next;
+      const bool relative = m_runtimeAddress && rel >= INT32_MIN && rel <= INT32_MAX;
+      describe(kFormOther, 0, 0, relative ? 0xE8 : 0xFF, 1, 0, 2, 0, RAX, 0);
+      uint8_t* p = self().reserve(12);
+      if (relative)
+      {
+        *p++ = 0xE8;
+        p = write32(p, uint32_t(rel));
+        self().commit(p);
+        endCall();
+        return;
+      }
+      // mov rax, imm64
+      const uint64_t address = uint64_t(uintptr_t(fn));
+      *p++ = 0x48;
+      *p++ = 0xB8;
+      p = write32(p, uint32_t(address));
+      p = write32(p, uint32_t(address >> 32));
+      // call rax
+      *p++ = 0xFF;
+      *p++ = 0xD0;
+      self().commit(p);
+      endCall();
+    }
+
+  /// \brief  set the address the first byte of code will be executed from, which allows call_direct to use relative
+  ///         calls. This is only useful if the code is assembled in place (e.g. into the writable view of executable
+  ///         memory), rather than being copied elsewhere once assembled.
+  inline void setRuntimeAddress(const void* address)
+    { m_runtimeAddress = address; }
+
+  /// \brief  Once a 256bit instruction has been executed, the upper halves of the YMM registers are 'dirty' until the
+  ///         next vzeroupper. Returning to C++ compiled for SSE (or calling a function that is) in that state costs
+  ///         either a state transition of tens of cycles, or a false dependency on the upper halves for every SSE
+  ///         instruction. With setZeroUpper(true), the emitter tracks the state as the code is emitted, and inserts a
+  ///         zeroupper() before each ret(), and each call() or call_direct() of a function with no __m256 arguments
+  ///         (the arguments are passed in YMM0 -> YMM4, so they can't be zeroed), while the upper halves are dirty.
+  ///         Neither calling convention preserves the upper halves across a call, so this doesn't change what any
+  ///         correct code computes. Pass avx_target = true to call() to skip the vzeroupper for a function that is
+  ///         compiled for AVX.
+  /// \note   The state is followed through labels (a label bound after any 256bit instruction is assumed to be
+  ///         dirty), but not through jumps to an offset. The ret() of a procedure returns to code that may still be
+  ///         using the upper halves, so every ret() after the first procedure is bound (or before it, if it is called
+  ///         after being bound) is left alone. Code that returns an __m256 in YMM0 should not use this.
+  /// \param  enabled false by default, so that the code is the same as the DLL's
+  inline void setZeroUpper(bool enabled)
+    { m_zeroUpper = enabled; }
+
+  /// \brief  true if vzeroupper is inserted before ret() and calls (see setZeroUpper)
+  inline bool zeroUpper() const
+    { return m_zeroUpper; }
+
+  /// \brief  From now on, inserts a prefetch of [address + num_bytes] before each 256bit load (movaps, movups,
+  ///         movapd, movupd, movdqa or movdqu from memory into a YMM register) whose displacement is a multiple of 64,
+  ///         i.e. once per cache line of a 64 byte aligned array. Arithmetic with a memory operand, broadcasts,
+  ///         insertf128 etc don't trigger one, as they may read fewer than 32 bytes. A loop that steps a base register
+  ///         through an array then prefetches num_bytes ahead of itself. Loads from the stack (RSP or RBP) are left
+  ///         alone. Call it around the loop:
+  /// \code
+  /// e.setPrefetchDistance(1024, vpu::kPrefetchNTA);
+  ///   // ... the loop ...
+  /// e.setPrefetchDistance(0);
+  /// \endcode
+  /// \param  num_bytes how far ahead to prefetch (a few hundred to a few thousand bytes), or 0 to stop
+  inline void setPrefetchDistance(int32_t num_bytes, PrefetchHint hint = kPrefetchT0)
+    {
+      m_prefetchDistance = num_bytes;
+      m_prefetchHint = hint;
+    }
+
+  /// \brief  the distance passed to setPrefetchDistance
+  inline int32_t prefetchDistance() const
+    { return m_prefetchDistance; }
+
+  /// \name   Optimisation
+  /// \brief  By default, the code is emitted exactly as written. The Optimisation flags enable passes that end() runs
+  ///         over the instructions before the constants and labels are resolved, which tidy up the naive sequences a
+  ///         front end tends to produce:
+  /// \code
+  /// e.setOptimisations(vpu::kPeephole | vpu::kFuseMultiplyAdd);
+  /// e.begin();
+  ///   e.movaps(vpu::YMM1, vpu::YMM0);
+  ///   e.mulps(vpu::YMM1, vpu::YMM1, vpu::YMM2);    // vmulps ymm1, ymm0, ymm2 (the move is removed)
+  ///   e.addps(vpu::YMM3, vpu::YMM3, vpu::YMM1);    // fused into vfmadd231ps ymm3, ymm0, ymm2 (if YMM1 is dead)
+  ///   e.movaps(vpu::RCX, 0, vpu::YMM3);
+  ///   e.movaps(vpu::YMM4, vpu::RCX, 0);           // vmovaps ymm4, ymm3
+  ///   ...
+  /// e.end();
+  /// \endcode
+  ///         While any are enabled, each instruction is recorded as it is emitted (see InstructionInfo), and only
+  ///         pairs of adjacent instructions that always execute together (no label or jump lands between them) are
+  ///         combined. The code is then laid out again, and the labels, jumps, and constant references move with it.
+  ///         If the code jumps to an offset that isn't the start of an instruction, or uses a relative call_direct,
+  ///         the code is left as it is.
+  ///
+  ///         kSchedule runs last. It splits the code into blocks of AVX arithmetic, loads, stores, and gathers (any
+  ///         other instruction, or a label, ends a block), and list schedules each block for the target processor:
+  ///         the instruction that heads the longest chain of latencies goes first, so that independent chains are
+  ///         interleaved around the divides, square roots and gathers. A load is only moved past a store when both
+  ///         use the same base register, 32 or more bytes apart. The new order is kept only if it is estimated to be
+  ///         faster.
+  ///
+  ///         Jumps to labels are always emitted as a jcc rel32, since the label may not be bound yet. kRelaxBranches
+  ///         lays the code out again with every jump (including jump_xx_to) as short as its final distance allows.
+  ///
+  ///         kAlignLoops and kAlignJumps insert NOPs as the code is laid out (as does align(), which is kept on its
+  ///         boundary as the code around it moves). The offsets are from the start of the code, so it must run from a
+  ///         32 byte boundary (as kernels committed to a CodeArena do by default).
+
+  /// \brief  choose the optimisations performed by end()
+  /// \param  flags a combination of the Optimisation flags (0, the default, disables them all)
+  /// \param  target the processor to schedule for (only used by kSchedule)
+  inline void setOptimisations(uint32_t flags, Microarchitecture target = kSkylake)
+    {
+      m_optimisations = flags;
+      m_target = target;
+    }
+
+  /// \brief  the optimisations performed by end()
+  inline uint32_t optimisations() const
+    { return m_optimisations; }
+
+  /// \brief  the processor the code is scheduled for
+  inline Microarchitecture microarchitecture() const
+    { return m_target; }
+
+  /// \brief  what the peephole passes did during the last end()
+  inline const PeepholeStats& peepholeStats() const
+    { return m_peepholeStats; }
+
+  /// \brief  what the scheduler did during the last end()
+  inline const ScheduleStats& scheduleStats() const
+    { return m_scheduleStats; }
+
+  /// \name   Functions
+  /// \brief  function() assembles a complete function from a body that contains no prologue or epilogue:
+  /// \code
+  /// e.function([&](vpu::Emitter& e) {
+  ///   const int32_t temp = e.stack_slot(32);      // 32 bytes at [RBP + temp]
+  ///   e.movaps(vpu::YMM7, vpu::RCX, 0);
+  ///   e.movaps(vpu::RBP, temp, vpu::YMM7);
+  ///   e.call(pow_fn);                             // RCX, RDX & YMM7 are preserved across the call, if still needed
+  ///   e.ret();                                    // restores YMM7 (on Win64), and the stack
+  /// });
+  /// \endcode
+  /// The body is called twice. The first pass records which registers each instruction uses, the calls, the branches,
+  /// and the stack slots. The second pass emits:
+  /// - a prologue that saves the callee saved GPRs (and for kWin64, YMM6 -> YMMF) that the body uses, and reserves
+  ///   stack space for the slots, the register saves, and the largest callStackSpace() of any call. RSP is kept 16 byte
+  ///   aligned for the calls, and if the function needs any stack memory, RBP points to a 32 byte aligned frame.
+  ///   If the body uses no callee saved registers, stack slots or calls, there is no prologue at all.
+  /// - the body, where each ret() first restores the saved registers, and the stack (the epilogue).
+  /// - stores & reloads around each call() of the caller saved registers that are live across it. Only the lower
+  ///   halves of YMM6 -> YMMF survive a kWin64 call, so every YMM register other than YMM0 (the result) is treated
+  ///   as caller saved here. A register is live across a call if it is used both before and after it, or anywhere
+  ///   within a loop (a backward branch) around it.
+  /// The body may also use virtual registers (see new_ymm), which are allocated between the two passes.
+  /// \note   The body must not call begin() or end(), and must emit the same code both times it is called. RBP is the
+  ///         frame pointer whenever the function uses stack memory, in which case the body must not modify it.
+  ///         Procedures cannot be used within a function, since their ret() would run the epilogue.
+
+  /// \brief  assembles a function
+  /// \param  body a callable taking Derived&, which emits the body of the function
+  /// \return false if the virtual registers could not be allocated (which only happens if the body itself uses
+  ///         nearly every register), in which case no code is emitted
+  template<typename Body>
+  inline bool function(Body body)
+    {
+      // first pass: record register usage
+      begin();
+      m_frame.mode = kFrameRecord;
+      m_frame.uses.clear();
+      m_frame.calls.clear();
+      m_frame.branches.clear();
+      m_frame.slotBytes = 0;
+      m_virtuals.clear();
+      m_virtualUses.clear();
+      body(self());
+      findBranches();
+      if (!allocateRegisters())
+      {
+        m_frame.mode = kFrameOff;
+        begin();
+        return false;
+      }
+      layoutFrame();
+
+      // second pass: emit the function
+      begin();
+      m_frame.mode = kFrameEmit;
+      m_frame.slotBytes = 0;
+      m_frame.callIndex = 0;
+      m_numVirtuals = 0;
+      m_numPending = 0;
+      prologue();
+      body(self());
+      flushStores();
+      m_frame.mode = kFrameOff;
+      end();
+      return true;
+    }
+
+  /// \brief  reserves stack memory within function(), and returns its offset from RBP. Slots of 32 bytes or more are
+  ///         32 byte aligned (so can be accessed with movaps), smaller slots are 8 byte aligned.
+  /// \param  num_bytes the size of the slot
+  inline int32_t stack_slot(uint32_t num_bytes)
+    {
+      const uint32_t align = num_bytes >= 32 ? 32 : 8;
+      const uint32_t offset = (m_frame.slotBytes + align - 1) & ~(align - 1);
+      m_frame.slotBytes = offset + ((num_bytes + 7) & ~7u);
+      return int32_t(offset);
+    }
+
+  /// \name   Virtual registers
+  /// \brief  Within function(), the body can use as many virtual registers as it likes, and leave the allocation to
+  ///         the emitter:
+  /// \code
+  /// e.function([&](vpu::Emitter& e) {
+  ///   vpu::VReg x = e.new_ymm(), y = e.new_ymm();
+  ///   e.movaps(x, vpu::RCX, 0);
+  ///   e.mulps(y, x, x);
+  ///   e.movaps(vpu::RCX, 0, y);
+  ///   e.ret();
+  /// });
+  /// \endcode
+  ///         The live range of each virtual register runs from its first use to its last (extended to the end of any
+  ///         loop it is live into), and the ranges are allocated to physical registers with a linear scan. Registers
+  ///         the body uses directly are avoided while they are in use, as are RSP, RBP (the frame pointer), and R12
+  ///         (which mov64 can't store). When there are more live values than registers, the values that live longest
+  ///         are spilled to 32 byte aligned slots in the stack frame, and a few registers are reserved as scratch
+  ///         registers, which each instruction that uses a spilled value loads it into (and stores it back from).
+  ///         Values that are carried around a loop must be written before the loop is entered.
+
+  /// \brief  creates a new virtual YMM register (only valid within function())
+  inline VReg new_ymm()
+    { const VReg r = { this, newVirtual(false) }; return r; }
+
+  /// \brief  creates a new virtual general purpose register (only valid within function())
+  inline VGpr new_gpr()
+    { const VGpr r = { this, newVirtual(true) }; return r; }
+
+  /// \brief  function return! Within function(), the epilogue is emitted first.
+  inline void ret()
+    {
+      flushStores();
+      if (m_frame.mode == kFrameEmit)
+        epilogue();
+      if (!m_inProcedure && zeroUpperIfDirty())
+        m_zeroUppers.push_back(uint32_t(self().numBytes() - 3));
+      describe(kFormRet, 0, 0, 0xC3, 0, 0, 0, 0, 0, 0);
+      emit8(0xC3);
+    }
+
+  /// \name   Constant Values
+
+  /// broadcast float across an entire YMM register
+  inline uint32_t set1_ps(float value)
+    { const float v[8] = { value, value, value, value, value, value, value, value }; return addConstant(v, 4); }
+
+  /// broadcast double across an entire YMM register
+  inline uint32_t set1_pd(double value)
+    { const double v[4] = { value, value, value, value }; return addConstant(v, 8); }
+
+  /// broadcast 32bit int across an entire YMM register
+  inline uint32_t set1_epi32(int32_t value)
+    { const int32_t v[8] = { value, value, value, value, value, value, value, value }; return addConstant(v, 4); }
+
+  /// set a YMM register from 8 floats
+  inline uint32_t set_ps(float a0, float a1, float a2, float a3, float a4, float a5, float a6, float a7)
+    { const float v[8] = { a0, a1, a2, a3, a4, a5, a6, a7 }; return addConstant(v); }
+
+  /// set a YMM register from 4 doubles
+  inline uint32_t set_pd(double a0, double a1, double a2, double a3)
+    { const double v[4] = { a0, a1, a2, a3 }; return addConstant(v); }
+
+  /// set a YMM register from 8 32bit integers
+  inline uint32_t set_epi32(int32_t a0, int32_t a1, int32_t a2, int32_t a3, int32_t a4, int32_t a5, int32_t a6, int32_t a7)
+    { const int32_t v[8] = { a0, a1, a2, a3, a4, a5, a6, a7 }; return addConstant(v); }
+
+  /// load the constant at the given location (the value returned from set1_ps, set_pd, etc) into the target YMM register.
+  inline void load_const(AVXReg target, uint32_t location)
+    {
+      flushStores();
+      const uint32_t element = (location & kPoolConstant) ? m_poolConstants[location & ~kPoolConstant].numBytes : 32;
+      uint8_t* p = 0;
+      if (element < 32)
+      {
+        // vbroadcastss (or vbroadcastsd) target, [rip + disp32]
+        const uint8_t op = element == 4 ? 0x18 : 0x19;
+        describe(kFormOther, 2, 1, op, 0, 1, target, 0, 5, 0);
+        p = self().reserve(9);
+        *p++ = 0xC4;
+        *p++ = (target & 8) ? 0x62 : 0xE2;
+        *p++ = 0x7D;
+        *p++ = op;
+      }
+      else
+      {
+        // vmovups target, [rip + disp32] (the displacement is filled in by end())
+        describe(kFormOther, 1, 0, 0x10, 0, 1, target, 0, 5, 0);
+        p = self().reserve(8);
+        *p++ = 0xC5;
+        *p++ = (target & 8) ? 0x7C : 0xFC;
+        *p++ = 0x10;
+      }
+      *p++ = uint8_t((target & 7) << 3 | 5);
+      p = write32(p, 0);
+      self().commit(p);
+      ConstantRef ref = { location, uint32_t(self().numBytes()) };
+      m_constantRefs.push_back(ref);
+    }
+
+  /// \brief  mask = a mask for maskmovps & pmaskmovd with the first count elements set, where count is the low 32 bits
+  ///         of a GPR (0 or less sets none, 8 or more all 8). For example, the last n % 8 floats of an array.
+  ///         Any of the registers may be virtual (VReg & VGpr).
+  /// \param  scratch overwritten (with the constant 0, 1, ... 7)
+  template<typename M, typename C, typename S>
+  inline void tail_mask(M mask, C count, S scratch)
+    { tailMask(mask, count, scratch, set_epi32(0, 1, 2, 3, 4, 5, 6, 7)); }
+
+  /// \brief  the same, for maskmovpd & pmaskmovq (with count 0 -> 4)
+  template<typename M, typename C, typename S>
+  inline void tail_mask_pd(M mask, C count, S scratch)
+    { tailMask(mask, count, scratch, set_epi32(0, 0, 1, 1, 2, 2, 3, 3)); }
+
+  /// \brief  Stores the constants in a ConstantPool shared with other kernels from now on, rather than after the code.
+  ///         set1_ps, set_epi32, etc then return a location in the pool (which can only be used until the next
+  ///         begin()), and constantOffset() doesn't apply. The code refers to the pool relative to the instruction
+  ///         pointer, so once the code has been copied to where it will run, it must be linked to the pool with
+  ///         linkConstants() (unless setRuntimeAddress was called, in which case end() does that). If the pool is
+  ///         full, the constants are stored after the code as usual.
+  /// \param  pool the pool, or null to store the constants after the code
+  /// \param  broadcast if true, set1_ps and set1_epi32 (and set1_pd) store a single 4 (or 8) byte value, which
+  ///         load_const() loads with vbroadcastss (or vbroadcastsd), rather than storing all 32 bytes
+  inline void setConstantPool(ConstantPool* pool, bool broadcast = false)
+    {
+      m_pool = pool;
+      m_broadcast = broadcast;
+    }
+
+  /// \brief  the pool the constants are stored in, or null
+  inline ConstantPool* constantPool() const
+    { return m_pool; }
+
+  /// \brief  true from end() until linkConstants() succeeds, if the code refers to the ConstantPool. The code must not
+  ///         be run while this is true: its references to the pool hold a sentinel rather than the constants' address.
+  inline bool needsLinking() const
+    { return m_unlinked; }
+
+  /// \brief  points the code's references to the ConstantPool at the pool, once the code has been copied to where it
+  ///         will run (e.g. after CodeArena::commit)
+  /// \param  writable the copied code, through a writable view (Kernel::writable)
+  /// \param  code the address the code will run from (Kernel::code)
+  /// \return false if a constant is more than 2GB from the code, in which case the code must not be run
+  inline bool linkConstants(void* writable, const void* code)
+    {
+      bool linked = true;
+      for (size_t i = 0; i < m_poolRefs.size(); ++i)
+      {
+        const ConstantRef& ref = m_poolRefs[i];
+        const intptr_t next = intptr_t(code) + intptr_t(ref.offset);
+        const intptr_t rel = intptr_t(m_poolConstants[ref.index & ~kPoolConstant].address) - next;
+        if (rel < INT32_MIN || rel > INT32_MAX || size_t(ref.offset) > self().numBytes())
+          linked = false;
+        else
+          write32(static_cast<uint8_t*>(writable) + ref.offset - 4, uint32_t(rel));
+      }
+      if (linked)
+        m_unlinked = false;
+      return linked;
+    }
+
+  /// \name   Labels & procedures
+  /// \brief  Labels mark a location in the code that can be jumped to (or called, for a procedure), either before or
+  ///         after the label is bound. The jumps are resolved by end(). A label that is never bound refers to the start
+  ///         of the code, and label ids are only valid until the next call to begin().
+
+  /// \brief  create a new (unbound) label
+  inline LabelId new_label()
+    {
+      m_labelLocations.push_back(0);
+      const LabelId label = { uint32_t(m_labelLocations.size() - 1) };
+      return label;
+    }
+
+  /// \brief  bind the label to the current location
+  inline void bind(LabelId label)
+    {
+      flushStores();
+      m_labelLocations[label.index] = uint32_t(self().numBytes());
+      m_upperDirty = m_upperDirty || m_upperUsed;
+      if (isProcedure(label))
+        m_inProcedure = true;
+    }
+
+  // jump to a label
+  inline void jump_eq(LabelId label)
+    { jumpLabel(0x4, label); }
+  inline void jump_ne(LabelId label)
+    { jumpLabel(0x5, label); }
+  inline void jump_lt(LabelId label)
+    { jumpLabel(0xC, label); }
+  inline void jump_gt(LabelId label)
+    { jumpLabel(0xF, label); }
+  inline void jump_le(LabelId label)
+    { jumpLabel(0xE, label); }
+  inline void jump_ge(LabelId label)
+    { jumpLabel(0xD, label); }
+
+  /// \brief  call the procedure starting at a label
+  inline void call_procedure(LabelId procedure)
+    {
+      if (!isProcedure(procedure))
+      {
+        // the procedure may already have been emitted, with a vzeroupper before its ret()
+        m_procedures.push_back(procedure.index);
+        for (size_t i = 0; i < m_zeroUppers.size(); ++i)
+        {
+          if (m_zeroUppers[i] >= m_labelLocations[procedure.index] && m_zeroUppers[i] + 3 <= self().numBytes())
+            writeNops(self().bytecode() + m_zeroUppers[i], 3);
+        }
+      }
+      describe(kFormOther, 0, 0, 0xE8, 0, 0, 0, 0, 0, 0);
+      uint8_t* p = self().reserve(5);
+      *p++ = 0xE8;
+      p = write32(p, 0);
+      self().commit(p);
+      addLabelRef(procedure);
+    }
+
+  // the jump_xx(offset) methods are hidden by the overloads above
+  using EncoderBase<Derived>::jump_eq;
+  using EncoderBase<Derived>::jump_ne;
+  using EncoderBase<Derived>::jump_lt;
+  using EncoderBase<Derived>::jump_gt;
+  using EncoderBase<Derived>::jump_le;
+  using EncoderBase<Derived>::jump_ge;
+
+  /// \name   Named labels & procedures
+  /// \brief  The same as the IAssembler methods. Each name is looked up in a hash table, and maps to a LabelId.
+  ///         Labels and procedures have separate names.
+
+  // jump to a label (which may be inserted before or after the jump)
+  inline void jump_eq_label(const char* label)
+    { jumpLabel(0x4, namedLabel(m_labelNames, label)); }
+  inline void jump_ne_label(const char* label)
+    { jumpLabel(0x5, namedLabel(m_labelNames, label)); }
+  inline void jump_lt_label(const char* label)
+    { jumpLabel(0xC, namedLabel(m_labelNames, label)); }
+  inline void jump_gt_label(const char* label)
+    { jumpLabel(0xF, namedLabel(m_labelNames, label)); }
+  inline void jump_le_label(const char* label)
+    { jumpLabel(0xE, namedLabel(m_labelNames, label)); }
+  inline void jump_ge_label(const char* label)
+    { jumpLabel(0xD, namedLabel(m_labelNames, label)); }
+
+  // insert label at current location
+  inline void insert_label(const char* label)
+    { bind(namedLabel(m_labelNames, label)); }
+
+  inline void call_prodecure(const char* str)
+    { call_procedure(namedLabel(m_procedureNames, str)); }
+  inline void prodecure(const char* str)
+    { bind(namedLabel(m_procedureNames, str)); m_inProcedure = true; }
+
+protected:
+
+  using EncoderBase<Derived>::self;
+  using EncoderBase<Derived>::emit8;
+  using EncoderBase<Derived>::write32;
+  using EncoderBase<Derived>::writeNops;
+  using EncoderBase<Derived>::jump;
+  using EncoderBase<Derived>::describe;
+
+  /// overwrite 4 bytes of previously emitted code
+  inline void patch32(uint32_t offset, uint32_t value)
+    {
+      if (size_t(offset) + 4 <= self().numBytes())
+        write32(self().bytecode() + offset, value);
+    }
+
+  /// a jcc rel32 to a label, resolved by end()
+  inline void jumpLabel(uint8_t cc, LabelId label)
+    {
+      jump(cc, 0x7FFFFFFF);
+      addLabelRef(label);
+    }
+
+  /// record that the 4 bytes before the current location are a rel32 to the label
+  inline void addLabelRef(LabelId label)
+    {
+      const LabelRef ref = { label.index, uint32_t(self().numBytes() - 4) };
+      m_labelRefs.push_back(ref);
+    }
+
+  /// record the registers used by each instruction during the first pass of function()
+  /// (the virtual registers are Reg(16) & AVXReg(16) in the first pass, and are not recorded here). In the second
+  /// pass, the start of an instruction is where the spilled virtual registers used by the last are stored.
+  template<typename T>
+  inline void useRegister(T) {}
+  inline void useRegister(Reg r)
+    {
+      if (m_frame.mode == kFrameRecord && r < 16 && r != RSP)
+        recordUse(1u << r);
+      else
+        flushStores();
+    }
+  inline void useRegister(AVXReg r)
+    {
+      if (m_frame.mode == kFrameRecord && r < 16)
+        recordUse(1u << (16 + r));
+      else
+        flushStores();
+    }
+
+  /// record jumps to an offset during the first pass of function() (jumps to labels are found in m_labelRefs)
+  inline void useJump(int32_t offset)
+    {
+      flushStores();
+      if (m_frame.mode != kFrameRecord || offset == 0x7FFFFFFF)
+        return;
+      const uint32_t source = uint32_t(self().numBytes());
+      const Branch branch = { source, source + ((offset >= -128 && offset <= 127) ? 2 : 6) + offset };
+      m_frame.branches.push_back(branch);
+    }
+
+  /// record each instruction for the optimisation passes (other than in the first pass of function()), and whether
+  /// it leaves the upper halves of the YMM registers dirty. A load may be preceded by a prefetch (see
+  /// setPrefetchDistance).
+  inline void useInstruction(const InstructionInfo& info)
+    {
+      if (m_prefetchDistance && isMove(info, kFormRM) && info.L && !(info.disp & 63) && info.rm != RSP &&
+          info.rm != RBP)
+      {
+        const Mem address = { Reg(info.rm), info.scale ? Reg(info.index) : RSP, uint8_t(info.scale ? info.scale : 1),
+          info.disp + m_prefetchDistance };
+        self().prefetch(address, m_prefetchHint);
+      }
+      if (info.map == 1 && info.op == 0x77 && info.form == kFormOther)
+        m_upperDirty = false;
+      else
+      if (info.L && info.map)
+        m_upperDirty = m_upperUsed = true;
+      if (!m_optimisations || m_frame.mode == kFrameRecord)
+        return;
+      const uint32_t offset = uint32_t(self().numBytes());
+      if (!m_instructions.empty() && m_instructions.back().offset == offset &&
+          m_instructions.back().info.form != kFormAlign)
+        return;
+      Instruction in;
+      in.offset = offset;
+      in.size = 0;
+      in.info = info;
+      in.target = -1;
+      in.removed = false;
+      in.isTarget = false;
+      in.numBytes = 0;
+      m_instructions.push_back(in);
+    }
+
+private:
+
+  struct Constant
+  {
+    uint8_t bytes[32];
+  };
+
+  struct ConstantRef
+  {
+    uint32_t index;   ///< the constant (value returned from set1_ps, etc)
+    uint32_t offset;  ///< offset of the end of the instruction that references it
+  };
+
+  /// a constant stored in the ConstantPool
+  struct PoolConstant
+  {
+    const void* address;
+    uint32_t numBytes;  ///< 32, or 4 or 8 for a value that is broadcast
+  };
+
+  /// the bit set in the locations of constants in the ConstantPool
+  static const uint32_t kPoolConstant = 0x80000000u;
+
+  struct LabelRef
+  {
+    uint32_t label;   ///< LabelId::index
+    uint32_t offset;  ///< offset of the rel32 field that refers to the label
+  };
+
+  typedef std::unordered_map<std::string, LabelId> LabelNames;
+
+  enum FrameMode
+  {
+    kFrameOff,
+    kFrameRecord,     ///< first pass of function()
+    kFrameEmit        ///< second pass of function()
+  };
+
+  /// bits 0 -> 15 are the GPRs, 16 -> 31 the YMM registers
+  struct RegisterUse
+  {
+    uint32_t offset;  ///< start of the instruction
+    uint32_t mask;    ///< the registers it uses
+  };
+
+  struct CallSite
+  {
+    uint32_t offset;      ///< start of the call instruction
+    uint32_t stackSpace;  ///< callStackSpace() of the function called
+  };
+
+  struct Branch
+  {
+    uint32_t source;
+    uint32_t target;
+  };
+
+  struct Virtual
+  {
+    bool gpr;
+    int32_t reg;      ///< the register allocated, or -1 if spilled
+    int32_t slot;     ///< RBP offset of the spill slot
+    uint32_t start;   ///< the live range
+    uint32_t end;
+  };
+
+  struct VirtualUse
+  {
+    uint32_t offset;  ///< start of the instruction
+    uint32_t index;   ///< the virtual register
+  };
+
+  /// a spilled virtual register loaded into a scratch register, to be stored back after the instruction
+  struct Pending
+  {
+    uint32_t index;
+    uint8_t reg;
+  };
+
+  enum { kMaxScratch = 4 };
+
+  struct Frame
+  {
+    FrameMode mode;
+    std::vector<RegisterUse> uses;      ///< first pass
+    std::vector<CallSite> calls;        ///< first pass
+    std::vector<Branch> branches;       ///< first pass
+    std::vector<uint32_t> live;         ///< the registers to preserve around each call
+    uint32_t slotBytes;                 ///< allocated by stack_slot()
+    uint32_t pushed;                    ///< GPRs pushed by the prologue
+    uint32_t saved;                     ///< YMM registers saved by the prologue
+    uint32_t frameBytes;                ///< the size of the frame at RBP
+    uint32_t stackSize;                 ///< subtracted from RSP by the prologue
+    uint32_t callSpace;                 ///< the largest callStackSpace() of any call
+    uint32_t callIndex;                 ///< the next call, in the second pass
+    int32_t spillSlots[32];             ///< RBP offset of the slot each register is spilled to around calls
+    int32_t saveSlots[16];              ///< RBP offset of the slot each YMM register is saved to by the prologue
+  };
+
+  /// an instruction recorded for the optimisation passes
+  struct Instruction
+  {
+    uint32_t offset;      ///< start of the instruction, in the code as emitted
+    uint32_t size;
+    InstructionInfo info;
+    int32_t target;       ///< the instruction a jump lands on (or the number of instructions, for the end of the code)
+    bool removed;
+    bool isTarget;        ///< a label is bound to, or a jump lands on, this instruction
+    uint8_t numBytes;     ///< the size of the replacement encoding, or 0 to keep the original bytes
+    uint8_t bytes[16];
+  };
+
+  /// encodes the instruction that replaces another
+  class Replacement : public EncoderBase<Replacement>
+  {
+    friend class EncoderBase<Replacement>;
+  public:
+    inline Replacement()
+      : m_size(0), m_described(false) {}
+
+    using EncoderBase<Replacement>::encodeRR;
+    using EncoderBase<Replacement>::encodeRM;
+    using EncoderBase<Replacement>::encodeRR3;
+    using EncoderBase<Replacement>::emit8;
+
+    /// replace the instruction with the one encoded
+    inline void apply(Instruction& in) const
+      {
+        memcpy(in.bytes, m_bytes, m_size);
+        in.numBytes = uint8_t(m_size);
+        in.info = m_info;
+      }
+
+  private:
+    inline uint8_t* reserve(size_t)
+      { return m_bytes + m_size; }
+    inline void commit(uint8_t* end)
+      { m_size = size_t(end - m_bytes); }
+    inline size_t numBytes() const
+      { return m_size; }
+    inline void useInstruction(const InstructionInfo& info)
+      {
+        if (!m_described)
+          m_info = info;
+        m_described = true;
+      }
+
+    uint8_t m_bytes[16 + EncoderBase<Replacement>::kMaxReserve];
+    size_t m_size;
+    bool m_described;
+    InstructionInfo m_info;
+  };
+
+  /// \param  element the size of each element, if every element of the value is the same (which may be broadcast)
+  inline uint32_t addConstant(const void* value, uint32_t element = 0)
+    {
+      const void* address = 0;
+      if (m_pool)
+        address = (m_broadcast && element) ? m_pool->add(value, element) : m_pool->add(value, 32);
+      if (address)
+      {
+        const PoolConstant pc = { address, (m_broadcast && element) ? element : 32u };
+        m_poolConstants.push_back(pc);
+        return uint32_t(m_poolConstants.size() - 1) | kPoolConstant;
+      }
+      Constant c;
+      memcpy(c.bytes, value, 32);
+      m_constants.push_back(c);
+      return uint32_t(m_constants.size() - 1);
+    }
+
+  /// writes a vzeroupper if setZeroUpper is enabled, and the upper halves of the YMM registers may be dirty
+  inline bool zeroUpperIfDirty()
+    {
+      if (!m_zeroUpper || !m_upperDirty)
+        return false;
+      self().zeroupper();
+      return true;
+    }
+
+  /// true if the label has been called with call_procedure
+  inline bool isProcedure(LabelId label) const
+    { return std::find(m_procedures.begin(), m_procedures.end(), label.index) != m_procedures.end(); }
+
+  /// mask = (count, count, ...) > the constant at location, as 32bit integers. The registers are resolved by each
+  /// instruction, so that a spilled virtual register is loaded & stored around each one.
+  template<typename M, typename C, typename S>
+  inline void tailMask(M mask, C count, S scratch, uint32_t location)
+    {
+      self().movd(mask, count);
+      self().broadcasti32(mask, mask);
+      load_const(scratch, location);
+      self().cmpgti32(mask, mask, scratch);
+    }
+
+  inline void recordUse(uint32_t mask)
+    {
+      const uint32_t offset = uint32_t(self().numBytes());
+      if (!m_frame.uses.empty() && m_frame.uses.back().offset == offset)
+        m_frame.uses.back().mask |= mask;
+      else
+      {
+        const RegisterUse use = { offset, mask };
+        m_frame.uses.push_back(use);
+      }
+    }
+
+  static inline uint32_t gprBit(Reg r)
+    { return 1u << r; }
+  static inline uint32_t ymmBit(uint32_t r)
+    { return 1u << (16 + r); }
+
+  /// called before each call instruction: records the call (first pass), or stores the live registers (second pass)
+  inline void beginCall(uint32_t stack_space, Reg table)
+    {
+      flushStores();
+      if (m_frame.mode == kFrameRecord)
+      {
+        useRegister(table);
+        const CallSite site = { uint32_t(self().numBytes()), stack_space };
+        m_frame.calls.push_back(site);
+      }
+      else
+      if (m_frame.mode == kFrameEmit && m_frame.callIndex < m_frame.live.size())
+        spill(m_frame.live[m_frame.callIndex], true);
+    }
+
+  /// called after each call instruction: reloads the live registers (second pass)
+  inline void endCall()
+    {
+      if (m_frame.mode == kFrameEmit && m_frame.callIndex < m_frame.live.size())
+        spill(m_frame.live[m_frame.callIndex++], false);
+    }
+
+  /// store (or reload) the registers in mask to (from) their stack slots
+  inline void spill(uint32_t mask, bool store)
+    {
+      for (uint32_t r = 0; r < 32; ++r)
+      {
+        if (!(mask & (1u << r)))
+          continue;
+        if (r < 16)
+        {
+          if (store)
+            self().mov64(RBP, m_frame.spillSlots[r], Reg(r));
+          else
+            self().mov64(Reg(r), RBP, m_frame.spillSlots[r]);
+        }
+        else
+        {
+          if (store)
+            self().movaps(RBP, m_frame.spillSlots[r], AVXReg(r - 16));
+          else
+            self().movaps(AVXReg(r - 16), RBP, m_frame.spillSlots[r]);
+        }
+      }
+    }
+
+  /// label jumps (and calls to procedures) are branches too
+  inline void findBranches()
+    {
+      for (size_t i = 0; i < m_labelRefs.size(); ++i)
+      {
+        const Branch branch = { m_labelRefs[i].offset, m_labelLocations[m_labelRefs[i].label] };
+        m_frame.branches.push_back(branch);
+      }
+    }
+
+  /// extend a live range that is live into a loop to the end of the loop
+  inline void extendOverLoops(uint32_t start, uint32_t& end) const
+    {
+      for (bool changed = true; changed; )
+      {
+        changed = false;
+        for (size_t b = 0; b < m_frame.branches.size(); ++b)
+        {
+          const Branch& branch = m_frame.branches[b];
+          if (branch.target <= branch.source && start < branch.target && end >= branch.target && end < branch.source)
+          {
+            end = branch.source;
+            changed = true;
+          }
+        }
+      }
+    }
+
+  inline uint32_t newVirtual(bool gpr)
+    {
+      if (m_frame.mode == kFrameRecord)
+      {
+        const Virtual v = { gpr, -1, 0, ~0u, 0 };
+        m_virtuals.push_back(v);
+        return uint32_t(m_virtuals.size() - 1);
+      }
+      return m_numVirtuals++;
+    }
+
+  /// VirtualRegisters
+  virtual AVXReg ymm(uint32_t index)
+    { return AVXReg(resolveVirtual(index)); }
+  virtual Reg gpr(uint32_t index)
+    { return Reg(resolveVirtual(index)); }
+
+  inline uint8_t resolveVirtual(uint32_t index)
+    {
+      if (index >= m_virtuals.size())
+        return 0;
+      Virtual& v = m_virtuals[index];
+      if (m_frame.mode == kFrameRecord)
+      {
+        const VirtualUse use = { uint32_t(self().numBytes()), index };
+        m_virtualUses.push_back(use);
+        if (use.offset < v.start)
+          v.start = use.offset;
+        if (use.offset > v.end)
+          v.end = use.offset;
+        return 16;
+      }
+      if (m_frame.mode != kFrameEmit)
+        return 0;
+      flushStores();
+      if (v.reg >= 0)
+        return uint8_t(v.reg);
+
+      // a spilled register, which may already be loaded for this instruction
+      uint32_t num_loaded = 0;
+      for (uint32_t i = 0; i < m_numPending; ++i)
+      {
+        if (m_pending[i].index == index)
+          return m_pending[i].reg;
+        num_loaded += m_virtuals[m_pending[i].index].gpr == v.gpr;
+      }
+      const uint32_t num_scratch = v.gpr ? m_numGprScratch : m_numYmmScratch;
+      const uint8_t* scratch = v.gpr ? m_gprScratch : m_ymmScratch;
+      const uint8_t reg = scratch[num_loaded < num_scratch ? num_loaded : num_scratch - 1];
+      if (v.gpr)
+        self().mov64(Reg(reg), RBP, v.slot);
+      else
+        self().movaps(AVXReg(reg), RBP, v.slot);
+      if (m_numPending < 2 * kMaxScratch)
+      {
+        const Pending pending = { index, reg };
+        m_pending[m_numPending++] = pending;
+      }
+      m_pendingEnd = uint32_t(self().numBytes());
+      return reg;
+    }
+
+  /// store the spilled virtual registers used by the previous instruction
+  inline void flushStores()
+    {
+      if (!m_numPending || self().numBytes() == m_pendingEnd)
+        return;
+      const uint32_t num_pending = m_numPending;
+      m_numPending = 0;
+      for (uint32_t i = 0; i < num_pending; ++i)
+      {
+        const Virtual& v = m_virtuals[m_pending[i].index];
+        if (v.gpr)
+          self().mov64(RBP, v.slot, Reg(m_pending[i].reg));
+        else
+          self().movaps(RBP, v.slot, AVXReg(m_pending[i].reg));
+      }
+    }
+
+  /// linear scan allocation of the virtual registers of one type (GPR or YMM)
+  /// \param  order the registers to allocate from, in order of preference
+  /// \param  first/last the range over which each physical register is used by the body (bits as RegisterUse)
+  inline void linearScan(bool gpr, const uint8_t* order, uint32_t num_regs, const uint32_t* first, const uint32_t* last)
+    {
+      std::vector<uint32_t> sorted;
+      for (uint32_t i = 0; i < m_virtuals.size(); ++i)
+        if (m_virtuals[i].gpr == gpr && m_virtuals[i].start != ~0u)
+          sorted.push_back(i);
+      std::sort(sorted.begin(), sorted.end(), LiveRangeOrder(m_virtuals));
+
+      const uint32_t bit_offset = gpr ? 0 : 16;
+      std::vector<uint32_t> active;
+      for (size_t i = 0; i < sorted.size(); ++i)
+      {
+        Virtual& v = m_virtuals[sorted[i]];
+        v.reg = -1;
+
+        // free the registers of ranges that have ended
+        for (size_t a = 0; a < active.size(); )
+        {
+          if (m_virtuals[active[a]].end < v.start)
+          {
+            active[a] = active.back();
+            active.pop_back();
+          }
+          else
+            ++a;
+        }
+
+        // the first register that isn't in use, either by an active range, or the body itself
+        for (uint32_t k = 0; k < num_regs && v.reg < 0; ++k)
+        {
+          const uint32_t r = order[k];
+          bool in_use = last[bit_offset + r] >= v.start && first[bit_offset + r] <= v.end;
+          for (size_t a = 0; a < active.size() && !in_use; ++a)
+            in_use = m_virtuals[active[a]].reg == int32_t(r);
+          if (!in_use)
+            v.reg = int32_t(r);
+        }
+
+        // otherwise spill whichever range ends last
+        if (v.reg < 0)
+        {
+          size_t spill = active.size();
+          for (size_t a = 0; a < active.size(); ++a)
+          {
+            const Virtual& other = m_virtuals[active[a]];
+            const uint32_t r = bit_offset + other.reg;
+            if (other.end > v.end && !(last[r] >= v.start && first[r] <= v.end) &&
+                (spill == active.size() || other.end > m_virtuals[active[spill]].end))
+              spill = a;
+          }
+          if (spill != active.size())
+          {
+            v.reg = m_virtuals[active[spill]].reg;
+            m_virtuals[active[spill]].reg = -1;
+            active[spill] = active.back();
+            active.pop_back();
+          }
+        }
+        if (v.reg >= 0)
+          active.push_back(sorted[i]);
+      }
+    }
+
+  struct LiveRangeOrder
+  {
+    const std::vector<Virtual>& virtuals;
+    LiveRangeOrder(const std::vector<Virtual>& v) : virtuals(v) {}
+    bool operator () (uint32_t a, uint32_t b) const
+      { return virtuals[a].start < virtuals[b].start; }
+  };
+
+  /// allocates the virtual registers, and adds the registers they use to the first pass usage
+  inline bool allocateRegisters()
+    {
+      Frame& f = m_frame;
+      if (m_virtuals.empty())
+        return true;
+      for (size_t i = 0; i < m_virtuals.size(); ++i)
+        if (m_virtuals[i].start != ~0u)
+          extendOverLoops(m_virtuals[i].start, m_virtuals[i].end);
+
+      // the range over which the body uses each register. YMM0 is also in use at each call (it holds the result).
+      uint32_t first[32], last[32];
+      for (uint32_t r = 0; r < 32; ++r)
+      {
+        first[r] = ~0u;
+        last[r] = 0;
+      }
+      for (size_t i = 0; i < f.uses.size(); ++i)
+        for (uint32_t r = 0; r < 32; ++r)
+          if (f.uses[i].mask & (1u << r))
+          {
+            first[r] = f.uses[i].offset < first[r] ? f.uses[i].offset : first[r];
+            last[r] = f.uses[i].offset > last[r] ? f.uses[i].offset : last[r];
+          }
+      for (size_t i = 0; i < f.calls.size(); ++i)
+      {
+        first[16 + YMM0] = f.calls[i].offset < first[16 + YMM0] ? f.calls[i].offset : first[16 + YMM0];
+        last[16 + YMM0] = f.calls[i].offset > last[16 + YMM0] ? f.calls[i].offset : last[16 + YMM0];
+      }
+      for (uint32_t r = 0; r < 32; ++r)
+        if (first[r] != ~0u)
+          extendOverLoops(first[r], last[r]);
+
+      // caller saved registers first
+      static const uint8_t win64_gprs[] = { RAX, RCX, RDX, R8, R9, R10, R11, RSI, RDI, RBX, R13, R14, R15 };
+      static const uint8_t sysv_gprs[] = { RAX, RCX, RDX, RSI, RDI, R8, R9, R10, R11, RBX, R13, R14, R15 };
+      static const uint8_t ymms[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+      const uint8_t* gprs = m_convention == kSystemV ? sysv_gprs : win64_gprs;
+      const uint32_t num_gprs = sizeof(win64_gprs), num_ymms = sizeof(ymms);
+
+      // allocate, reserving more scratch registers until every instruction has enough for its spilled operands
+      m_numGprScratch = m_numYmmScratch = 0;
+      for (;;)
+      {
+        uint8_t gpr_order[16], ymm_order[16];
+        uint32_t num_gpr_order = 0, num_ymm_order = 0;
+        uint32_t gpr_scratch = 0, ymm_scratch = 0;
+        for (uint32_t k = num_gprs; k > 0; --k)
+        {
+          const uint8_t r = gprs[k - 1];
+          if (gpr_scratch < m_numGprScratch && first[r] == ~0u)
+            m_gprScratch[gpr_scratch++] = r;
+          else
+            gpr_order[num_gpr_order++] = r;
+        }
+        for (uint32_t k = num_ymms; k > 0; --k)
+        {
+          const uint8_t r = ymms[k - 1];
+          if (ymm_scratch < m_numYmmScratch && first[16 + r] == ~0u)
+            m_ymmScratch[ymm_scratch++] = r;
+          else
+            ymm_order[num_ymm_order++] = r;
+        }
+        if (gpr_scratch < m_numGprScratch || ymm_scratch < m_numYmmScratch)
+          return false;
+        std::reverse(gpr_order, gpr_order + num_gpr_order);
+        std::reverse(ymm_order, ymm_order + num_ymm_order);
+        linearScan(true, gpr_order, num_gpr_order, first, last);
+        linearScan(false, ymm_order, num_ymm_order, first, last);
+
+        // the most spilled registers used by one instruction
+        uint32_t gpr_needed = 0, ymm_needed = 0;
+        for (size_t i = 0; i < m_virtualUses.size(); )
+        {
+          uint32_t spilled[2 * kMaxScratch], num_spilled = 0, num_gpr = 0, num_ymm = 0;
+          const uint32_t offset = m_virtualUses[i].offset;
+          for (; i < m_virtualUses.size() && m_virtualUses[i].offset == offset; ++i)
+          {
+            const uint32_t index = m_virtualUses[i].index;
+            if (m_virtuals[index].reg >= 0 || std::find(spilled, spilled + num_spilled, index) != spilled + num_spilled)
+              continue;
+            if (num_spilled < 2 * kMaxScratch)
+              spilled[num_spilled++] = index;
+            ++(m_virtuals[index].gpr ? num_gpr : num_ymm);
+          }
+          gpr_needed = num_gpr > gpr_needed ? num_gpr : gpr_needed;
+          ymm_needed = num_ymm > ymm_needed ? num_ymm : ymm_needed;
+        }
+        gpr_needed = gpr_needed < uint32_t(kMaxScratch) ? gpr_needed : uint32_t(kMaxScratch);
+        ymm_needed = ymm_needed < uint32_t(kMaxScratch) ? ymm_needed : uint32_t(kMaxScratch);
+        if (gpr_needed <= m_numGprScratch && ymm_needed <= m_numYmmScratch)
+          break;
+        m_numGprScratch = gpr_needed > m_numGprScratch ? gpr_needed : m_numGprScratch;
+        m_numYmmScratch = ymm_needed > m_numYmmScratch ? ymm_needed : m_numYmmScratch;
+      }
+
+      // spill slots follow the stack slots
+      uint32_t slot_bytes = (f.slotBytes + 31) & ~31u;
+      for (size_t i = 0; i < m_virtuals.size(); ++i)
+        if (m_virtuals[i].reg < 0 && !m_virtuals[i].gpr && m_virtuals[i].start != ~0u)
+        {
+          m_virtuals[i].slot = int32_t(slot_bytes);
+          slot_bytes += 32;
+        }
+      for (size_t i = 0; i < m_virtuals.size(); ++i)
+        if (m_virtuals[i].reg < 0 && m_virtuals[i].gpr && m_virtuals[i].start != ~0u)
+        {
+          m_virtuals[i].slot = int32_t(slot_bytes);
+          slot_bytes += 8;
+        }
+      f.slotBytes = slot_bytes;
+
+      // the registers used by each instruction now include the allocated & scratch registers
+      uint32_t gpr_scratch_mask = 0, ymm_scratch_mask = 0;
+      for (uint32_t i = 0; i < m_numGprScratch; ++i)
+        gpr_scratch_mask |= 1u << m_gprScratch[i];
+      for (uint32_t i = 0; i < m_numYmmScratch; ++i)
+        ymm_scratch_mask |= 1u << (16 + m_ymmScratch[i]);
+      for (size_t i = 0; i < m_virtualUses.size(); ++i)
+      {
+        const Virtual& v = m_virtuals[m_virtualUses[i].index];
+        RegisterUse use = { m_virtualUses[i].offset, 0 };
+        if (v.reg >= 0)
+          use.mask = 1u << ((v.gpr ? 0 : 16) + v.reg);
+        else
+          use.mask = v.gpr ? gpr_scratch_mask : ymm_scratch_mask;
+        f.uses.push_back(use);
+      }
+      std::stable_sort(f.uses.begin(), f.uses.end(), UseOrder());
+      return true;
+    }
+
+  struct UseOrder
+  {
+    bool operator () (const RegisterUse& a, const RegisterUse& b) const
+      { return a.offset < b.offset; }
+  };
+
+  /// works out the registers to save, and the layout of the stack frame, from the first pass of function()
+  inline void layoutFrame()
+    {
+      Frame& f = m_frame;
+
+      // the registers used at or before each instruction, and after it
+      const size_t num_uses = f.uses.size();
+      std::vector<uint32_t> before(num_uses + 1, 0), after(num_uses + 1, 0);
+      for (size_t i = 0; i < num_uses; ++i)
+        before[i + 1] = before[i] | f.uses[i].mask;
+      for (size_t i = num_uses; i > 0; --i)
+        after[i - 1] = after[i] | f.uses[i - 1].mask;
+      const uint32_t used = before[num_uses];
+
+      uint32_t callee_saved = 0;
+      for (uint32_t r = 0; r < 16; ++r)
+        if (isCalleeSaved(m_convention, Reg(r)))
+          callee_saved |= gprBit(Reg(r)) | (isCalleeSaved(m_convention, AVXReg(r)) ? ymmBit(r) : 0);
+      const uint32_t caller_saved = (~callee_saved & 0xFFFF & ~gprBit(RSP)) | (0xFFFF0000 & ~ymmBit(YMM0));
+
+      // the registers live across each call
+      uint32_t spilled = 0;
+      f.live.assign(f.calls.size(), 0);
+      f.callSpace = 0;
+      for (size_t c = 0; c < f.calls.size(); ++c)
+      {
+        const uint32_t offset = f.calls[c].offset;
+        size_t split = 0;
+        while (split < num_uses && f.uses[split].offset <= offset)
+          ++split;
+        uint32_t live = before[split] & after[split];
+
+        // registers used anywhere within a loop around the call
+        uint32_t loop_start = offset, loop_end = offset;
+        for (size_t b = 0; b < f.branches.size(); ++b)
+        {
+          const Branch& branch = f.branches[b];
+          if (branch.source > offset && branch.target <= offset)
+          {
+            loop_start = branch.target < loop_start ? branch.target : loop_start;
+            loop_end = branch.source > loop_end ? branch.source : loop_end;
+          }
+        }
+        if (loop_start != offset || loop_end != offset)
+          for (size_t i = 0; i < num_uses; ++i)
+            if (f.uses[i].offset >= loop_start && f.uses[i].offset <= loop_end)
+              live |= f.uses[i].mask;
+
+        f.live[c] = live & caller_saved;
+        spilled |= f.live[c];
+        if (f.calls[c].stackSpace > f.callSpace)
+          f.callSpace = f.calls[c].stackSpace;
+      }
+
+      // [RBP] holds the stack slots, then the YMM saves, the YMM spills, and the GPR spills
+      f.saved = used & callee_saved & 0xFFFF0000;
+      f.pushed = used & callee_saved & 0xFFFF & ~gprBit(RBP);
+      uint32_t frame_bytes = (f.slotBytes + 31) & ~31u;
+      for (uint32_t r = 16; r < 32; ++r)
+        if (f.saved & (1u << r))
+        {
+          f.saveSlots[r - 16] = int32_t(frame_bytes);
+          frame_bytes += 32;
+        }
+      for (uint32_t r = 16; r < 32; ++r)
+        if (spilled & (1u << r))
+        {
+          f.spillSlots[r] = int32_t(frame_bytes);
+          frame_bytes += 32;
+        }
+      for (uint32_t r = 0; r < 16; ++r)
+        if (spilled & (1u << r))
+        {
+          f.spillSlots[r] = int32_t(frame_bytes);
+          frame_bytes += 8;
+        }
+      frame_bytes = (frame_bytes + 31) & ~31u;
+
+      // RBP is pushed if it is the frame pointer, or the body uses it
+      if (frame_bytes || (used & gprBit(RBP)))
+        f.pushed |= gprBit(RBP);
+      uint32_t num_pushed = 0;
+      for (uint32_t r = 0; r < 16; ++r)
+        num_pushed += (f.pushed >> r) & 1;
+
+      // after the pushes & stackSize, RSP must be 16 byte aligned for the calls (it is 8 bytes off on entry)
+      f.stackSize = frame_bytes ? f.callSpace + 31 + frame_bytes : f.callSpace;
+      if (f.stackSize || !f.calls.empty())
+        f.stackSize = ((f.stackSize + 15) & ~15u) + ((num_pushed & 1) ? 0 : 8);
+      f.frameBytes = frame_bytes;
+    }
+
+  inline void prologue()
+    {
+      const Frame& f = m_frame;
+      for (uint32_t r = 0; r < 16; ++r)
+        if (f.pushed & gprBit(Reg(r)))
+          self().push(Reg(r));
+      if (f.stackSize)
+        self().sub(RSP, int32_t(f.stackSize));
+      if (f.frameBytes)
+      {
+        self().lea(RBP, RSP, int32_t(f.callSpace + 31));
+        self().and(RBP, -32);
+      }
+      for (uint32_t r = 16; r < 32; ++r)
+        if (f.saved & (1u << r))
+          self().movaps(RBP, f.saveSlots[r - 16], AVXReg(r - 16));
+    }
+
+  inline void epilogue()
+    {
+      const Frame& f = m_frame;
+      for (uint32_t r = 16; r < 32; ++r)
+        if (f.saved & (1u << r))
+          self().movaps(AVXReg(r - 16), RBP, f.saveSlots[r - 16]);
+      if (f.stackSize)
+        self().add(RSP, int32_t(f.stackSize));
+      for (uint32_t r = 16; r > 0; --r)
+        if (f.pushed & gprBit(Reg(r - 1)))
+          self().pop(Reg(r - 1));
+    }
+
+  /// the number of YMM sources (1 = rm, 2 = vvvv & rm) of the VEX instructions the optimiser understands, which write
+  /// the YMM register reg without reading it. 0 for any other instruction.
+  static inline uint32_t numSources(const InstructionInfo& in)
+    {
+      if (in.form != kFormRR && in.form != kFormRM)
+        return 0;
+      if (in.map == 2)
+      {
+        switch (in.op)
+        {
+        case 0x13: case 0x18: case 0x19: case 0x1A: case 0x1C: case 0x1D: case 0x1E: case 0x58: case 0x59: case 0x5A:
+        case 0x78: case 0x79:
+          return 1;
+        case 0x00: case 0x01: case 0x02: case 0x03: case 0x04: case 0x05: case 0x06: case 0x07: case 0x08: case 0x09:
+        case 0x0A: case 0x0B: case 0x0C: case 0x16: case 0x28: case 0x29: case 0x2B: case 0x2C: case 0x2D: case 0x36:
+        case 0x37: case 0x38: case 0x39: case 0x3A: case 0x3B: case 0x3C: case 0x3D: case 0x3E: case 0x3F: case 0x40:
+        case 0x45: case 0x46: case 0x47: case 0x8C:
+          return 2;
+        }
+        return 0;
+      }
+      if (in.map == 3)
+      {
+        switch (in.op)
+        {
+        case 0x00: case 0x01: case 0x04: case 0x05: case 0x08: case 0x09:
+          return 1;
+        case 0x02: case 0x06: case 0x0A: case 0x0B: case 0x0C: case 0x0D: case 0x0E: case 0x0F: case 0x18: case 0x38:
+        case 0x40: case 0x46:
+          return 2;
+        }
+        return 0;
+      }
+      if (in.pp <= 1)
+      {
+        switch (in.op)
+        {
+        case 0x10: case 0x28: case 0x51: case 0x5A: case 0x5B:
+          return 1;
+        case 0x52: case 0x53:
+          return in.pp == 0 ? 1 : 0;
+        case 0x14: case 0x15: case 0x54: case 0x55: case 0x56: case 0x57: case 0x58: case 0x59: case 0x5C: case 0x5D:
+        case 0x5E: case 0x5F: case 0xC2: case 0xC6:
+          return 2;
+        }
+      }
+      if (in.pp == 1)
+      {
+        switch (in.op)
+        {
+        case 0xD4: case 0xDB: case 0xDF: case 0xEB: case 0xEF: case 0xF8: case 0xF9: case 0xFA: case 0xFB: case 0xFC:
+        case 0xFD: case 0xFE:
+          return 2;
+        }
+      }
+      if (in.pp >= 2)
+      {
+        // scalar ops merge the upper elements from vvvv
+        switch (in.op)
+        {
+        case 0x51: case 0x52: case 0x53: case 0x58: case 0x59: case 0x5A: case 0x5C: case 0x5D: case 0x5E: case 0x5F:
+          return 2;
+        }
+      }
+      return (in.op == 0x6F && (in.pp == 1 || in.pp == 2)) ? 1 : 0;
+    }
+
+  /// vfmadd, vfmsub, vfnmadd, etc (which read & write reg)
+  static inline bool isFma(const InstructionInfo& in)
+    {
+      return (in.form == kFormRR || in.form == kFormRM) && in.map == 2 &&
+        ((in.op >= 0x96 && in.op <= 0x9F) || (in.op >= 0xA6 && in.op <= 0xAF) || (in.op >= 0xB6 && in.op <= 0xBF));
+    }
+
+  /// movaps (movups, movapd, movupd, movdqa, movdqu) register -> register, or register <- memory
+  static inline bool isMove(const InstructionInfo& in, uint8_t form)
+    {
+      return in.form == form && in.map == 1 && numSources(in) == 1 &&
+        (in.op == 0x10 || in.op == 0x28 || in.op == 0x6F);
+    }
+
+  /// movaps (movups, movapd, movupd, movdqa, movdqu, and the non-temporal movntps, movntpd, movntdq) memory <- register
+  static inline bool isStore(const InstructionInfo& in)
+    {
+      return in.form == kFormMR && in.map == 1 &&
+        (((in.op == 0x11 || in.op == 0x29 || in.op == 0x2B) && in.pp <= 1) ||
+          (in.op == 0x7F && (in.pp == 1 || in.pp == 2)) || (in.op == 0xE7 && in.pp == 1));
+    }
+
+  /// the index of the instruction that starts at offset (or the number of instructions for the end of the code), or
+  /// -1 if offset is within an instruction. When align() wrote no NOPs, this is the instruction after it.
+  inline int32_t instructionAt(uint32_t offset, uint32_t code_size) const
+    {
+      const std::vector<Instruction>& code = m_instructions;
+      if (offset == code_size)
+        return int32_t(code.size());
+      const size_t k = instructionContaining(offset);
+      return (k < code.size() && code[k].offset == offset) ? int32_t(k) : -1;
+    }
+
+  /// the index of the instruction that contains offset
+  inline size_t instructionContaining(uint32_t offset) const
+    {
+      const std::vector<Instruction>& code = m_instructions;
+      return size_t(std::upper_bound(code.begin(), code.end(), offset, InstructionOrder()) - code.begin()) - 1;
+    }
+
+  struct InstructionOrder
+  {
+    bool operator () (const Instruction& a, uint32_t offset) const
+      { return a.offset < offset; }
+    bool operator () (uint32_t offset, const Instruction& a) const
+      { return offset < a.offset; }
+  };
+
+  /// the next instruction that hasn't been removed, if it always executes straight after instruction i. Otherwise
+  /// (a label or jump lands between them, or there is no next instruction), the number of instructions.
+  inline size_t nextInstruction(size_t i) const
+    {
+      const std::vector<Instruction>& code = m_instructions;
+      for (size_t j = i + 1; j < code.size(); ++j)
+      {
+        if (code[j].isTarget)
+          break;
+        if (!code[j].removed)
+          return j;
+      }
+      return code.size();
+    }
+
+  /// runs the optimisation passes over the recorded instructions, and lays out the code again
+  inline void optimise()
+    {
+      const uint32_t code_size = uint32_t(self().numBytes());
+      if (m_instructions.empty() || self().overflowed() || !findTargets(code_size))
+        return;
+      m_peepholeStats.numInstructions = uint32_t(m_instructions.size());
+      if (m_optimisations & kRemoveNops)
+        removeNops();
+      if (m_optimisations & kForwardStores)
+        forwardStores();
+      if (m_optimisations & kRemoveRedundantMoves)
+        removeMoves();
+      if (m_optimisations & kFuseMultiplyAdd)
+        fuseMultiplyAdds();
+      std::vector<uint32_t> order(m_instructions.size());
+      for (size_t i = 0; i < order.size(); ++i)
+        order[i] = uint32_t(i);
+      if (m_optimisations & kSchedule)
+        schedule(order);
+      layout(code_size, order);
+    }
+
+  /// sizes the instructions, and finds where the labels & jumps land. Returns false if the code can't be moved.
+  inline bool findTargets(uint32_t code_size)
+    {
+      std::vector<Instruction>& code = m_instructions;
+      for (size_t i = 0; i < code.size(); ++i)
+        code[i].size = (i + 1 < code.size() ? code[i + 1].offset : code_size) - code[i].offset;
+      for (size_t l = 0; l < m_labelLocations.size(); ++l)
+      {
+        const int32_t k = instructionAt(m_labelLocations[l], code_size);
+        if (k < 0)
+          return false;
+        if (size_t(k) < code.size())
+          code[k].isTarget = true;
+      }
+      size_t ref = 0;
+      for (size_t i = 0; i < code.size(); ++i)
+      {
+        Instruction& in = code[i];
+        const uint32_t end = in.offset + in.size;
+        while (ref < m_labelRefs.size() && m_labelRefs[ref].offset < end - 4)
+          ++ref;
+        const bool label_ref = ref < m_labelRefs.size() && m_labelRefs[ref].offset == end - 4;
+
+        // a call rel32 that isn't to a procedure can't move
+        if (in.info.form == kFormOther && in.info.op == 0xE8 && !label_ref)
+          return false;
+        if (in.info.form != kFormJump)
+          continue;
+        const uint32_t target = label_ref ? m_labelLocations[m_labelRefs[ref].label] : end + uint32_t(in.info.disp);
+        const int32_t k = instructionAt(target, code_size);
+        if (k < 0)
+          return false;
+        in.target = k;
+        if (size_t(k) < code.size())
+          code[k].isTarget = true;
+      }
+      return true;
+    }
+
+  /// true if the flags set by instruction i may be read
+  inline bool flagsUsed(size_t i) const
+    {
+      const std::vector<Instruction>& code = m_instructions;
+      for (size_t k = i + 1; k < code.size(); ++k)
+      {
+        const InstructionInfo& in = code[k].info;
+        if (code[k].removed)
+          continue;
+        if (readsFlags(in))
+          return true;
+        if (writesFlags(in))
+          return false;
+      }
+      return false;
+    }
+
+  /// jcc, adc, sbb, cmovcc & setcc. inc & dec (which leave CF alone), and a shift by CL (which may shift by 0) are
+  /// treated as reading the flags they might not write.
+  static inline bool readsFlags(const InstructionInfo& in)
+    {
+      switch (in.form)
+      {
+      case kFormJump:
+        return true;
+      case kFormImm:
+        return in.op == 2 || in.op == 3;
+      case kFormGprOnly:
+        return in.op == 0xFF;
+      case kFormGpr:
+      case kFormGprRR:
+        return in.map ? (in.op & 0xF0) == 0x40 : (in.op == 0x13 || in.op == 0x1B);
+      case kFormGprUnary:
+        return in.map || in.op == 0xD3;
+      }
+      return false;
+    }
+
+  /// true if every flag read by a later instruction is written (the ALU ops, test, imul, neg, and a shift that isn't by
+  /// 0), or the flags aren't read afterwards (ret, and calls)
+  static inline bool writesFlags(const InstructionInfo& in)
+    {
+      switch (in.form)
+      {
+      case kFormImm:
+      case kFormRet:
+        return true;
+      case kFormOther:
+        return in.map == 0;
+      case kFormGpr:
+      case kFormGprRR:
+        return in.map ? in.op == 0xAF : ((in.op & 0xC7) == 0x03 || in.op == 0x85 || in.op == 0x69 || in.op == 0x6B);
+      case kFormGprUnary:
+        return !in.map && (in.op == 0xF7 ? in.reg != 2 : ((in.op == 0xC1 || in.op == 0xD1) && (in.disp & 63) != 0));
+      }
+      return false;
+    }
+
+  /// true if YMM register r is written before it is read, on every path from the end of instruction i
+  inline bool isDeadAfter(size_t i, uint8_t r) const
+    {
+      const std::vector<Instruction>& code = m_instructions;
+      std::vector<bool> visited(code.size(), false);
+      std::vector<size_t> paths(1, i + 1);
+      while (!paths.empty())
+      {
+        size_t k = paths.back();
+        paths.pop_back();
+        for (bool done = false; !done && k < code.size() && !visited[k]; ++k)
+        {
+          visited[k] = true;
+          const InstructionInfo& in = code[k].info;
+          if (code[k].removed)
+            continue;
+          switch (in.form)
+          {
+          case kFormRR:
+          case kFormRM:
+          case kFormMR:
+            {
+              const uint32_t sources = numSources(in);
+              const bool reads_rm = in.form == kFormRR && in.rm == r;
+              if (sources ? ((sources == 2 && in.vvvv == r) || reads_rm) : (in.reg == r || in.vvvv == r || reads_rm))
+                return false;
+              done = sources && in.reg == r;
+            }
+            break;
+          case kFormJump:
+            paths.push_back(size_t(code[k].target));
+            break;
+          case kFormRet:
+            // YMM0 may hold the result of a procedure
+            if (r == YMM0)
+              return false;
+            done = true;
+            break;
+          case kFormGather:
+            if (in.reg == r || in.vvvv == r || in.index == r)
+              return false;
+            break;
+          case kFormOther:
+            return false;
+          default:
+            break;
+          }
+        }
+      }
+      return true;
+    }
+
+  /// re-encodes a VEX instruction, reading register s in place of t
+  inline void replaceSource(Instruction& in, uint8_t t, uint8_t s)
+    {
+      const InstructionInfo& info = in.info;
+      const uint8_t vvvv = (numSources(info) == 2 && info.vvvv == t) ? s : info.vvvv;
+      Replacement r;
+      if (info.form == kFormRR)
+        r.encodeRR(info.pp, info.op, info.reg, vvvv, info.rm == t ? s : info.rm, info.L);
+      else
+      if (info.scale || (info.rm & 7) == 4)
+      {
+        // only a Mem can encode an index register (or a base of RSP or R12)
+        const Reg index = info.scale ? Reg(info.index) : RSP;
+        const Mem m = { Reg(info.rm), index, uint8_t(info.scale ? info.scale : 1), info.disp };
+        r.encodeRM(info.pp, info.op, info.reg, vvvv, m, info.L);
+      }
+      else
+        r.encodeRM(info.pp, info.op, info.reg, vvvv, Reg(info.rm), info.disp, info.L);
+      if (info.op == 0xC2 || info.op == 0xC6)
+        r.emit8(in.numBytes ? in.bytes[in.numBytes - 1] : self().bytecode()[in.offset + in.size - 1]);
+      r.apply(in);
+    }
+
+  /// lea r, [r + 0], mov r, r, and add/sub r, 0
+  inline void removeNops()
+    {
+      std::vector<Instruction>& code = m_instructions;
+      for (size_t i = 0; i < code.size(); ++i)
+      {
+        const InstructionInfo& in = code[i].info;
+        if ((in.form == kFormGpr && in.op == 0x8D && in.reg == in.rm && in.disp == 0 && !in.scale) ||
+            (in.form == kFormGprMove && in.reg == in.rm) ||
+            (in.form == kFormImm && (in.op == 0 || in.op == 5) && in.disp == 0 && !flagsUsed(i)))
+        {
+          code[i].removed = true;
+          ++m_peepholeStats.nopsRemoved;
+        }
+      }
+    }
+
+  /// movaps [base + disp], x followed by movaps y, [base + disp] becomes movaps y, x
+  inline void forwardStores()
+    {
+      std::vector<Instruction>& code = m_instructions;
+      for (size_t i = 0; i < code.size(); ++i)
+      {
+        const InstructionInfo& store = code[i].info;
+        if (code[i].removed || !isStore(store))
+          continue;
+        const size_t j = nextInstruction(i);
+        if (j == code.size())
+          continue;
+        const InstructionInfo& load = code[j].info;
+        if (!isMove(load, kFormRM) || load.rm != store.rm || load.disp != store.disp || load.L != store.L ||
+            load.index != store.index || load.scale != store.scale)
+          continue;
+        if (load.reg == store.reg && load.L)
+          code[j].removed = true;
+        else
+        {
+          Replacement r;
+          r.encodeRR(load.pp, load.op, load.reg, 0, store.reg, load.L);
+          r.apply(code[j]);
+        }
+        ++m_peepholeStats.loadsForwarded;
+      }
+    }
+
+  /// movaps x, x, and movaps t, s followed by an op that overwrites t (which then reads s in place of t)
+  inline void removeMoves()
+    {
+      std::vector<Instruction>& code = m_instructions;
+      for (size_t i = 0; i < code.size(); ++i)
+      {
+        const InstructionInfo& move = code[i].info;
+        if (code[i].removed || !isMove(move, kFormRR) || !move.L)
+          continue;
+        const size_t j = nextInstruction(i);
+        if (move.reg != move.rm)
+        {
+          if (j == code.size() || code[j].info.map != 1 || !numSources(code[j].info) || code[j].info.reg != move.reg)
+            continue;
+          replaceSource(code[j], move.reg, move.rm);
+        }
+        code[i].removed = true;
+        ++m_peepholeStats.movesRemoved;
+      }
+    }
+
+  /// mulps t, a, b followed by addps d, d, t (when t is dead) or addps t, t, c (when t is a or b)
+  inline void fuseMultiplyAdds()
+    {
+      std::vector<Instruction>& code = m_instructions;
+      for (size_t i = 0; i < code.size(); ++i)
+      {
+        const InstructionInfo& mul = code[i].info;
+        if (code[i].removed || mul.form != kFormRR || mul.map != 1 || mul.op != 0x59 || mul.pp > 1)
+          continue;
+        const size_t j = nextInstruction(i);
+        if (j == code.size())
+          continue;
+        const InstructionInfo& add = code[j].info;
+        const uint8_t t = mul.reg, a = mul.vvvv, b = mul.rm;
+        if (add.form != kFormRR || add.map != 1 || add.op != 0x58 || add.pp != mul.pp || add.L != mul.L ||
+            (add.vvvv == t) == (add.rm == t))
+          continue;
+        const uint8_t c = add.vvvv == t ? add.rm : add.vvvv, d = add.reg;
+        Replacement r;
+        if (d == c && isDeadAfter(j, t))
+          r.encodeRR3(1, 0xB8, d, a, b, mul.pp, mul.L, 2);    // vfmadd231ps d, a, b
+        else
+        if (d == t && (t == a || t == b))
+          r.encodeRR3(1, 0xA8, t, t == a ? b : a, c, mul.pp, mul.L, 2);   // vfmadd213ps t, b, c
+        else
+          continue;
+        r.apply(code[j]);
+        code[i].removed = true;
+        ++m_peepholeStats.multiplyAddsFused;
+      }
+    }
+
+  /// what the scheduler needs to know about the execution of an instruction
+  enum ExecutionClass
+  {
+    kExecMove, kExecLogic, kExecAdd, kExecMul, kExecFma, kExecDivide, kExecSqrt, kExecRcp, kExecConvert, kExecShuffle,
+    kExecPermute, kExecIntMul, kExecLoad, kExecStore, kExecGather, kNumExecClasses
+  };
+
+  /// the execution units an instruction may be issued to (each with one or more pipes)
+  enum ExecutionUnit
+  {
+    kUnitAlu, kUnitFp, kUnitShuffle, kUnitLoad, kUnitStore, kUnitDivider, kUnitGather, kNumUnits
+  };
+
+  struct Timing
+  {
+    uint8_t latency;
+    uint8_t busy;         ///< the cycles before the pipe accepts another instruction
+    uint8_t unit;
+  };
+
+  static inline const Timing& timing(Microarchitecture target, uint32_t exec)
+    {
+      static const Timing timings[3][kNumExecClasses] =
+      {
+        // move      logic      add        mul        fma        divide       sqrt         rcp
+        // convert   shuffle    permute    int mul    load       store      gather
+        { // Haswell
+          { 1, 1, kUnitAlu }, { 1, 1, kUnitAlu }, { 3, 1, kUnitFp }, { 5, 1, kUnitFp }, { 5, 1, kUnitFp },
+          { 21, 14, kUnitDivider }, { 21, 14, kUnitDivider }, { 7, 2, kUnitFp },
+          { 3, 1, kUnitFp }, { 1, 1, kUnitShuffle }, { 3, 1, kUnitShuffle }, { 10, 1, kUnitFp },
+          { 6, 1, kUnitLoad }, { 1, 1, kUnitStore }, { 22, 12, kUnitGather }
+        },
+        { // Skylake
+          { 1, 1, kUnitAlu }, { 1, 1, kUnitAlu }, { 4, 1, kUnitFp }, { 4, 1, kUnitFp }, { 4, 1, kUnitFp },
+          { 11, 5, kUnitDivider }, { 12, 6, kUnitDivider }, { 4, 1, kUnitFp },
+          { 4, 1, kUnitFp }, { 1, 1, kUnitShuffle }, { 3, 1, kUnitShuffle }, { 10, 1, kUnitFp },
+          { 7, 1, kUnitLoad }, { 1, 1, kUnitStore }, { 22, 5, kUnitGather }
+        },
+        { // Zen 2
+          { 1, 1, kUnitAlu }, { 1, 1, kUnitAlu }, { 3, 1, kUnitFp }, { 3, 1, kUnitFp }, { 5, 1, kUnitFp },
+          { 10, 7, kUnitDivider }, { 20, 14, kUnitDivider }, { 5, 1, kUnitFp },
+          { 4, 1, kUnitFp }, { 1, 1, kUnitShuffle }, { 3, 1, kUnitShuffle }, { 4, 1, kUnitFp },
+          { 8, 1, kUnitLoad }, { 1, 1, kUnitStore }, { 27, 9, kUnitGather }
+        }
+      };
+      return timings[target][exec];
+    }
+
+  /// the number of pipes in each execution unit
+  static inline uint32_t numPipes(Microarchitecture target, uint32_t unit)
+    {
+      static const uint8_t pipes[3][kNumUnits] =
+      {
+        // alu fp shuffle load store divider gather
+        { 3, 2, 1, 2, 1, 1, 1 },    // Haswell
+        { 3, 2, 1, 2, 1, 1, 1 },    // Skylake
+        { 4, 2, 2, 2, 1, 1, 1 },    // Zen 2
+      };
+      return pipes[target][unit];
+    }
+
+  /// the ExecutionClass of an instruction the scheduler may move, or kNumExecClasses if it can't be moved
+  static inline uint32_t executionClass(const InstructionInfo& in)
+    {
+      if (in.form == kFormGather)
+        return kExecGather;
+      if (in.form == kFormPrefetch)
+        return kExecLoad;
+      if (isStore(in) || (in.form == kFormMR && in.map == 2))
+        return kExecStore;
+      if (isFma(in) || (in.map == 3 && in.op == 0x40 && numSources(in)))
+        return kExecFma;
+      if (!numSources(in))
+        return kNumExecClasses;
+      if (isMove(in, in.form) || (in.map == 2 && (in.op == 0x2C || in.op == 0x2D || in.op == 0x8C)))
+        return in.form == kFormRM ? kExecLoad : kExecMove;
+      if (in.map == 2)
+      {
+        switch (in.op)
+        {
+        case 0x28: case 0x40:
+          return kExecIntMul;
+        case 0x13:
+          return in.form == kFormRM ? kExecLoad : kExecConvert;
+        case 0x16: case 0x18: case 0x19: case 0x1A: case 0x36: case 0x58: case 0x59: case 0x5A: case 0x78: case 0x79:
+          return in.form == kFormRM ? kExecLoad : kExecPermute;
+        case 0x00: case 0x01: case 0x02: case 0x03: case 0x04: case 0x05: case 0x06: case 0x07: case 0x0C:
+          return kExecShuffle;
+        }
+        return kExecLogic;
+      }
+      if (in.map == 3)
+      {
+        switch (in.op)
+        {
+        case 0x00: case 0x01: case 0x06: case 0x18: case 0x38: case 0x46:
+          return kExecPermute;
+        case 0x08: case 0x09: case 0x0A: case 0x0B:
+          return kExecConvert;
+        }
+        return kExecShuffle;
+      }
+      switch (in.op)
+      {
+      case 0x58: case 0x5C: case 0x5D: case 0x5F: case 0xC2:
+        return kExecAdd;
+      case 0x59:
+        return kExecMul;
+      case 0x5E:
+        return kExecDivide;
+      case 0x51:
+        return kExecSqrt;
+      case 0x52: case 0x53:
+        return kExecRcp;
+      case 0x5A: case 0x5B:
+        return kExecConvert;
+      case 0x14: case 0x15: case 0xC6:
+        return kExecShuffle;
+      }
+      return kExecLogic;
+    }
+
+  /// an instruction in a block being scheduled
+  struct Node
+  {
+    uint32_t index;           ///< in m_instructions
+    uint32_t reads;           ///< YMM registers read
+    uint32_t writes;          ///< YMM registers written
+    uint8_t memory;           ///< 0 = none, 1 = load, 2 = store
+    uint8_t unit;
+    uint8_t busy;
+    uint8_t latency;
+    uint32_t height;          ///< the longest chain of latencies from the start of this instruction to the end of the block
+    uint32_t numPreds;
+    int32_t earliest;         ///< the earliest cycle the inputs are ready
+  };
+
+  /// an edge from an earlier node to a later node that must stay after it
+  struct Dependency
+  {
+    uint32_t from;
+    uint32_t to;
+    uint32_t latency;
+  };
+
+  inline Node makeNode(uint32_t index, uint32_t exec) const
+    {
+      const InstructionInfo& in = m_instructions[index].info;
+      const Timing& t = timing(m_target, exec);
+      Node node;
+      node.index = index;
+      node.reads = 0;
+      node.writes = in.form == kFormPrefetch ? 0 : 1u << in.reg;
+      node.memory = in.form == kFormRM || in.form == kFormGather ? 1 : 0;
+      node.unit = t.unit;
+      node.busy = t.busy;
+      node.latency = uint8_t(t.latency + (node.memory && exec != kExecLoad && exec != kExecGather ?
+        timing(m_target, kExecLoad).latency : 0));
+      node.height = 0;
+      node.numPreds = 0;
+      node.earliest = 0;
+      if (exec == kExecStore)
+      {
+        node.reads = 1u << in.reg | (in.map == 2 ? 1u << in.vvvv : 0);
+        node.writes = 0;
+        node.memory = 2;
+      }
+      else
+      if (exec == kExecGather)
+      {
+        node.reads = 1u << in.reg | 1u << in.vvvv | 1u << in.index;
+        node.writes |= 1u << in.vvvv;
+      }
+      else
+      {
+        if (in.form == kFormRR)
+          node.reads |= 1u << in.rm;
+        if (numSources(in) == 2 || exec == kExecFma)
+          node.reads |= 1u << in.vvvv;
+        if (isFma(in))
+          node.reads |= 1u << in.reg;
+      }
+      return node;
+    }
+
+  /// true if memory operations a & b may touch the same memory, and one of them is a store
+  inline bool mayAlias(const Node& a, const Node& b) const
+    {
+      if (!a.memory || !b.memory || (a.memory == 1 && b.memory == 1))
+        return false;
+      const InstructionInfo& x = m_instructions[a.index].info;
+      const InstructionInfo& y = m_instructions[b.index].info;
+      if (x.form == kFormGather || y.form == kFormGather || x.rm != y.rm || x.index != y.index || x.scale != y.scale)
+        return true;
+      const int64_t distance = int64_t(x.disp) - int64_t(y.disp);
+      return distance > -32 && distance < 32;
+    }
+
+  /// the cycles taken by the nodes, issued in order (in the order given), and the cycle each is issued in
+  inline uint32_t simulate(const std::vector<Node>& nodes, const std::vector<Dependency>& deps,
+                           const std::vector<uint32_t>& sequence, std::vector<int32_t>& issued) const
+    {
+      std::vector<int32_t> pipes(kNumUnits * 4, 0);
+      int32_t cycle = 0, end = 0;
+      uint32_t width = 0;
+      issued.assign(nodes.size(), -1);
+      for (size_t s = 0; s < sequence.size(); ++s)
+      {
+        const uint32_t k = sequence[s];
+        const Node& node = nodes[k];
+        int32_t t = cycle;
+        for (size_t d = 0; d < deps.size(); ++d)
+        {
+          if (deps[d].to == k && issued[deps[d].from] + int32_t(deps[d].latency) > t)
+            t = issued[deps[d].from] + int32_t(deps[d].latency);
+        }
+        int32_t* pipe = &pipes[node.unit * 4];
+        const uint32_t num_pipes = numPipes(m_target, node.unit);
+        uint32_t best = 0;
+        for (uint32_t p = 1; p < num_pipes; ++p)
+        {
+          if (pipe[p] < pipe[best])
+            best = p;
+        }
+        if (pipe[best] > t)
+          t = pipe[best];
+        if (t > cycle)
+        {
+          cycle = t;
+          width = 0;
+        }
+        if (++width > 4)
+        {
+          ++cycle;
+          width = 1;
+        }
+        issued[k] = cycle;
+        pipe[best] = cycle + node.busy;
+        if (cycle + int32_t(node.latency) > end)
+          end = cycle + int32_t(node.latency);
+      }
+      return uint32_t(end);
+    }
+
+  /// list schedules the instructions in [begin, end), writing the new order to order[begin, end)
+  inline void scheduleBlock(uint32_t begin, uint32_t end, std::vector<uint32_t>& order)
+    {
+      std::vector<Node> nodes;
+      std::vector<uint32_t> removed;
+      for (uint32_t i = begin; i < end; ++i)
+      {
+        if (m_instructions[i].removed)
+          removed.push_back(i);
+        else
+          nodes.push_back(makeNode(i, executionClass(m_instructions[i].info)));
+      }
+      const uint32_t n = uint32_t(nodes.size());
+      if (n < 2)
+        return;
+
+      // read after write carries the latency of the write. Write after read, and write after write, only order.
+      std::vector<Dependency> deps;
+      for (uint32_t j = 0; j < n; ++j)
+      {
+        for (uint32_t i = 0; i < j; ++i)
+        {
+          const Node& a = nodes[i];
+          const Node& b = nodes[j];
+          const bool raw = (a.writes & b.reads) != 0 || (a.memory == 2 && b.memory == 1 && mayAlias(a, b));
+          if (raw || (a.reads & b.writes) || (a.writes & b.writes) || mayAlias(a, b))
+          {
+            const Dependency dep = { i, j, raw ? a.latency : 0u };
+            deps.push_back(dep);
+            ++nodes[j].numPreds;
+          }
+        }
+      }
+      for (uint32_t i = n; i-- > 0; )
+      {
+        nodes[i].height = nodes[i].latency;
+        for (size_t d = 0; d < deps.size(); ++d)
+        {
+          if (deps[d].from == i && deps[d].latency + nodes[deps[d].to].height > nodes[i].height)
+            nodes[i].height = deps[d].latency + nodes[deps[d].to].height;
+        }
+      }
+
+      // each cycle, issue the nodes whose inputs are ready, greatest height first (the earliest written, if there's a
+      // tie). If none are ready, issue the one that will be ready soonest.
+      std::vector<uint32_t> sequence;
+      std::vector<bool> done(n, false);
+      std::vector<int32_t> issued;
+      int32_t cycle = 0;
+      uint32_t width = 0;
+      while (sequence.size() < n)
+      {
+        uint32_t best = n;
+        for (uint32_t i = 0; i < n; ++i)
+        {
+          if (done[i] || nodes[i].numPreds)
+            continue;
+          if (best == n)
+          {
+            best = i;
+            continue;
+          }
+          const Node& a = nodes[i];
+          const Node& b = nodes[best];
+          const bool a_ready = a.earliest <= cycle, b_ready = b.earliest <= cycle;
+          if (a_ready != b_ready ? a_ready :
+              a_ready ? a.height > b.height : (a.earliest < b.earliest || (a.earliest == b.earliest && a.height > b.height)))
+            best = i;
+        }
+        if (nodes[best].earliest > cycle)
+        {
+          cycle = nodes[best].earliest;
+          width = 0;
+        }
+        if (++width > 4)
+        {
+          ++cycle;
+          width = 1;
+        }
+        done[best] = true;
+        sequence.push_back(best);
+        for (size_t d = 0; d < deps.size(); ++d)
+        {
+          if (deps[d].from != best)
+            continue;
+          Node& to = nodes[deps[d].to];
+          --to.numPreds;
+          if (cycle + int32_t(deps[d].latency) > to.earliest)
+            to.earliest = cycle + int32_t(deps[d].latency);
+        }
+      }
+
+      std::vector<uint32_t> written(n);
+      for (uint32_t i = 0; i < n; ++i)
+        written[i] = i;
+      const uint32_t before = simulate(nodes, deps, written, issued);
+      const uint32_t after = simulate(nodes, deps, sequence, issued);
+      ++m_scheduleStats.numBlocks;
+      m_scheduleStats.cyclesBefore += before;
+      if (after >= before)
+      {
+        m_scheduleStats.cyclesAfter += before;
+        return;
+      }
+      m_scheduleStats.cyclesAfter += after;
+      ++m_scheduleStats.numReordered;
+      for (uint32_t i = 0; i < n; ++i)
+        order[begin + i] = nodes[sequence[i]].index;
+      for (size_t i = 0; i < removed.size(); ++i)
+        order[begin + n + i] = removed[i];
+    }
+
+  /// splits the code into blocks the scheduler may reorder, and schedules each one
+  inline void schedule(std::vector<uint32_t>& order)
+    {
+      const std::vector<Instruction>& code = m_instructions;
+      uint32_t begin = 0;
+      for (uint32_t i = 0; i <= code.size(); ++i)
+      {
+        const bool movable = i < code.size() && (code[i].removed || executionClass(code[i].info) != kNumExecClasses);
+        if (movable && !code[i].isTarget)
+          continue;
+        if (i > begin)
+          scheduleBlock(begin, i, order);
+        begin = movable ? i : i + 1;
+      }
+    }
+
+  /// the NOPs needed before offset, to reach a multiple of boundary (a power of 2)
+  static inline uint32_t padding(uint32_t offset, uint32_t boundary)
+    { return (0u - offset) & (boundary - 1); }
+
+  /// add, and, sub, cmp, test, inc & dec, which fuse with a jcc that follows them
+  static inline bool fusesWithJump(const InstructionInfo& in)
+    {
+      return (in.form == kFormImm && (in.op == 0 || in.op == 4 || in.op == 5 || in.op == 7)) ||
+        (in.form == kFormGprOnly && in.op == 0xFF) ||
+        ((in.form == kFormGprRR || in.form == kFormGpr) && !in.map &&
+          (in.op == 0x03 || in.op == 0x23 || in.op == 0x2B || in.op == 0x3B || in.op == 0x85)) ||
+        (in.form == kFormGprUnary && in.op == 0xF7 && in.reg == 0);
+    }
+
+  /// marks the positions that kAlignLoops aligns: the targets of backward jumps, and of calls to procedures
+  inline void findLoops(uint32_t code_size, std::vector<bool>& aligned) const
+    {
+      const std::vector<Instruction>& code = m_instructions;
+      for (size_t i = 0; i < code.size(); ++i)
+      {
+        if (code[i].info.form == kFormJump && size_t(code[i].target) <= i)
+          aligned[code[i].target] = true;
+      }
+      for (size_t r = 0; r < m_labelRefs.size(); ++r)
+      {
+        const InstructionInfo& in = code[instructionContaining(m_labelRefs[r].offset)].info;
+        const int32_t k = instructionAt(m_labelLocations[m_labelRefs[r].label], code_size);
+        if (in.form == kFormOther && in.op == 0xE8 && size_t(k) < code.size())
+          aligned[k] = true;
+      }
+    }
+
+  /// writes the instructions that remain back into the code (instruction order[p] at position p), and moves the labels
+  /// and references with them. Labels and jumps never move, so a label bound to instruction k stays at position k.
+  inline void layout(uint32_t code_size, const std::vector<uint32_t>& order)
+    {
+      std::vector<Instruction>& code = m_instructions;
+      const size_t n = code.size();
+      std::vector<uint32_t> sizes(n), offsets(n + 1), starts(n + 1), positions(n);
+      std::vector<bool> aligned(n, false);
+      for (size_t p = 0; p < n; ++p)
+        positions[order[p]] = uint32_t(p);
+      for (size_t i = 0; i < n; ++i)
+      {
+        sizes[i] = code[i].removed ? 0 : code[i].numBytes ? code[i].numBytes : code[i].size;
+        if (code[i].info.form == kFormJump && (m_optimisations & kRelaxBranches))
+          sizes[i] = 2;
+      }
+      if (m_optimisations & kAlignLoops)
+        findLoops(code_size, aligned);
+
+      // With kRelaxBranches, every jump starts out as a jcc rel8, otherwise jumps keep the size they were emitted with.
+      // Any jump that doesn't reach its target with a rel8 then becomes a jcc rel32, which may push other targets out
+      // of reach, so this repeats until nothing changes (the jumps only ever grow, so it always finishes). The padding
+      // before each position (from offsets[p] to starts[p]) is worked out again each time.
+      for (bool changed = true; changed; )
+      {
+        changed = false;
+        offsets[0] = 0;
+        for (size_t p = 0; p < n; ++p)
+        {
+          const uint32_t i = order[p];
+          uint32_t pad = 0;
+          if (code[i].info.form == kFormAlign)
+          {
+            // the NOPs of align() are padding too, so a label bound just before them lands after them
+            const uint32_t boundary = uint32_t(code[i].info.disp);
+            sizes[i] = 0;
+            pad = padding(offsets[p], aligned[p] && boundary < 32 ? 32 : boundary);
+          }
+          else
+          if (aligned[p])
+            pad = padding(offsets[p], 32);
+          else
+          if ((m_optimisations & kAlignJumps) && !code[i].removed)
+          {
+            uint32_t length = code[i].info.form == kFormJump ? sizes[i] : 0;
+            if (p + 1 < n && code[order[p + 1]].info.form == kFormJump && !code[order[p + 1]].isTarget &&
+                fusesWithJump(code[i].info))
+              length = sizes[i] + sizes[order[p + 1]];
+            if (length && (offsets[p] & 31) + length >= 32)
+              pad = padding(offsets[p], 32);
+          }
+          starts[p] = offsets[p] + pad;
+          offsets[p + 1] = starts[p] + sizes[i];
+        }
+        starts[n] = offsets[n];
+        for (size_t i = 0; i < n; ++i)
+        {
+          if (code[i].info.form != kFormJump || sizes[i] != 2)
+            continue;
+          const int32_t rel = int32_t(starts[code[i].target] - offsets[i + 1]);
+          if (rel < -128 || rel > 127)
+          {
+            sizes[i] = 6;
+            changed = true;
+          }
+        }
+      }
+
+      std::vector<uint8_t> bytes(offsets[n] + 1);
+      const uint8_t* original = self().bytecode();
+      for (size_t p = 0; p < n; ++p)
+      {
+        const size_t i = order[p];
+        const Instruction& in = code[i];
+        uint8_t* out = writeNops(&bytes[offsets[p]], starts[p] - offsets[p]);
+        m_peepholeStats.paddingBytes += starts[p] - offsets[p];
+        if (in.removed || in.info.form == kFormAlign)
+          continue;
+        if (in.info.form == kFormJump)
+        {
+          const int32_t rel = int32_t(starts[in.target] - offsets[i + 1]);
+          if (sizes[i] == 2)
+          {
+            out[0] = uint8_t(0x70 | in.info.op);
+            out[1] = uint8_t(rel);
+          }
+          else
+          {
+            out[0] = 0x0F;
+            out[1] = uint8_t(0x80 | in.info.op);
+            write32(out + 2, uint32_t(rel));
+          }
+        }
+        else
+        if (in.numBytes)
+          memcpy(out, in.bytes, in.numBytes);
+        else
+          memcpy(out, original + in.offset, in.size);
+      }
+      for (size_t i = 0; i < n; ++i)
+      {
+        m_peepholeStats.numRemoved += code[i].removed;
+        m_peepholeStats.jumpsShortened += code[i].info.form == kFormJump && code[i].size == 6 && sizes[i] == 2;
+      }
+
+      // the jumps to labels have been written, so only the references from calls to procedures are left for end()
+      for (size_t l = 0; l < m_labelLocations.size(); ++l)
+        m_labelLocations[l] = starts[instructionAt(m_labelLocations[l], code_size)];
+      size_t num_refs = 0;
+      for (size_t r = 0; r < m_labelRefs.size(); ++r)
+      {
+        const size_t k = instructionContaining(m_labelRefs[r].offset);
+        if (code[k].info.form == kFormJump)
+          continue;
+        m_labelRefs[num_refs].label = m_labelRefs[r].label;
+        m_labelRefs[num_refs++].offset = starts[positions[k]] + (m_labelRefs[r].offset - code[k].offset);
+      }
+      m_labelRefs.resize(num_refs);
+      for (size_t r = 0; r < m_constantRefs.size(); ++r)
+      {
+        const size_t k = instructionContaining(m_constantRefs[r].offset - 1);
+        m_constantRefs[r].offset = starts[positions[k]] + (m_constantRefs[r].offset - code[k].offset);
+      }
+
+      self().rewind();
+      for (uint32_t written = 0; written < offsets[n]; )
+      {
+        const uint32_t max_bytes = EncoderBase<Derived>::kMaxReserve;
+        const uint32_t num_bytes = offsets[n] - written < max_bytes ? offsets[n] - written : max_bytes;
+        uint8_t* p = self().reserve(num_bytes);
+        memcpy(p, &bytes[written], num_bytes);
+        self().commit(p + num_bytes);
+        written += num_bytes;
+      }
+    }
+
+  inline LabelId namedLabel(LabelNames& names, const char* name)
+    {
+      typename LabelNames::iterator it = names.find(name);
+      if (it == names.end())
+        it = names.insert(typename LabelNames::value_type(name, new_label())).first;
+      return it->second;
+    }
+
+  std::vector<Constant> m_constants;
+  std::vector<ConstantRef> m_constantRefs;
+  std::vector<uint32_t> m_labelLocations;
+  std::vector<LabelRef> m_labelRefs;
+  LabelNames m_labelNames;
+  LabelNames m_procedureNames;
+  const void* m_runtimeAddress;
+  CallingConvention m_convention;
+  Frame m_frame;
+  std::vector<Virtual> m_virtuals;
+  std::vector<VirtualUse> m_virtualUses;
+  uint32_t m_numVirtuals;             ///< virtual registers created so far, in the second pass
+  uint8_t m_gprScratch[kMaxScratch];
+  uint8_t m_ymmScratch[kMaxScratch];
+  uint32_t m_numGprScratch;
+  uint32_t m_numYmmScratch;
+  Pending m_pending[2 * kMaxScratch];
+  uint32_t m_numPending;
+  uint32_t m_pendingEnd;              ///< the end of the last scratch load
+  uint32_t m_optimisations;           ///< Optimisation flags
+  Microarchitecture m_target;
+  std::vector<Instruction> m_instructions;
+  PeepholeStats m_peepholeStats;
+  ScheduleStats m_scheduleStats;
+  bool m_zeroUpper;                   ///< see setZeroUpper
+  bool m_upperDirty;                  ///< a 256bit instruction may have run since the last vzeroupper
+  bool m_upperUsed;                   ///< a 256bit instruction has been emitted since begin()
+  bool m_inProcedure;                 ///< a procedure has been bound
+  std::vector<uint32_t> m_procedures; ///< the labels called with call_procedure
+  std::vector<uint32_t> m_zeroUppers; ///< offsets of the vzeroupper inserted before each ret()
+  ConstantPool* m_pool;
+  bool m_broadcast;                   ///< set1_ps etc store a single element in the pool
+  std::vector<PoolConstant> m_poolConstants;
+  std::vector<ConstantRef> m_poolRefs;  ///< references to the pool, kept after end() for linkConstants()
+  bool m_unlinked;                    ///< see needsLinking
+  int32_t m_prefetchDistance;         ///< see setPrefetchDistance
+  PrefetchHint m_prefetchHint;
+};
+
+/// \brief  An emitter that writes into a fixed size buffer provided by the caller. Unlike the DLL, writes never run past
+///         the end of the buffer. If it fills up, the remaining code is discarded and overflowed() returns true.
+class Emitter : public EmitterBase<Emitter>
+{
+  friend class EncoderBase<Emitter>;
+  friend class EmitterBase<Emitter>;
+public:
+
+  /// \brief  ctor
+  /// \param  buffer the memory to write the machine code into
+  /// \param  num_bytes the size of the buffer
+  /// \param  convention the calling convention of the generated code
+  inline Emitter(void* buffer, size_t num_bytes, CallingConvention convention = kWin64)
+    : EmitterBase<Emitter>(convention), m_begin((uint8_t*)buffer), m_cursor((uint8_t*)buffer),
+      m_end((uint8_t*)buffer + num_bytes), m_overflow(false) {}
+
+  /// \brief  query total size of bytecode
+  inline size_t numBytes() const
+    { return size_t(m_cursor - m_begin); }
+
+  /// \brief  query byte code
+  inline const uint8_t* bytecode() const
+    { return m_begin; }
+  inline uint8_t* bytecode()
+    { return m_begin; }
+
+  /// \brief  true if the buffer was too small to hold all of the code since begin()
+  inline bool overflowed() const
+    { return m_overflow; }
+
+private:
+
+  inline uint8_t* reserve(size_t num_bytes)
+    {
+      if (size_t(m_end - m_cursor) >= num_bytes && !m_overflow)
+        return m_cursor;
+      m_overflow = true;
+      return m_scratch;
+    }
+
+  inline void commit(uint8_t* end)
+    {
+      if (!m_overflow)
+        m_cursor = end;
+    }
+
+  inline void rewind()
+    {
+      m_cursor = m_begin;
+      m_overflow = false;
+    }
+
+  uint8_t* m_begin;
+  uint8_t* m_cursor;
+  uint8_t* m_end;
+  bool m_overflow;
+  uint8_t m_scratch[kMaxReserve];
+};
+
+#if defined(VPU_HAS_CONSTEXPR14)
+/// \brief  Assembles a kernel at compile time, into a fixed size array of N bytes. Only the instructions themselves are
+///         available (no constants, labels, or calls to a function table), although jumps to an offset or a previous
+///         location work as normal. If the kernel is larger than N bytes, overflowed() returns true.
+/// \code
+/// constexpr vpu::StaticEmitter<64> scaleKernel()
+/// {
+///   vpu::StaticEmitter<64> e;
+///   e.movaps(vpu::YMM0, vpu::RCX, 0);
+///   e.mulps(vpu::YMM0, vpu::YMM0, vpu::RDX, 0);
+///   e.movaps(vpu::RCX, 0, vpu::YMM0);
+///   e.ret();
+///   return e;
+/// }
+/// constexpr vpu::StaticEmitter<64> kScale = scaleKernel();
+/// static_assert(!kScale.overflowed(), "kernel too large");
+/// constexpr std::array<uint8_t, kScale.numBytes()> kScaleCode = kScale.code<kScale.numBytes()>();
+///
+/// // at startup
+/// vpu::Kernel k = arena.commit(kScaleCode.data(), kScaleCode.size());
+/// \endcode
+template<size_t N>
+class StaticEmitter : public EncoderBase<StaticEmitter<N> >
+{
+  friend class EncoderBase<StaticEmitter<N> >;
+public:
+
+  /// \brief  ctor
+  constexpr StaticEmitter()
+    : m_bytes(), m_size(0), m_overflow(false), m_scratch() {}
+
+  /// \brief  discard all code
+  constexpr void begin()
+    {
+      m_size = 0;
+      m_overflow = false;
+    }
+
+  /// \brief  does nothing (there are no constants or labels to resolve), but allows the same code to drive an Emitter
+  constexpr void end() {}
+
+  /// \brief  query total size of bytecode
+  constexpr size_t numBytes() const
+    { return m_size; }
+
+  /// \brief  query byte code
+  constexpr const uint8_t* bytecode() const
+    { return m_bytes; }
+
+  /// \brief  true if the kernel did not fit into N bytes
+  constexpr bool overflowed() const
+    { return m_overflow; }
+
+  /// \brief  returns the first M bytes of the code (normally M == numBytes())
+  template<size_t M>
+  constexpr std::array<uint8_t, M> code() const
+    {
+      static_assert(M <= N, "StaticEmitter::code() : M must not be larger than N");
+      return code<M>(std::make_index_sequence<M>());
+    }
+
+private:
+
+  template<size_t M, size_t... I>
+  constexpr std::array<uint8_t, M> code(std::index_sequence<I...>) const
+    { return std::array<uint8_t, M>{{ m_bytes[I]... }}; }
+
+  constexpr uint8_t* reserve(size_t num_bytes)
+    {
+      if (N - m_size >= num_bytes && !m_overflow)
+        return m_bytes + m_size;
+      m_overflow = true;
+      return m_scratch;
+    }
+
+  constexpr void commit(uint8_t* end)
+    {
+      if (!m_overflow)
+        m_size = size_t(end - m_bytes);
+    }
+
+  uint8_t m_bytes[N];
+  size_t m_size;
+  bool m_overflow;
+  uint8_t m_scratch[EncoderBase<StaticEmitter<N> >::kMaxReserve];
+};
+#endif
+
+} // vpu
@@ -99,6 +99,9 @@ void example00()
   // write out the assembled machine code, just incase we crash and need to debug. 
   print_machine_code("00_basics", a);
 
+  // outside of Windows, the page the code was assembled into is read/write until it is made executable
+  vpu::setExecutable(a);
+
   // Cool! function has been assebled, so let's execute this bad boy, and see what we get!
   a->execute(argument_data);
 
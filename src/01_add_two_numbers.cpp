@@ -48,6 +48,7 @@ void example01()
 
   // print code, execute, and print results
   print_machine_code("01_add_two_numbers", a);
+  vpu::setExecutable(a);
   a->execute(argument_data);
   print_args(argument_data, sizeof(argument_data) / (sizeof(float) * 8));
 
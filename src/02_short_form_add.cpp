@@ -54,6 +54,7 @@ void example02()
 
   // print code, execute, and print results
   print_machine_code("02_short_form_add", a);
+  vpu::setExecutable(a);
   a->execute(argument_data);
   print_args(argument_data, sizeof(argument_data) / (sizeof(float) * 8));
 
@@ -72,6 +72,7 @@ void example03()
 
   // print code, execute, and print results
   print_machine_code("03_normalise_vec3", a);
+  vpu::setExecutable(a);
   a->execute(argument_data);
   print_args(argument_data, sizeof(argument_data) / (sizeof(float) * 8));
 
@@ -100,6 +100,7 @@ void example04()
 
   // print code, execute, and print results
   print_machine_code("04_simple_loop", a);
+  vpu::setExecutable(a);
   a->execute(argument_data);
   print_args(argument_data, sizeof(argument_data) / (sizeof(float) * 8));
 
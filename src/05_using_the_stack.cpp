@@ -88,6 +88,7 @@ void example05()
 
   // print code, execute, and print results
   print_machine_code("05_using_the_stack", a);
+  vpu::setExecutable(a);
   a->execute(argument_data);
   print_args(argument_data, sizeof(argument_data) / (sizeof(float) * 8));
 
@@ -85,6 +85,7 @@ void example06()
 
   // print code, execute, and print results
   print_machine_code("06_aligning_the_stack", a);
+  vpu::setExecutable(a);
   a->execute(argument_data);
   print_args(argument_data, sizeof(argument_data) / (sizeof(float) * 8));
   a->release();
@@ -1,8 +1,8 @@
 #include "examples.h"
 #include <math.h>
 
-// Unsure as to why, but only single or zero arg funcs are working :(  (works in release builds though?)
-// More than one arg seems to screw up the RBP register (and therefore RCX/RDX get screwed up on return)
+// A function may overwrite the bottom of the caller's stack (32 bytes per argument), so reserve vpu::callStackSpace() 
+// bytes below anything you store on the stack. Otherwise functions with two or more args will trash it (RBP, RCX, RDX).
 
 void example07()
 {
@@ -45,12 +45,17 @@ void example07()
     // I'm going to save RBP, just incase it gets modified by the function call we make. 
     a->push(vpu::RBP);
 
+    // The functions we call are free to overwrite the bottom of the stack. The amount depends on the number of arguments,
+    // and the most we need is for the two argument functions (pow, atan2). 
+    const uint32_t call_space = vpu::callStackSpace(vpu::kWin64, vpu::kTwoArgs);
+
     // Now then, for reasons unknown, the stack is actually the wrong way around. We need to subtract from the stack pointer,
-    // rather than add (odd yes, but there we go). So let's move the stack pointer back by the amount we need. 
-    a->sub(vpu::RSP, 64);
+    // rather than add (odd yes, but there we go). So let's move the stack pointer back by the amount we need
+    // (the call space, plus 32 bytes of our own). 
+    a->sub(vpu::RSP, call_space + 32);
 
-    // Store the modified stack location (RSP) in the base pointer (RBP). 
-    a->lea(vpu::RBP, vpu::RSP, 32);
+    // Store the location just above the call space in the base pointer (RBP). 
+    a->lea(vpu::RBP, vpu::RSP, call_space);
 
     // prior to any function call, preserve the RCX, and RDX registers somewhere in a stack location 
     // These register values are volatile, so we need to restore them after any function call we make. 
@@ -427,7 +432,7 @@ void example07()
     printf("atan2(%f, %f) %f\n", argument_data[18][0], argument_data[19][0], atan2(argument_data[18][0], argument_data[19][0]));
   
     // restore our stack pointer
-    a->add(vpu::RSP, 64);
+    a->add(vpu::RSP, call_space + 32);
     a->pop(vpu::RBP);
 
     // don't forget to return!
@@ -438,6 +443,7 @@ void example07()
 
   // print code, execute, and print results
   print_machine_code("07_calling_a_function", a);
+  vpu::setExecutable(a);
   a->execute(argument_data, functions);
   print_args(argument_data, sizeof(argument_data) / (sizeof(float) * 8));
 
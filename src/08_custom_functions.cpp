@@ -2,19 +2,19 @@
 
 // Here are a couple of pointless functions we want to register.
 // Ensure the methods are using the vectorcall calling convention.
-// For some reason, only zero or one arg methods are working :(
+// Functions with more than one arg need more stack space reserved before the call (see vpu::callStackSpace).
 
-__m256 __vectorcall func0()
+__m256 VPU_VECTORCALL func0()
 {
   return _mm256_set1_ps(69.0f);
 }
 
-__m256 __vectorcall func1(__m256 a)
+__m256 VPU_VECTORCALL func1(__m256 a)
 {
   return _mm256_sqrt_ps(a);
 }
 
-__m256 __vectorcall func2(__m256 a, __m256 b)
+__m256 VPU_VECTORCALL func2(__m256 a, __m256 b)
 {
   return _mm256_add_ps(a, b);
 }
@@ -43,10 +43,12 @@ void example08()
   // start assembling
   a->begin();
 
-    // standard function pre-amble
+    // standard function pre-amble. func2 may overwrite up to 64 bytes at the bottom of the stack, so we keep our own
+    // data (at RBP) above that.
+    const uint32_t call_space = vpu::callStackSpace(vpu::kWin64, vpu::kTwoArgs);
     a->push(vpu::RBP);
-    a->sub(vpu::RSP, 64);
-    a->lea(vpu::RBP, vpu::RSP, 32);
+    a->sub(vpu::RSP, call_space + 32);
+    a->lea(vpu::RBP, vpu::RSP, call_space);
 
     // we will need to restore RCX and RDX after function calls
     a->mov64(vpu::RBP, 8, vpu::RCX);
@@ -105,7 +107,7 @@ void example08()
     a->movaps(vpu::RCX, 64, vpu::YMM0);
 
     // restore our stack pointer
-    a->add(vpu::RSP, 64);
+    a->add(vpu::RSP, call_space + 32);
     a->pop(vpu::RBP);
 
     // don't forget to return!
@@ -117,6 +119,7 @@ void example08()
 
   // print code, execute, and print results
   print_machine_code("08_custom_functions", a);
+  vpu::setExecutable(a);
   a->execute(argument_data, functions);
   print_args(argument_data, sizeof(argument_data) / (sizeof(float) * 8));
 
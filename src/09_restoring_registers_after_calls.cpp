@@ -76,6 +76,7 @@ void example09()
 
   // print code, execute, and print results
   print_machine_code("09_restoring_registers_after_call", a);
+  vpu::setExecutable(a);
   a->execute(argument_data, functions);
   print_args(argument_data, sizeof(argument_data) / (sizeof(float) * 8));
 
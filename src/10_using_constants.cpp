@@ -52,6 +52,7 @@ void example10()
   print_machine_code("10_using_constants", a);
 
   // Cool! function has been assebled, so let's execute this bad boy, and see what we get!
+  vpu::setExecutable(a);
   a->execute(argument_data);
 
   // now output what we ended up with in the array above
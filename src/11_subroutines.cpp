@@ -48,6 +48,7 @@ void example11()
   print_machine_code("11_defining_sub_routines", a);
 
   // Cool! function has been assebled, so let's execute this bad boy, and see what we get!
+  vpu::setExecutable(a);
   a->execute(argument_data);
 
   // now output what we ended up with in the array above
@@ -1,6 +1,6 @@
 #include "examples.h"
 
-__declspec(dllexport) void example12()
+void example12()
 {
   // This example will implement an if/else statement using jump. This may be used for early-out codepaths 
   // (for example skipping the computation of lighting if all rays miss a surface)
@@ -61,6 +61,7 @@ __declspec(dllexport) void example12()
   print_machine_code("12_forward_jumps", a);
 
   // call with the +ve argument 
+  vpu::setExecutable(a);
   a->execute(pos_argument_data);
   print_args(pos_argument_data, sizeof(pos_argument_data) / (sizeof(float) * 8));
 
@@ -0,0 +1,76 @@
+#include "examples.h"
+#include "lib_asm_emitter.h"
+#include <chrono>
+#include <vector>
+
+namespace
+{
+// the number of times the loop body is unrolled (each iteration emits 10 instructions)
+const uint32_t kNumIterations = 1000;
+const uint32_t kNumInstructions = kNumIterations * 10 + 1;
+const uint32_t kNumRuns = 50;
+
+// Emits the same kernel through either a vpu::IAssembler, or a vpu::Emitter. Both have the same methods, so the only
+// difference is whether each instruction is a virtual call into the DLL, or inlined into this function.
+template<typename Assembler>
+void emitKernel(Assembler& a)
+{
+  a.begin();
+  for (uint32_t i = 0; i < kNumIterations; ++i)
+  {
+    const int32_t offset = int32_t(i & 63) * 32;
+    a.movaps(vpu::YMM0, vpu::RCX, offset);
+    a.movaps(vpu::YMM1, vpu::RDX, offset);
+    a.mulps(vpu::YMM2, vpu::YMM0, vpu::YMM1);
+    a.fmaddps(vpu::YMM2, vpu::YMM0, vpu::YMM1);
+    a.addps(vpu::YMM3, vpu::YMM2, vpu::R8, offset);
+    a.maxps(vpu::YMM3, vpu::YMM3, vpu::YMMF);
+    a.shuffleps(vpu::YMM4, vpu::YMM3, vpu::YMM3, 1, 0, 3, 2);
+    a.sqrtps(vpu::YMM9, vpu::YMM4);
+    a.blendvps(vpu::YMMA, vpu::YMM9, vpu::YMM3, vpu::YMM2);
+    a.movaps(vpu::RCX, offset, vpu::YMMA);
+  }
+  a.ret();
+  a.end();
+}
+
+// returns the fastest time (in seconds) taken to emit the kernel
+template<typename Assembler>
+double timeKernel(Assembler& a)
+{
+  double best = 1e9;
+  for (uint32_t run = 0; run < kNumRuns; ++run)
+  {
+    const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    emitKernel(a);
+    const std::chrono::duration<double> t = std::chrono::high_resolution_clock::now() - start;
+    if (t.count() < best)
+      best = t.count();
+  }
+  return best;
+}
+}
+
+void example13()
+{
+  // This example compares the speed of emitting a large kernel via the IAssembler interface (a virtual call into
+  // the DLL per instruction), with vpu::Emitter (see lib_asm_emitter.h), which encodes the instructions inline.
+  // The machine code produced by both must be identical.
+  vpu::IAssembler* a = g_lib->createGrowableAssembler();
+
+  // no more than 11 bytes per instruction
+  std::vector<uint8_t> buffer(kNumInstructions * 11);
+  vpu::Emitter e(&buffer[0], buffer.size());
+
+  const double dll_time = timeKernel(*a);
+  const double emitter_time = timeKernel(e);
+
+  const bool identical = !e.overflowed() && e.numBytes() == a->numBytes() && !memcmp(e.bytecode(), a->bytecode(), e.numBytes());
+
+  printf("\n13_emitter_benchmark\n");
+  printf("  %u instructions, %u bytes, output %s\n", kNumInstructions, uint32_t(e.numBytes()), identical ? "identical" : "DIFFERS");
+  printf("  IAssembler : %8.3f ms  (%.1f million instructions/sec)\n", dll_time * 1000.0, kNumInstructions / dll_time * 1e-6);
+  printf("  Emitter    : %8.3f ms  (%.1f million instructions/sec)\n", emitter_time * 1000.0, kNumInstructions / emitter_time * 1e-6);
+
+  a->release();
+}
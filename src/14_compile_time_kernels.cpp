@@ -0,0 +1,82 @@
+#include "examples.h"
+#include "lib_asm_arena.h"
+#include "lib_asm_emitter.h"
+
+#if defined(VPU_HAS_CONSTEXPR14)
+namespace
+{
+// The kernel is assembled by the compiler. vpu::StaticEmitter has the same instruction methods as IAssembler.
+constexpr vpu::StaticEmitter<64> squarePlusArg()
+{
+  vpu::StaticEmitter<64> e;
+  e.movaps(vpu::YMM0, vpu::RCX, 0);
+  e.mulps(vpu::YMM1, vpu::YMM0, vpu::YMM0);
+  e.addps(vpu::YMM1, vpu::YMM1, vpu::YMM0);
+  e.movaps(vpu::RCX, 0, vpu::YMM1);
+  e.ret();
+  return e;
+}
+
+constexpr vpu::StaticEmitter<64> kSquarePlusArg = squarePlusArg();
+static_assert(!kSquarePlusArg.overflowed(), "increase the size of the StaticEmitter");
+
+// permutepd builds the same immediate in its register & memory forms
+constexpr bool permutepdFormsMatch()
+{
+  for (uint8_t x = 0; x < 4; ++x)
+  {
+    for (uint8_t y = 0; y < 4; ++y)
+    {
+      vpu::StaticEmitter<16> r, m;
+      r.permutepd(vpu::YMM0, vpu::YMM1, x, y);
+      m.permutepd(vpu::YMM0, vpu::RAX, 0, x, y);
+      if (r.bytecode()[r.numBytes() - 1] != m.bytecode()[m.numBytes() - 1])
+        return false;
+    }
+  }
+  return true;
+}
+static_assert(permutepdFormsMatch(), "permutepd encodes a different immediate from a register & from memory");
+
+// the machine code, trimmed to size
+constexpr std::array<uint8_t, kSquarePlusArg.numBytes()> kSquarePlusArgCode = kSquarePlusArg.code<kSquarePlusArg.numBytes()>();
+}
+#endif
+
+void example14()
+{
+  // This example runs a kernel that was assembled at compile time (which requires a C++14 compiler). At runtime, the
+  // machine code just needs copying into executable memory.
+#if defined(VPU_HAS_CONSTEXPR14)
+  VPU_ALIGN_PREFIX(32)
+  float argument_data[][8] =
+  {
+    { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f },   // RCX
+  }
+  VPU_ALIGN_SUFFIX(32);
+
+  vpu::CodeArena arena;
+  vpu::Kernel kernel = arena.commit(kSquarePlusArgCode.data(), kSquarePlusArgCode.size());
+
+  // the same kernel assembled by the DLL, for comparison
+  vpu::IAssembler* a = g_lib->createAssembler();
+  a->begin();
+    a->movaps(vpu::YMM0, vpu::RCX, 0);
+    a->mulps(vpu::YMM1, vpu::YMM0, vpu::YMM0);
+    a->addps(vpu::YMM1, vpu::YMM1, vpu::YMM0);
+    a->movaps(vpu::RCX, 0, vpu::YMM1);
+    a->ret();
+  a->end();
+
+  print_machine_code("14_compile_time_kernels", a);
+  const bool identical = a->numBytes() == kSquarePlusArgCode.size() && !memcmp(a->bytecode(), kSquarePlusArgCode.data(), a->numBytes());
+  printf("\n  compile time kernel %s\n", identical ? "matches the DLL" : "DIFFERS from the DLL");
+
+  kernel.execute(argument_data);
+  print_args(argument_data, sizeof(argument_data) / (sizeof(float) * 8));
+
+  a->release();
+#else
+  printf("\n14_compile_time_kernels\n  requires a C++14 compiler\n");
+#endif
+}
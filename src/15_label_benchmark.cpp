@@ -0,0 +1,115 @@
+#include "examples.h"
+#include "lib_asm_emitter.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace
+{
+const uint32_t kNumBranches = 2000;
+const uint32_t kNumRuns = 5;
+
+// A branch heavy kernel: a chain of compares, each jumping forward to its own label, and back again.
+// Labels are referred to by name, via either the IAssembler or vpu::Emitter.
+template<typename Assembler>
+void emitNamedLabels(Assembler& a, const std::vector<std::string>& names)
+{
+  a.begin();
+  for (uint32_t i = 0; i < kNumBranches; ++i)
+  {
+    a.cmp(vpu::RAX, int32_t(i));
+    a.jump_eq_label(names[i].c_str());
+  }
+  a.ret();
+  for (uint32_t i = 0; i < kNumBranches; ++i)
+  {
+    a.insert_label(names[i].c_str());
+    a.addps(vpu::YMM0, vpu::YMM0, vpu::YMM1);
+    a.jump_ne_label(names[(i + 1) % kNumBranches].c_str());
+  }
+  a.end();
+}
+
+// the same kernel using vpu::LabelId
+void emitLabelIds(vpu::Emitter& a, std::vector<vpu::LabelId>& labels)
+{
+  a.begin();
+  labels.resize(kNumBranches);
+  for (uint32_t i = 0; i < kNumBranches; ++i)
+    labels[i] = a.new_label();
+  for (uint32_t i = 0; i < kNumBranches; ++i)
+  {
+    a.cmp(vpu::RAX, int32_t(i));
+    a.jump_eq(labels[i]);
+  }
+  a.ret();
+  for (uint32_t i = 0; i < kNumBranches; ++i)
+  {
+    a.bind(labels[i]);
+    a.addps(vpu::YMM0, vpu::YMM0, vpu::YMM1);
+    a.jump_ne(labels[(i + 1) % kNumBranches]);
+  }
+  a.end();
+}
+
+typedef std::chrono::high_resolution_clock Clock;
+
+inline double seconds(const Clock::time_point& start)
+{
+  const std::chrono::duration<double> t = Clock::now() - start;
+  return t.count();
+}
+}
+
+void example15()
+{
+  // This example compares the time taken to assemble a kernel with lots of branches, using named labels (in both
+  // the DLL and vpu::Emitter), and the integer LabelIds provided by vpu::Emitter.
+  std::vector<std::string> names(kNumBranches);
+  for (uint32_t i = 0; i < kNumBranches; ++i)
+  {
+    char name[32];
+    sprintf(name, "label_%u", i);
+    names[i] = name;
+  }
+  std::vector<vpu::LabelId> labels;
+
+  vpu::IAssembler* a = g_lib->createGrowableAssembler();
+  std::vector<uint8_t> buffer(kNumBranches * 32);
+  vpu::Emitter e(&buffer[0], buffer.size());
+
+  double dll_time = 1e9, named_time = 1e9, id_time = 1e9;
+  bool identical = true;
+  for (uint32_t run = 0; run < kNumRuns; ++run)
+  {
+    Clock::time_point start = Clock::now();
+    emitNamedLabels(*a, names);
+    dll_time = std::min(dll_time, seconds(start));
+
+    start = Clock::now();
+    emitNamedLabels(e, names);
+    named_time = std::min(named_time, seconds(start));
+    identical = identical && !e.overflowed() && e.numBytes() == a->numBytes() && !memcmp(e.bytecode(), a->bytecode(), e.numBytes());
+
+    start = Clock::now();
+    emitLabelIds(e, labels);
+    id_time = std::min(id_time, seconds(start));
+    identical = identical && !e.overflowed() && e.numBytes() == a->numBytes() && !memcmp(e.bytecode(), a->bytecode(), e.numBytes());
+  }
+
+  printf("\n15_label_benchmark\n");
+  printf("  %u labels, %u jumps, output %s\n", kNumBranches, kNumBranches * 2, identical ? "identical" : "DIFFERS");
+  printf("  IAssembler, named labels : %8.3f ms\n", dll_time * 1000.0);
+  printf("  Emitter, named labels    : %8.3f ms\n", named_time * 1000.0);
+  printf("  Emitter, LabelId         : %8.3f ms\n", id_time * 1000.0);
+
+  // the same kernel again, with each jump as short as its target allows
+  const size_t num_bytes = e.numBytes();
+  e.setOptimisations(vpu::kRelaxBranches);
+  emitLabelIds(e, labels);
+  printf("  kRelaxBranches           : %u of %u jumps shortened, %u -> %u bytes\n", e.peepholeStats().jumpsShortened,
+    kNumBranches * 2, uint32_t(num_bytes), uint32_t(e.numBytes()));
+
+  a->release();
+}
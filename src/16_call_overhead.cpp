@@ -0,0 +1,144 @@
+#include "examples.h"
+#include <chrono>
+
+namespace
+{
+const uint32_t kNumIterations = 1000000;
+
+// functions taking 0 -> 5 arguments, that do the same work as the inline code below (a few adds)
+__m256 VPU_VECTORCALL sum0()
+{
+  return _mm256_setzero_ps();
+}
+__m256 VPU_VECTORCALL sum1(__m256 a)
+{
+  return _mm256_add_ps(a, a);
+}
+__m256 VPU_VECTORCALL sum2(__m256 a, __m256 b)
+{
+  return _mm256_add_ps(a, b);
+}
+__m256 VPU_VECTORCALL sum3(__m256 a, __m256 b, __m256 c)
+{
+  return _mm256_add_ps(_mm256_add_ps(a, b), c);
+}
+__m256 VPU_VECTORCALL sum4(__m256 a, __m256 b, __m256 c, __m256 d)
+{
+  return _mm256_add_ps(_mm256_add_ps(a, b), _mm256_add_ps(c, d));
+}
+__m256 VPU_VECTORCALL sum5(__m256 a, __m256 b, __m256 c, __m256 d, __m256 e)
+{
+  return _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(a, b), _mm256_add_ps(c, d)), e);
+}
+
+const char* const kNames[] = { "sum0", "sum1", "sum2", "sum3", "sum4", "sum5" };
+const vpu::FunctionType kTypes[] = { vpu::kNoArgs, vpu::kOneArg, vpu::kTwoArgs, vpu::kThreeArgs, vpu::kFourArgs, vpu::kFiveArgs };
+
+// Assembles a loop that either calls the function with the given number of arguments, or inlines the same work.
+void emitLoop(vpu::IAssembler* a, const vpu::IFunctionTable* functions, uint32_t num_args, bool inline_code)
+{
+  const uint32_t call_space = vpu::callStackSpace(vpu::kWin64, kTypes[num_args]);
+
+  a->begin();
+    // RBX is preserved by the calls, so it holds the loop counter. RBP points to where RCX & RDX are saved.
+    // (On entry RSP is 8 bytes off 16 byte alignment, and the 2 pushes + 40 bytes put it back)
+    a->push(vpu::RBP);
+    a->push(vpu::RBX);
+    a->sub(vpu::RSP, call_space + 40);
+    a->lea(vpu::RBP, vpu::RSP, call_space);
+    a->mov64(vpu::RBP, 0, vpu::RCX);
+    a->mov64(vpu::RBP, 8, vpu::RDX);
+    a->loadcount(vpu::RBX, kNumIterations);
+
+    const uint32_t loop = uint32_t(a->numBytes());
+
+      // the arguments arrive in YMM0 -> YMM4
+      for (uint32_t i = 0; i < num_args; ++i)
+        a->movaps(vpu::AVXReg(vpu::YMM0 + i), vpu::RCX, 32 * i);
+
+      if (inline_code)
+      {
+        if (num_args == 0)
+          a->setzero(vpu::YMM0);
+        else
+        if (num_args == 1)
+          a->addps(vpu::YMM0, vpu::YMM0, vpu::YMM0);
+        for (uint32_t i = 1; i < num_args; ++i)
+          a->addps(vpu::YMM0, vpu::YMM0, vpu::AVXReg(vpu::YMM0 + i));
+      }
+      else
+      {
+        a->call(kNames[num_args], functions);
+        a->mov64(vpu::RCX, vpu::RBP, 0);
+        a->mov64(vpu::RDX, vpu::RBP, 8);
+      }
+
+    a->dec(vpu::RBX);
+    a->jump_ne_to(loop);
+
+    a->movaps(vpu::RCX, 192, vpu::YMM0);
+    a->add(vpu::RSP, call_space + 40);
+    a->pop(vpu::RBX);
+    a->pop(vpu::RBP);
+    a->ret();
+  a->end();
+}
+
+// nanoseconds per iteration of the loop
+double timeLoop(vpu::IAssembler* a, float data[][8], const vpu::IFunctionTable* functions)
+{
+  vpu::setExecutable(a);
+  const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  a->execute(data, functions);
+  const std::chrono::duration<double> t = std::chrono::high_resolution_clock::now() - start;
+  vpu::setExecutable(a, false);
+  return t.count() * 1e9 / kNumIterations;
+}
+}
+
+void example16()
+{
+  // This example measures the overhead of calling a __vectorcall function from the assembled code, for each number of
+  // arguments, compared to doing the same work inline. The results are written to RCX + 192.
+  VPU_ALIGN_PREFIX(32)
+  float argument_data[][8] =
+  {
+    { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f },   // RCX
+    { 2.0f, 2.0f, 2.0f, 2.0f, 2.0f, 2.0f, 2.0f, 2.0f },   // RCX + 32
+    { 3.0f, 3.0f, 3.0f, 3.0f, 3.0f, 3.0f, 3.0f, 3.0f },   // RCX + 64
+    { 4.0f, 4.0f, 4.0f, 4.0f, 4.0f, 4.0f, 4.0f, 4.0f },   // RCX + 96
+    { 5.0f, 5.0f, 5.0f, 5.0f, 5.0f, 5.0f, 5.0f, 5.0f },   // RCX + 128
+    { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f },   // RCX + 160
+    { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f },   // RCX + 192
+  }
+  VPU_ALIGN_SUFFIX(32);
+
+  vpu::IFunctionTable* functions = g_lib->createFunctionTable();
+  functions->addFunc("sum0", sum0);
+  functions->addFunc("sum1", sum1);
+  functions->addFunc("sum2", sum2);
+  functions->addFunc("sum3", sum3);
+  functions->addFunc("sum4", sum4);
+  functions->addFunc("sum5", sum5);
+
+  vpu::IAssembler* a = g_lib->createAssembler();
+
+  printf("\n16_call_overhead\n");
+  printf("  args   call (ns)   inline (ns)   overhead (ns)   result\n");
+  for (uint32_t num_args = 0; num_args < 6; ++num_args)
+  {
+    emitLoop(a, functions, num_args, false);
+    const double call_time = timeLoop(a, argument_data, functions);
+    const float call_result = argument_data[6][0];
+
+    emitLoop(a, functions, num_args, true);
+    const double inline_time = timeLoop(a, argument_data, functions);
+    const float inline_result = argument_data[6][0];
+
+    printf("  %4u   %9.2f   %11.2f   %13.2f   %s\n", num_args, call_time, inline_time, call_time - inline_time,
+      call_result == inline_result ? "ok" : "WRONG");
+  }
+
+  a->release();
+  functions->release();
+}
@@ -0,0 +1,71 @@
+#include "examples.h"
+#include "lib_asm_arena.h"
+#include "lib_asm_emitter.h"
+
+namespace
+{
+__m256 VPU_VECTORCALL scale2(__m256 a)
+{
+  return _mm256_add_ps(a, a);
+}
+
+__m256 VPU_VECTORCALL blend2(__m256 a, __m256 b)
+{
+  return _mm256_mul_ps(_mm256_add_ps(a, b), _mm256_set1_ps(0.5f));
+}
+}
+
+void example17()
+{
+  // This example is example 08 again, without the hand written stack frame. vpu::Emitter::function() works out which
+  // registers the body uses, and generates the prologue & epilogue, plus the stores & reloads around each call.
+  VPU_ALIGN_PREFIX(32)
+  float argument_data[][8] =
+  {
+    { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f },   // RCX
+    { 4.0f, 4.0f, 4.0f, 4.0f, 4.0f, 4.0f, 4.0f, 4.0f },   // RCX + 32
+    { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f },   // RCX + 64
+    { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f },   // RCX + 96
+  }
+  VPU_ALIGN_SUFFIX(32);
+
+  vpu::IFunctionTable* functions = g_lib->createFunctionTable();
+  functions->addFunc("scale2", scale2);
+  functions->addFunc("blend2", blend2);
+  const vpu::FunctionHandle scale_fn = vpu::findFunction(functions, "scale2");
+  const vpu::FunctionHandle blend_fn = vpu::findFunction(functions, "blend2");
+
+  uint8_t buffer[512];
+  vpu::Emitter e(buffer, sizeof(buffer));
+  e.function([&](vpu::Emitter& e) {
+
+    // RCX[0] is needed again after both calls, so it is kept in YMM6. The prologue saves YMM6 for our caller (and
+    // the lower half only survives the calls, so it is spilled around them as well).
+    e.movaps(vpu::YMM6, vpu::RCX, 0);
+
+    // RCX[2] = scale2(RCX[0]). RCX & RDX are used after the call, so they are reloaded.
+    e.movaps(vpu::YMM0, vpu::YMM6);
+    e.call(scale_fn);
+    e.movaps(vpu::RCX, 64, vpu::YMM0);
+
+    // RCX[3] = blend2(RCX[0], RCX[1]). The stack space for 2 arguments is reserved by the prologue.
+    e.movaps(vpu::YMM0, vpu::YMM6);
+    e.movaps(vpu::YMM1, vpu::RCX, 32);
+    e.call(blend_fn);
+    e.movaps(vpu::RCX, 96, vpu::YMM0);
+
+    // the epilogue restores YMM6, the stack, and RBP
+    e.ret();
+  });
+
+  print_machine_code("17_automatic_frames", &e);
+
+  vpu::IAssembler* a = g_lib->createAssembler();
+  vpu::CodeArena arena;
+  vpu::Kernel kernel = arena.commit(e.bytecode(), e.numBytes());
+  kernel.execute(argument_data, vpu::resolveFunctionTable(a, functions));
+  print_args(argument_data, sizeof(argument_data) / (sizeof(float) * 8));
+
+  a->release();
+  functions->release();
+}
@@ -0,0 +1,78 @@
+#include "examples.h"
+#include "lib_asm_arena.h"
+#include "lib_asm_emitter.h"
+#include <vector>
+
+namespace
+{
+const uint32_t kNumTerms = 24;
+
+// Assembles out = sum((x - i)^2 * (i + 1)), keeping every term in its own virtual register until the end. That is more
+// values than there are YMM registers, so the allocator has to spill some of them.
+bool emitSumOfSquares(vpu::Emitter& e)
+{
+  return e.function([&](vpu::Emitter& e) {
+
+    vpu::VReg x = e.new_ymm();
+    e.movaps(x, vpu::RCX, 0);
+
+    std::vector<vpu::VReg> terms(kNumTerms);
+    for (uint32_t i = 0; i < kNumTerms; ++i)
+    {
+      vpu::VReg offset = e.new_ymm();
+      vpu::VReg scale = e.new_ymm();
+      e.load_const(offset, e.set1_ps(float(i)));
+      e.load_const(scale, e.set1_ps(float(i + 1)));
+      terms[i] = e.new_ymm();
+      e.subps(terms[i], x, offset);
+      e.mulps(terms[i], terms[i], terms[i]);
+      e.mulps(terms[i], terms[i], scale);
+    }
+
+    vpu::VReg sum = e.new_ymm();
+    e.setzero(sum);
+    for (uint32_t i = 0; i < kNumTerms; ++i)
+      e.addps(sum, sum, terms[i]);
+    e.movaps(vpu::RCX, 32, sum);
+    e.ret();
+  });
+}
+}
+
+void example18()
+{
+  // This example uses virtual registers (see vpu::Emitter::new_ymm), rather than naming YMM registers directly. They
+  // are allocated by function(), which also builds the stack frame needed for the spills.
+  VPU_ALIGN_PREFIX(32)
+  float argument_data[][8] =
+  {
+    { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f },   // RCX
+    { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f },   // RCX + 32
+  }
+  VPU_ALIGN_SUFFIX(32);
+
+  std::vector<uint8_t> buffer(4096);
+  vpu::Emitter e(&buffer[0], buffer.size());
+  if (!emitSumOfSquares(e) || e.overflowed())
+  {
+    printf("\n18_virtual_registers\n  failed to assemble\n");
+    return;
+  }
+  print_machine_code("18_virtual_registers", &e);
+
+  vpu::CodeArena arena;
+  vpu::Kernel kernel = arena.commit(e.bytecode(), e.numBytes());
+  kernel.execute(argument_data);
+  print_args(argument_data, sizeof(argument_data) / (sizeof(float) * 8));
+
+  // the same sum, computed in C++
+  printf("\n  expected:\n ");
+  for (uint32_t j = 0; j < 8; ++j)
+  {
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < kNumTerms; ++i)
+      sum += (argument_data[0][j] - float(i)) * (argument_data[0][j] - float(i)) * float(i + 1);
+    printf(" %2.4f", sum);
+  }
+  printf("\n");
+}
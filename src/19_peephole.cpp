@@ -0,0 +1,67 @@
+#include "examples.h"
+#include "lib_asm_arena.h"
+#include "lib_asm_emitter.h"
+
+namespace
+{
+// Assembles RCX[3] = (RCX[0] * RCX[1] + RCX[2]) * 0.5 + RCX[0], the way a simple front end might: each expression
+// starts with a copy of its first operand, and each result is stored to memory, then read straight back.
+void emitNaive(vpu::Emitter& e)
+{
+  e.begin();
+    e.load_const(vpu::YMM5, e.set1_ps(0.5f));
+    e.movaps(vpu::YMM0, vpu::RCX, 0);
+    e.movaps(vpu::YMM1, vpu::RCX, 32);
+    e.movaps(vpu::YMM2, vpu::RCX, 64);
+
+    // t = a * b + c
+    e.movaps(vpu::YMM3, vpu::YMM0);
+    e.mulps(vpu::YMM3, vpu::YMM3, vpu::YMM1);
+    e.addps(vpu::YMM2, vpu::YMM2, vpu::YMM3);
+    e.movaps(vpu::RCX, 96, vpu::YMM2);
+
+    // RCX[3] = t * 0.5 + a
+    e.movaps(vpu::YMM4, vpu::RCX, 96);
+    e.lea(vpu::RCX, vpu::RCX, 0);
+    e.mulps(vpu::YMM4, vpu::YMM4, vpu::YMM5);
+    e.addps(vpu::YMM0, vpu::YMM0, vpu::YMM4);
+    e.movaps(vpu::RCX, 96, vpu::YMM0);
+    e.ret();
+  e.end();
+}
+}
+
+void example19()
+{
+  // This example assembles the same naive code twice, the second time with the peephole passes enabled (see
+  // vpu::Emitter::setOptimisations). The copies, the reload, and the lea are removed, and both multiply & adds are
+  // fused into an FMA.
+  VPU_ALIGN_PREFIX(32)
+  float argument_data[][8] =
+  {
+    { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f },   // RCX
+    { 2.0f, 2.0f, 2.0f, 2.0f, 3.0f, 3.0f, 3.0f, 3.0f },   // RCX + 32
+    { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f },   // RCX + 64
+    { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f },   // RCX + 96
+  }
+  VPU_ALIGN_SUFFIX(32);
+
+  uint8_t buffer[256];
+  vpu::Emitter e(buffer, sizeof(buffer));
+  emitNaive(e);
+  print_machine_code("19_peephole (as written)", &e);
+
+  e.setOptimisations(vpu::kPeephole | vpu::kFuseMultiplyAdd);
+  emitNaive(e);
+  print_machine_code("\n19_peephole (optimised)", &e);
+
+  const vpu::PeepholeStats& stats = e.peepholeStats();
+  printf("\n\n  %u instructions: %u nops, %u moves removed, %u loads forwarded, %u multiply & adds fused (%u removed)\n",
+    stats.numInstructions, stats.nopsRemoved, stats.movesRemoved, stats.loadsForwarded, stats.multiplyAddsFused,
+    stats.numRemoved);
+
+  vpu::CodeArena arena;
+  vpu::Kernel kernel = arena.commit(e.bytecode(), e.numBytes());
+  kernel.execute(argument_data);
+  print_args(argument_data, sizeof(argument_data) / (sizeof(float) * 8));
+}
@@ -0,0 +1,107 @@
+#include "examples.h"
+#include "lib_asm_arena.h"
+#include "lib_asm_emitter.h"
+#include <chrono>
+
+namespace
+{
+const uint32_t kNumGroups = 4;
+const uint32_t kNumIterations = 1000000;
+const uint32_t kNumRuns = 5;
+
+// Assembles example 03 (normalising 8x Vector3's) for 4 groups of vectors, one group after another, the way it would
+// be written by hand: each group is a chain of latencies ending in a square root & 3 divides. The groups are normalised
+// kNumIterations times, reading rows 0 -> 11 and writing rows 12 -> 23.
+void emitNormalise(vpu::Emitter& e)
+{
+  e.begin();
+    e.loadcount(vpu::RAX, kNumIterations);
+    const uint32_t loop = uint32_t(e.numBytes());
+
+      for (uint32_t g = 0; g < kNumGroups; ++g)
+      {
+        const vpu::AVXReg x = vpu::AVXReg(4 * g), y = vpu::AVXReg(4 * g + 1), z = vpu::AVXReg(4 * g + 2);
+        const vpu::AVXReg length = vpu::AVXReg(4 * g + 3);
+        const int32_t in = 96 * g, out = 384 + 96 * g;
+        e.movaps(x, vpu::RCX, in);
+        e.movaps(y, vpu::RCX, in + 32);
+        e.movaps(z, vpu::RCX, in + 64);
+        e.mulps(length, x, x);
+        e.fmaddps(length, y, y);
+        e.fmaddps(length, z, z);
+        e.sqrtps(length, length);
+        e.divps(x, x, length);
+        e.divps(y, y, length);
+        e.divps(z, z, length);
+        e.movaps(vpu::RCX, out, x);
+        e.movaps(vpu::RCX, out + 32, y);
+        e.movaps(vpu::RCX, out + 64, z);
+      }
+
+    e.dec(vpu::RAX);
+    e.jump_ne_to(loop);
+    e.ret();
+  e.end();
+}
+
+// the fastest of kNumRuns runs, in nanoseconds per iteration
+double timeKernel(const vpu::Kernel& kernel, float data[][8])
+{
+  double best = 0.0;
+  for (uint32_t run = 0; run < kNumRuns; ++run)
+  {
+    const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    kernel.execute(data);
+    const std::chrono::duration<double> t = std::chrono::high_resolution_clock::now() - start;
+    if (run == 0 || t.count() < best)
+      best = t.count();
+  }
+  return best * 1e9 / kNumIterations;
+}
+}
+
+void example20()
+{
+  // This example schedules the same kernel for each of the processors the scheduler knows about (see
+  // vpu::Emitter::setOptimisations), and times it against the code as written. Whichever processor this runs on, each
+  // order of the code should produce the same results.
+  VPU_ALIGN_PREFIX(32)
+  float argument_data[24][8] VPU_ALIGN_SUFFIX(32);
+  for (uint32_t i = 0; i < 24; ++i)
+  {
+    for (uint32_t j = 0; j < 8; ++j)
+      argument_data[i][j] = i < 12 ? float(i + j + 1) * 0.25f : 0.0f;
+  }
+
+  const char* const names[] = { "as written", "Haswell", "Skylake", "Zen 2" };
+  uint8_t buffer[1024];
+  vpu::Emitter e(buffer, sizeof(buffer));
+  vpu::CodeArena arena;
+  float expected[12][8];
+
+  printf("\n20_instruction_scheduling\n");
+  printf("  target       blocks   est. cycles   ns / iteration   result\n");
+  for (uint32_t i = 0; i < 4; ++i)
+  {
+    if (i == 0)
+      e.setOptimisations(0);
+    else
+      e.setOptimisations(vpu::kSchedule, vpu::Microarchitecture(i - 1));
+    emitNormalise(e);
+
+    vpu::Kernel kernel = arena.commit(e.bytecode(), e.numBytes());
+    const double time = timeKernel(kernel, argument_data);
+    arena.release(kernel);
+    if (i == 0)
+      memcpy(expected, argument_data[12], sizeof(expected));
+
+    const vpu::ScheduleStats& stats = e.scheduleStats();
+    printf("  %-10s   %6u   %5u -> %-4u   %14.2f   %s\n", names[i], stats.numBlocks, stats.cyclesBefore,
+      stats.cyclesAfter, time, memcmp(expected, argument_data[12], sizeof(expected)) == 0 ? "ok" : "WRONG");
+  }
+
+  e.setOptimisations(vpu::kSchedule, vpu::kSkylake);
+  emitNormalise(e);
+  print_machine_code("\n20_instruction_scheduling (Skylake)", &e);
+  print_args(argument_data + 12, 3);
+}
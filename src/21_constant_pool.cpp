@@ -0,0 +1,71 @@
+#include "examples.h"
+#include "lib_asm_arena.h"
+#include "lib_asm_emitter.h"
+
+namespace
+{
+const uint32_t kNumKernels = 100;
+
+// Assembles RCX[0] = min(max(RCX[0] * scale + bias, 0), 1). Each kernel has its own scale, but the bias, 0 and 1 are
+// the same in every kernel.
+void emitKernel(vpu::Emitter& e, uint32_t index)
+{
+  e.begin();
+    e.movaps(vpu::YMM0, vpu::RCX, 0);
+    e.load_const(vpu::YMM1, e.set1_ps(float(index % 10 + 1) * 0.125f));
+    e.load_const(vpu::YMM2, e.set1_ps(0.5f));
+    e.fmaddps(vpu::YMM2, vpu::YMM0, vpu::YMM1);
+    e.load_const(vpu::YMM3, e.set1_ps(0.0f));
+    e.load_const(vpu::YMM4, e.set1_ps(1.0f));
+    e.maxps(vpu::YMM2, vpu::YMM2, vpu::YMM3);
+    e.minps(vpu::YMM2, vpu::YMM2, vpu::YMM4);
+    e.movaps(vpu::RCX, 0, vpu::YMM2);
+    e.ret();
+  e.end();
+}
+}
+
+void example21()
+{
+  // This example commits the same 100 kernels to an arena three times: with the constants stored after each kernel,
+  // then stored once in a ConstantPool shared by them all, and then stored in the pool as single floats, which are
+  // loaded with vbroadcastss. Each kernel must be linked to the pool once it has been committed.
+  VPU_ALIGN_PREFIX(32)
+  float argument_data[1][8] = { { -1.0f, 0.0f, 0.25f, 0.5f, 1.0f, 2.0f, 3.0f, 4.0f } } VPU_ALIGN_SUFFIX(32);
+
+  const char* const names[] = { "after each kernel", "shared pool", "shared pool (broadcast)" };
+  uint8_t buffer[256];
+  vpu::Emitter e(buffer, sizeof(buffer));
+
+  printf("\n21_constant_pool\n");
+  printf("  constants                  code + constants   pool   total bytes\n");
+  for (uint32_t i = 0; i < 3; ++i)
+  {
+    vpu::CodeArena arena;
+    const vpu::Kernel memory = arena.reserve(4096);
+    vpu::ConstantPool pool(memory.code, memory.writable, memory.numBytes);
+    e.setConstantPool(i ? &pool : 0, i == 2);
+
+    size_t code_bytes = 0;
+    vpu::Kernel kernel = { 0, 0, 0, vpu::kWin64 };
+    for (uint32_t k = 0; k < kNumKernels; ++k)
+    {
+      emitKernel(e, k);
+      kernel = arena.commit(e.bytecode(), e.numBytes());
+      if (e.needsLinking())
+        e.linkConstants(kernel.writable, kernel.code);
+      code_bytes += e.numBytes();
+    }
+    printf("  %-23s   %16u   %4u   %11u\n", names[i], uint32_t(code_bytes), uint32_t(pool.numBytes()),
+      uint32_t(code_bytes + pool.numBytes()));
+
+    // run the last kernel
+    if (i == 2)
+    {
+      print_machine_code("\n21_constant_pool (broadcast)", &e);
+      kernel.execute(argument_data);
+      print_args(argument_data, 1);
+    }
+  }
+  e.setConstantPool(0);
+}
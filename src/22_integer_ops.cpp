@@ -0,0 +1,68 @@
+#include "examples.h"
+#include "lib_asm_arena.h"
+#include "lib_asm_emitter.h"
+
+namespace
+{
+const int32_t kNumRows = 4;
+
+// Assembles: for i in [0, 4), RCX[5 + i] = RCX[1 + clamp(table[i], 0, kNumRows - 1)], where table holds 4 int64's at
+// RCX[0]. The index is loaded, clamped, and turned into an address without leaving the kernel.
+void emitLookup(vpu::Emitter& e)
+{
+  e.begin();
+    e.mov(vpu::RAX, 0);
+    vpu::LabelId loop = e.new_label();
+    e.bind(loop);
+      e.mov64(vpu::RDX, vpu::Mem{ vpu::RCX, vpu::RAX, 8, 0 });
+
+      // clamp the index, without a branch
+      e.mov(vpu::R8, 0);
+      e.cmp(vpu::RDX, vpu::R8);
+      e.cmov_lt(vpu::RDX, vpu::R8);
+      e.mov(vpu::R8, kNumRows - 1);
+      e.cmp(vpu::RDX, vpu::R8);
+      e.cmov_gt(vpu::RDX, vpu::R8);
+
+      // rows are 32 bytes
+      e.shl(vpu::RDX, 5);
+      e.movaps(vpu::YMM0, vpu::Mem{ vpu::RCX, vpu::RDX, 1, 32 });
+      e.mov(vpu::R8, vpu::RAX);
+      e.shl(vpu::R8, 5);
+      e.movaps(vpu::Mem{ vpu::RCX, vpu::R8, 1, 32 * (1 + kNumRows) }, vpu::YMM0);
+
+      e.inc(vpu::RAX);
+      e.cmp(vpu::RAX, 4);
+    e.jump_lt(loop);
+    e.ret();
+  e.end();
+}
+}
+
+void example22()
+{
+  // This example looks rows up in a table of indices, clamping each index to the rows that exist. The integer ops
+  // (cmp & cmov, shl), and the scaled index addressing of vpu::Mem, are only available in vpu::Emitter.
+  VPU_ALIGN_PREFIX(32)
+  float argument_data[1 + 2 * kNumRows][8] VPU_ALIGN_SUFFIX(32);
+  const int64_t table[4] = { 2, -1, 7, 0 };
+  memcpy(argument_data[0], table, sizeof(table));
+  for (uint32_t i = 0; i < uint32_t(kNumRows); ++i)
+  {
+    for (uint32_t j = 0; j < 8; ++j)
+    {
+      argument_data[1 + i][j] = float(10 * i + j);
+      argument_data[1 + kNumRows + i][j] = 0.0f;
+    }
+  }
+
+  uint8_t buffer[256];
+  vpu::Emitter e(buffer, sizeof(buffer));
+  emitLookup(e);
+  print_machine_code("\n22_integer_ops", &e);
+
+  vpu::CodeArena arena;
+  vpu::Kernel kernel = arena.commit(e.bytecode(), e.numBytes());
+  kernel.execute(argument_data);
+  print_args(argument_data + 1, 2 * kNumRows);
+}
@@ -0,0 +1,59 @@
+#include "examples.h"
+#include "lib_asm_arena.h"
+#include "lib_asm_emitter.h"
+
+namespace
+{
+const uint32_t kLength = 13;
+
+// Assembles RCX[i] = RCX[i] * RCX[i] + 1 for the first kLength floats at RCX: whole vectors of 8, then the remainder
+// with masked loads & stores, so that the floats after the end are neither read nor written.
+void emitSquarePlusOne(vpu::Emitter& e)
+{
+  e.begin();
+    e.load_const(vpu::YMM1, e.set1_ps(1.0f));
+    e.mov(vpu::RAX, 0);
+    e.mov(vpu::RDX, kLength);
+    vpu::LabelId loop = e.new_label(), tail = e.new_label();
+    e.bind(loop);
+      e.cmp(vpu::RDX, 8);
+      e.jump_lt(tail);
+      e.movups(vpu::YMM0, vpu::Mem{ vpu::RCX, vpu::RAX, 4, 0 });
+      e.mulps(vpu::YMM0, vpu::YMM0, vpu::YMM0);
+      e.addps(vpu::YMM0, vpu::YMM0, vpu::YMM1);
+      e.movups(vpu::Mem{ vpu::RCX, vpu::RAX, 4, 0 }, vpu::YMM0);
+      e.add(vpu::RAX, 8);
+      e.sub(vpu::RDX, 8);
+    e.jump_ne(loop);
+    e.bind(tail);
+
+    // RDX floats remain (0 -> 7)
+    e.tail_mask(vpu::YMM2, vpu::RDX, vpu::YMM3);
+    e.maskmovps(vpu::YMM0, vpu::YMM2, vpu::Mem{ vpu::RCX, vpu::RAX, 4, 0 });
+    e.mulps(vpu::YMM0, vpu::YMM0, vpu::YMM0);
+    e.addps(vpu::YMM0, vpu::YMM0, vpu::YMM1);
+    e.maskmovps(vpu::Mem{ vpu::RCX, vpu::RAX, 4, 0 }, vpu::YMM2, vpu::YMM0);
+    e.ret();
+  e.end();
+}
+}
+
+void example23()
+{
+  // This example processes an array of 13 floats in place. The last 3 floats of the second row are past the end of
+  // the array, so are left as they are.
+  VPU_ALIGN_PREFIX(32)
+  float argument_data[2][8] VPU_ALIGN_SUFFIX(32);
+  for (uint32_t i = 0; i < 16; ++i)
+    argument_data[i / 8][i % 8] = i < kLength ? float(i) : -1.0f;
+
+  uint8_t buffer[256];
+  vpu::Emitter e(buffer, sizeof(buffer));
+  emitSquarePlusOne(e);
+  print_machine_code("\n23_loop_tails", &e);
+
+  vpu::CodeArena arena;
+  vpu::Kernel kernel = arena.commit(e.bytecode(), e.numBytes());
+  kernel.execute(argument_data);
+  print_args(argument_data, 2);
+}
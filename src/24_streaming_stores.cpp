@@ -0,0 +1,103 @@
+#include "examples.h"
+#include "lib_asm_arena.h"
+#include "lib_asm_emitter.h"
+#include <chrono>
+#include <vector>
+
+namespace
+{
+const uint32_t kNumFloats = 1 << 23;   // 32MB in, 32MB out
+const uint32_t kNumRuns = 5;
+
+struct Stream
+{
+  const float* input;
+  float* output;
+  uint64_t numFloats;   ///< a multiple of 32
+};
+
+// Assembles output[i] = input[i] * 2 + 1, 128 bytes at a time, with ordinary stores, or non-temporal stores (with
+// prefetches 1KB ahead of the loads, if prefetch is true).
+void emitStream(vpu::Emitter& e, bool non_temporal, bool prefetch)
+{
+  e.begin();
+    e.mov64(vpu::RAX, vpu::RCX, 0);
+    e.mov64(vpu::RDX, vpu::RCX, 8);
+    e.mov64(vpu::R8, vpu::RCX, 16);
+    e.load_const(vpu::YMM4, e.set1_ps(2.0f));
+    e.load_const(vpu::YMM5, e.set1_ps(1.0f));
+    e.setPrefetchDistance(prefetch ? 1024 : 0, vpu::kPrefetchNTA);
+    vpu::LabelId loop = e.new_label();
+    e.bind(loop);
+      for (int32_t i = 0; i < 4; ++i)
+      {
+        e.movaps(vpu::AVXReg(i), vpu::RAX, 32 * i);
+        e.mulps(vpu::AVXReg(i), vpu::AVXReg(i), vpu::YMM4);
+        e.addps(vpu::AVXReg(i), vpu::AVXReg(i), vpu::YMM5);
+      }
+      for (int32_t i = 0; i < 4; ++i)
+      {
+        if (non_temporal)
+          e.movntps(vpu::RDX, 32 * i, vpu::AVXReg(i));
+        else
+          e.movaps(vpu::RDX, 32 * i, vpu::AVXReg(i));
+      }
+      e.add(vpu::RAX, 128);
+      e.add(vpu::RDX, 128);
+      e.sub(vpu::R8, 32);
+    e.jump_ne(loop);
+    e.setPrefetchDistance(0);
+
+    // the non-temporal stores must be complete before anyone else reads the output
+    if (non_temporal)
+      e.sfence();
+    e.ret();
+  e.end();
+}
+}
+
+void example24()
+{
+  // This example streams 32MB through three kernels: with ordinary stores (which read each line of the output into
+  // the cache before writing it, evicting whatever was there), with non-temporal stores, and with non-temporal stores
+  // and prefetches (see vpu::Emitter::setPrefetchDistance). The hardware prefetcher already follows a stream as simple
+  // as this one, so the prefetches may not help here; they pay off when each iteration touches several streams, or
+  // does enough work to hide the latency of the memory.
+  std::vector<float> input(kNumFloats + 8), output(kNumFloats + 8);
+  Stream stream;
+  stream.input = (const float*)((uintptr_t(&input[0]) + 31) & ~uintptr_t(31));
+  stream.output = (float*)((uintptr_t(&output[0]) + 31) & ~uintptr_t(31));
+  stream.numFloats = kNumFloats;
+  for (uint32_t i = 0; i < kNumFloats; ++i)
+    ((float*)stream.input)[i] = float(i & 255);
+
+  const char* const names[] = { "movaps", "movntps", "movntps + prefetchnta" };
+  uint8_t buffer[512];
+  vpu::Emitter e(buffer, sizeof(buffer));
+  vpu::CodeArena arena;
+
+  printf("\n24_streaming_stores\n");
+  printf("  stores                  ms / 32MB   result\n");
+  for (uint32_t k = 0; k < 3; ++k)
+  {
+    emitStream(e, k > 0, k == 2);
+    vpu::Kernel kernel = arena.commit(e.bytecode(), e.numBytes());
+    double best = 0.0;
+    for (uint32_t run = 0; run < kNumRuns; ++run)
+    {
+      const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+      kernel.execute(&stream);
+      const std::chrono::duration<double> t = std::chrono::high_resolution_clock::now() - start;
+      if (run == 0 || t.count() < best)
+        best = t.count();
+    }
+    arena.release(kernel);
+
+    bool correct = true;
+    for (uint32_t i = 0; i < kNumFloats && correct; ++i)
+      correct = stream.output[i] == float(i & 255) * 2.0f + 1.0f;
+    memset(stream.output, 0, kNumFloats * sizeof(float));
+    printf("  %-21s   %9.2f   %s\n", names[k], best * 1e3, correct ? "ok" : "WRONG");
+  }
+  print_machine_code("\n24_streaming_stores (movntps + prefetchnta)", &e);
+}
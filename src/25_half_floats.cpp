@@ -0,0 +1,59 @@
+#include "examples.h"
+#include "lib_asm_arena.h"
+#include "lib_asm_emitter.h"
+
+namespace
+{
+// the half float nearest below f (which must be 0, or within the range of a normal half float)
+uint16_t toHalf(float f)
+{
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  if (!(bits & 0x7FFFFFFF))
+    return uint16_t(bits >> 16);
+  return uint16_t(((bits >> 16) & 0x8000) | ((((bits >> 23) & 0xFF) - 127 + 15) << 10) | ((bits >> 13) & 0x3FF));
+}
+
+// Assembles: the 16 half floats at RCX are scaled by 0.5 in place, then widened into the 16 floats at RCX + 32, so that
+// they can be printed.
+void emitHalve(vpu::Emitter& e)
+{
+  e.begin();
+    e.load_const(vpu::YMM1, e.set1_ps(0.5f));
+    for (int32_t i = 0; i < 2; ++i)
+    {
+      e.cvtphps(vpu::YMM0, vpu::RCX, 16 * i);
+      e.mulps(vpu::YMM0, vpu::YMM0, vpu::YMM1);
+      e.cvtpsph(vpu::RCX, 16 * i, vpu::YMM0, vpu::FROUND_TO_NEAREST_INT);
+    }
+    for (int32_t i = 0; i < 2; ++i)
+    {
+      e.cvtphps(vpu::YMM0, vpu::RCX, 16 * i);
+      e.movaps(vpu::RCX, 32 + 32 * i, vpu::YMM0);
+    }
+    e.ret();
+  e.end();
+}
+}
+
+void example25()
+{
+  // This example halves 16 half floats (the first row of argument_data), and prints them as floats. The F16C
+  // conversions are only available in vpu::Emitter.
+  VPU_ALIGN_PREFIX(32)
+  float argument_data[3][8] VPU_ALIGN_SUFFIX(32);
+  uint16_t halfs[16];
+  for (uint32_t i = 0; i < 16; ++i)
+    halfs[i] = toHalf(float(i) * 1.5f);
+  memcpy(argument_data[0], halfs, sizeof(halfs));
+
+  uint8_t buffer[256];
+  vpu::Emitter e(buffer, sizeof(buffer));
+  emitHalve(e);
+  print_machine_code("\n25_half_floats", &e);
+
+  vpu::CodeArena arena;
+  vpu::Kernel kernel = arena.commit(e.bytecode(), e.numBytes());
+  kernel.execute(argument_data);
+  print_args(argument_data + 1, 2);
+}
@@ -15,11 +15,24 @@ extern void example09();
 extern void example10();
 extern void example11();
 extern void example12();
+extern void example13();
+extern void example14();
+extern void example15();
+extern void example16();
+extern void example17();
+extern void example18();
+extern void example19();
+extern void example20();
+extern void example21();
+extern void example22();
+extern void example23();
+extern void example24();
+extern void example25();
 
 int main()
 {
   // library initialisation
-  g_lib = new vpu::AssemblerLib("libASM.dll");
+  g_lib = new vpu::AssemblerLib();
   if (g_lib->isOk())
   {
     // run examples
@@ -36,6 +49,19 @@ int main()
     example10();
     example11();
     example12();
+    example13();
+    example14();
+    example15();
+    example16();
+    example17();
+    example18();
+    example19();
+    example20();
+    example21();
+    example22();
+    example23();
+    example24();
+    example25();
   }
   // free library
   delete g_lib;